@@ -0,0 +1,175 @@
+/*
+ * cast.c - asciicast recordings of the window
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * --cast writes an asciicast v2 file (a JSON header line, then one
+ * [time, "o", data] event per frame) whose screen is just the window:
+ * as wide as the terminal and as tall as the window.  Rows are rendered
+ * by the display code exactly as they are drawn.  A frame where no row
+ * changed is not recorded at all; with --cast-diff only the rows that
+ * changed are written, each behind a cursor move, which keeps the file
+ * small when a few lines trickle through a tall window.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cast.h"
+#include "display.h"
+#include "jsonl.h"
+#include "sash.h"
+
+typedef struct {
+  char *text;
+  size_t len;
+} Row;
+
+static FILE *g_cast = NULL;
+static bool g_changed_rows = false;
+static uint64_t g_start;
+static int g_width, g_height;
+static Row *g_rows = NULL; /* as last recorded */
+static char *g_frame = NULL;
+static size_t g_frame_len, g_frame_cap;
+static char *g_escaped = NULL;
+static size_t g_escaped_cap = 0;
+
+static void frame_append(const char *s, size_t n) {
+  if (g_frame_len + n > g_frame_cap) {
+    g_frame_cap = (g_frame_len + n) * 2;
+    g_frame = realloc(g_frame, g_frame_cap);
+    if (!g_frame) {
+      perror("sash: realloc");
+      exit(1);
+    }
+  }
+  memcpy(g_frame + g_frame_len, s, n);
+  g_frame_len += n;
+}
+
+static void frame_printf(const char *fmt, int a, int b) {
+  char buf[32];
+  int n = snprintf(buf, sizeof(buf), fmt, a, b);
+  frame_append(buf, (size_t)n);
+}
+
+static void forget_rows(void) {
+  for (int i = 0; i < g_height; i++)
+    free(g_rows[i].text);
+  free(g_rows);
+  g_rows = NULL;
+}
+
+/* Size the screen to the window; false if it was already that size. */
+static bool fit_screen(void) {
+  int height = display_rows();
+  if (g_rows && g_width == g_term_cols && g_height == height)
+    return false;
+  forget_rows();
+  g_width = g_term_cols;
+  g_height = height;
+  g_rows = calloc((size_t)g_height, sizeof(Row));
+  if (!g_rows) {
+    perror("sash: calloc");
+    exit(1);
+  }
+  return true;
+}
+
+/* Returns false (after reporting why) if the file can't be created. */
+bool cast_open(const char *path, bool changed_rows, uint64_t now) {
+  g_cast = fopen(path, "w");
+  if (!g_cast) {
+    fprintf(stderr, "sash: %s: %s\n", path, strerror(errno));
+    return false;
+  }
+  g_changed_rows = changed_rows;
+  g_start = now;
+  fit_screen();
+  fprintf(g_cast,
+          "{\"version\": 2, \"width\": %d, \"height\": %d, "
+          "\"timestamp\": %lld, \"title\": \"sash\"}\n",
+          g_width, g_height, (long long)time(NULL));
+  return true;
+}
+
+/*
+ * Record the window as it is now, if any row changed since the last
+ * recorded frame.  Returns whether a frame was written.
+ */
+bool cast_frame(uint64_t now) {
+  if (!g_cast)
+    return false;
+  double t = (double)(now - g_start) / 1e9;
+  bool all = false;
+  if (fit_screen()) {
+    /* the terminal was resized */
+    fprintf(g_cast, "[%.6f, \"r\", \"%dx%d\"]\n", t, g_width, g_height);
+    all = true;
+  }
+
+  g_frame_len = 0;
+  bool changed = false;
+  for (int row = 0; row < g_height; row++) {
+    size_t len;
+    const char *text = display_render_row(row, &len);
+    Row *r = &g_rows[row];
+    bool same = r->text && r->len == len && memcmp(r->text, text, len) == 0;
+    if (!same) {
+      char *copy = realloc(r->text, len + 1);
+      if (!copy) {
+        perror("sash: realloc");
+        exit(1);
+      }
+      memcpy(copy, text, len);
+      r->text = copy;
+      r->len = len;
+      changed = true;
+    }
+    if (same && g_changed_rows && !all)
+      continue;
+    frame_printf("\033[%d;%dH\033[2K", row + 1, 1);
+    frame_append(r->text, r->len);
+  }
+  if (!changed && !all)
+    return false;
+
+  if (JSON_ESCAPE_MAX(g_frame_len) + 1 > g_escaped_cap) {
+    g_escaped_cap = JSON_ESCAPE_MAX(g_frame_len) + 1;
+    g_escaped = realloc(g_escaped, g_escaped_cap);
+    if (!g_escaped) {
+      perror("sash: realloc");
+      exit(1);
+    }
+  }
+  size_t n = json_escape(g_escaped, g_frame, g_frame_len);
+  fprintf(g_cast, "[%.6f, \"o\", \"", t);
+  fwrite(g_escaped, 1, n, g_cast);
+  fputs("\"]\n", g_cast);
+  /* frames are rate-capped, so a flush each keeps the file live cheaply */
+  fflush(g_cast);
+  return true;
+}
+
+void cast_close(void) {
+  if (!g_cast)
+    return;
+  if (fclose(g_cast) != 0)
+    perror("sash: cast");
+  g_cast = NULL;
+  forget_rows();
+  free(g_frame);
+  free(g_escaped);
+  g_frame = g_escaped = NULL;
+  g_frame_cap = g_escaped_cap = 0;
+}
@@ -0,0 +1,17 @@
+/*
+ * cast.h - asciicast recordings of the window
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef CAST_H
+#define CAST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+bool cast_open(const char *path, bool changed_rows, uint64_t now);
+bool cast_frame(uint64_t now);
+void cast_close(void);
+
+#endif /* CAST_H */
@@ -75,6 +75,24 @@ static void dbuf_printf(const char *fmt, ...) {
   free(big);
 }
 
+/* ── Minimap ─────────────────────────────────────────────────────── */
+
+/* The --minimap strip, on a row of its own under the window: already
+   rendered, escape sequences and all.  NULL means there's no such row. */
+static char *g_minimap = NULL;
+static size_t g_minimap_len = 0;
+
+void display_set_minimap(const char *row, size_t len) {
+  char *copy = realloc(g_minimap, len + 1);
+  if (!copy) {
+    perror("sash: realloc");
+    exit(1);
+  }
+  memcpy(copy, row, len);
+  g_minimap = copy;
+  g_minimap_len = len;
+}
+
 /* ── TTY output ──────────────────────────────────────────────────── */
 
 /* Single write() call — the kernel's tty atomic_write_lock ensures this
@@ -90,6 +108,18 @@ static void dbuf_flush(void) { tty_write(g_draw_buf, g_draw_len); }
 void display_free_drawbuf(void) {
   free(g_draw_buf);
   g_draw_buf = NULL;
+  free(g_minimap);
+  g_minimap = NULL;
+}
+
+/* ── Status ──────────────────────────────────────────────────────── */
+
+/* Short note drawn at the right end of the window's first row, e.g. the
+   CPU governor's current degradation.  Empty means none. */
+static char g_status[192] = "";
+
+void display_set_status(const char *status) {
+  snprintf(g_status, sizeof(g_status), "%s", status ? status : "");
 }
 
 /* ── Terminal size ───────────────────────────────────────────────── */
@@ -119,13 +149,18 @@ void get_terminal_size(void) {
  * When g_ansi is true: same, but pass through ANSI escape sequences (CSI
  * and two-byte ESC sequences) without counting them as visible columns.
  * Appends a SGR reset (\033[0m) to prevent color bleed between rows.
+ *
+ * While g_plain is set (plain-text snapshots), escape sequences are
+ * recognised as in ANSI mode but dropped.
  */
+static bool g_plain = false;
+
 static void sanitize_line(const char *src, size_t src_len, size_t max_cols) {
   size_t col = 0;
   for (size_t i = 0; i < src_len && col < max_cols; i++) {
     unsigned char ch = (unsigned char)src[i];
 
-    if (g_ansi && ch == '\033' && i + 1 < src_len) {
+    if ((g_ansi || g_plain) && ch == '\033' && i + 1 < src_len) {
       if (src[i + 1] == '[') {
         /* CSI sequence: \033[ ... <final byte 0x40-0x7E> */
         size_t start = i;
@@ -138,11 +173,13 @@ static void sanitize_line(const char *src, size_t src_len, size_t max_cols) {
           }
           i++;
         }
-        dbuf_append(src + start, i - start);
+        if (!g_plain)
+          dbuf_append(src + start, i - start);
         i--; /* compensate for loop increment */
       } else {
         /* Two-byte escape: ESC + next char */
-        dbuf_append(src + i, 2);
+        if (!g_plain)
+          dbuf_append(src + i, 2);
         i++; /* skip next char */
       }
       continue;
@@ -175,79 +212,113 @@ static void sanitize_line(const char *src, size_t src_len, size_t max_cols) {
     col++;
   }
 
-  if (g_ansi)
+  if (g_ansi && !g_plain)
     dbuf_append("\033[0m", 4);
 }
 
-/*
- * Append the window content to dbuf.  Does not reset or flush — the caller
- * can prepend setup sequences and still emit everything in one write().
- *
- * Uses absolute cursor positioning to the fixed window area at the bottom
- * of the screen (below the scroll region).  The scroll region isolates
- * the window from scrolling caused by other processes writing to the TTY.
- */
-static void build_redraw(void) {
+/* Rows of lines in the window: -n, limited to leave the terminal one row
+   (and the minimap its own). */
+int display_height(void) {
   int height = g_win_height;
-  if (height > g_term_rows - 1)
-    height = g_term_rows - 1;
+  int limit = g_term_rows - 1 - (g_minimap ? 1 : 0);
+  if (g_is_tty && height > limit)
+    height = limit;
   if (height < 1)
     height = 1;
+  return height;
+}
+
+/* Rows the window takes on screen, the minimap included. */
+int display_rows(void) { return display_height() + (g_minimap ? 1 : 0); }
 
-  int win_top = g_win_top;
+/*
+ * Append one row of the window (0 = top) to dbuf: the line number margin,
+ * the line and, on the first row, the status.  screen_row is the row's
+ * 1-based position on the screen, for placing the status.
+ */
+static void build_row(int row, int height, int screen_row) {
   int margin = g_line_numbers ? 6 : 0;
   int content_cols = g_term_cols - margin;
   if (content_cols < 1)
     content_cols = 1;
 
-  /* move to the first row of the window */
-  dbuf_printf("\033[%d;1H", win_top);
-
   /* compute base line number for visible rows */
   size_t visible =
       g_ring.count < (size_t)height ? g_ring.count : (size_t)height;
   size_t base = g_total_lines - visible + 1;
 
-  for (int row = 0; row < height; row++) {
-    /* carriage return + clear line */
-    dbuf_append("\r\033[2K", 5);
+  size_t len;
+  const char *line;
 
-    size_t len;
-    const char *line;
-
-    if ((size_t)row < g_ring.count) {
-      /* index from oldest visible to newest */
-      size_t idx;
-      if (g_ring.count <= (size_t)height)
-        idx = (size_t)row;
-      else
-        idx = g_ring.count - (size_t)height + (size_t)row;
-      line = ringbuf_get(&g_ring, idx, &len);
-
-      if (g_line_numbers) {
-        if (g_color)
-          dbuf_append("\033[90m", 5);
-        dbuf_printf("%5zu\xe2\x94\x82", base + (size_t)row);
-        if (g_color)
-          dbuf_append("\033[0m", 4);
-      }
-    } else {
-      line = "";
-      len = 0;
-
-      if (g_line_numbers) {
-        if (g_color)
-          dbuf_append("\033[90m", 5);
-        dbuf_append("     \xe2\x94\x82", 8);
-        if (g_color)
-          dbuf_append("\033[0m", 4);
-      }
+  if ((size_t)row < g_ring.count) {
+    /* index from oldest visible to newest */
+    size_t idx;
+    if (g_ring.count <= (size_t)height)
+      idx = (size_t)row;
+    else
+      idx = g_ring.count - (size_t)height + (size_t)row;
+    line = ringbuf_get(&g_ring, idx, &len);
+
+    if (g_line_numbers) {
+      if (g_color)
+        dbuf_append("\033[90m", 5);
+      dbuf_printf("%5zu\xe2\x94\x82", base + (size_t)row);
+      if (g_color)
+        dbuf_append("\033[0m", 4);
     }
+  } else {
+    line = "";
+    len = 0;
+
+    if (g_line_numbers) {
+      if (g_color)
+        dbuf_append("\033[90m", 5);
+      dbuf_append("     \xe2\x94\x82", 8);
+      if (g_color)
+        dbuf_append("\033[0m", 4);
+    }
+  }
 
+  /* the status takes the end of the first row when there's room */
+  size_t status_len = row == 0 ? strlen(g_status) : 0;
+  if (status_len > 0 && (size_t)content_cols > status_len + 8) {
+    sanitize_line(line, len, (size_t)content_cols - status_len - 1);
+    dbuf_printf("\033[%d;%dH", screen_row, g_term_cols - (int)status_len + 1);
+    if (g_color)
+      dbuf_append("\033[7m", 4);
+    dbuf_append(g_status, status_len);
+    if (g_color)
+      dbuf_append("\033[0m", 4);
+  } else {
     sanitize_line(line, len, (size_t)content_cols);
+  }
+}
+
+/*
+ * Append the window content to dbuf.  Does not reset or flush — the caller
+ * can prepend setup sequences and still emit everything in one write().
+ *
+ * Uses absolute cursor positioning to the fixed window area at the bottom
+ * of the screen (below the scroll region).  The scroll region isolates
+ * the window from scrolling caused by other processes writing to the TTY.
+ */
+static void build_redraw(void) {
+  int height = display_height();
+  int rows = display_rows();
+
+  /* move to the first row of the window */
+  dbuf_printf("\033[%d;1H", g_win_top);
+
+  for (int row = 0; row < rows; row++) {
+    /* carriage return + clear line */
+    dbuf_append("\r\033[2K", 5);
+    if (row < height)
+      build_row(row, height, g_win_top + row);
+    else
+      dbuf_append(g_minimap, g_minimap_len);
 
     /* move down (except on last row) */
-    if (row < height - 1)
+    if (row < rows - 1)
       dbuf_append("\n", 1);
   }
 
@@ -257,12 +328,49 @@ static void build_redraw(void) {
     dbuf_printf("\033[%d;1H", g_scroll_bottom);
 }
 
+/*
+ * One row of the window (the minimap is the last of display_rows()) as
+ * build_redraw() would draw it, for a recording whose screen is just the
+ * window.  The result is valid until the next display call.
+ */
+const char *display_render_row(int row, size_t *len) {
+  dbuf_reset();
+  if (row < display_height())
+    build_row(row, display_height(), row + 1);
+  else if (g_minimap)
+    dbuf_append(g_minimap, g_minimap_len);
+  *len = g_draw_len;
+  return g_draw_buf ? g_draw_buf : "";
+}
+
 void redraw_window(void) {
   if (!g_is_tty)
     return;
   dbuf_reset();
   build_redraw();
   dbuf_flush();
+  g_stats.frames++;
+}
+
+/*
+ * Write the lines the window shows (the last g_win_height in the ring) to
+ * out as plain text: sanitised like the window, with escape sequences
+ * removed and each line cut at max_cols.
+ */
+void display_write_plain(FILE *out, size_t max_cols) {
+  size_t start = g_ring.count > (size_t)g_win_height
+                     ? g_ring.count - (size_t)g_win_height
+                     : 0;
+  g_plain = true;
+  for (size_t i = start; i < g_ring.count; i++) {
+    size_t len;
+    const char *line = ringbuf_get(&g_ring, i, &len);
+    dbuf_reset();
+    sanitize_line(line, len, max_cols);
+    dbuf_append("\n", 1);
+    fwrite(g_draw_buf, 1, g_draw_len, out);
+  }
+  g_plain = false;
 }
 
 /* ── Cursor & window setup ───────────────────────────────────────── */
@@ -321,11 +429,7 @@ void setup_window(void) {
 
   get_terminal_size();
 
-  int height = g_win_height;
-  if (height > g_term_rows - 1)
-    height = g_term_rows - 1;
-  if (height < 1)
-    height = 1;
+  int height = display_rows();
 
   /* Decide where to place the window: just below the cursor if it fits,
      otherwise scroll to make room at the bottom. */
@@ -365,17 +469,34 @@ void setup_window(void) {
   g_started = true;
 }
 
+/*
+ * Take over the window a replaced sash process set up with its first
+ * row at win_top: the same scroll region, with nothing pushed up.
+ */
+void resume_window(int win_top) {
+  if (!g_is_tty)
+    return;
+
+  get_terminal_size();
+  g_win_top = win_top;
+  g_scroll_bottom = g_win_top - 1;
+
+  dbuf_reset();
+  dbuf_append("\033[?25l", 6);
+  if (g_scroll_bottom >= 2)
+    dbuf_printf("\033[1;%dr", g_scroll_bottom);
+  build_redraw();
+  dbuf_flush();
+  g_started = true;
+}
+
 /* ── Resize handling ─────────────────────────────────────────────── */
 
 void handle_resize(void) {
   g_resize = 0;
   get_terminal_size();
 
-  int height = g_win_height;
-  if (height > g_term_rows - 1)
-    height = g_term_rows - 1;
-  if (height < 1)
-    height = 1;
+  int height = display_rows();
 
   g_win_top = g_term_rows - height + 1;
   g_scroll_bottom = g_win_top - 1;
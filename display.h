@@ -8,11 +8,19 @@
 #define DISPLAY_H
 
 #include <stddef.h>
+#include <stdio.h>
 
 void get_terminal_size(void);
 void setup_window(void);
+void resume_window(int win_top);
 void handle_resize(void);
 void redraw_window(void);
+void display_set_status(const char *status);
+void display_set_minimap(const char *row, size_t len);
+void display_write_plain(FILE *out, size_t max_cols);
+int display_height(void);
+int display_rows(void);
+const char *display_render_row(int row, size_t *len);
 void tty_write(const char *buf, size_t len);
 void display_free_drawbuf(void);
 
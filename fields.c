@@ -0,0 +1,280 @@
+/*
+ * fields.c - Live statistics over key=value fields
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * --stat-field KEY pulls a number out of "KEY=123" or "\"KEY\": 123" on
+ * each line and feeds it to DDSketches: one per slot of the time window
+ * (merged on demand for the status area) and one for the whole run
+ * (printed at exit).  --distinct-field KEY feeds the value's text to a
+ * HyperLogLog.  Memory per field is fixed however long sash runs.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fields.h"
+#include "sketch.h"
+
+/* The window is kept as this many slots; it slides a slot at a time. */
+#define FIELD_SLOTS 6
+
+typedef struct {
+  char *key;
+  size_t klen;
+  bool distinct;
+  DDSketch *slots; /* FIELD_SLOTS, then the whole-run sketch */
+  uint64_t slot_epoch[FIELD_SLOTS];
+  HyperLogLog *hll;
+  uint64_t lines; /* lines the field appeared on */
+} Field;
+
+static Field *g_fields = NULL;
+static int g_nfields = 0;
+static uint64_t g_slot_ns = FIELD_WINDOW_NS / FIELD_SLOTS;
+static DDSketch *g_merged = NULL; /* scratch for window queries */
+
+static void *xcalloc(size_t n, size_t size) {
+  void *p = calloc(n, size);
+  if (!p) {
+    perror("sash: calloc");
+    exit(1);
+  }
+  return p;
+}
+
+void fields_add(const char *key, bool distinct) {
+  g_fields = realloc(g_fields, (size_t)(g_nfields + 1) * sizeof(Field));
+  if (!g_fields) {
+    perror("sash: realloc");
+    exit(1);
+  }
+  Field *f = &g_fields[g_nfields++];
+  memset(f, 0, sizeof(*f));
+  f->key = strdup(key);
+  if (!f->key) {
+    perror("sash: strdup");
+    exit(1);
+  }
+  f->klen = strlen(key);
+  f->distinct = distinct;
+  if (distinct)
+    f->hll = xcalloc(1, sizeof(HyperLogLog));
+  else
+    f->slots = xcalloc(FIELD_SLOTS + 1, sizeof(DDSketch));
+}
+
+void fields_set_window(uint64_t ns) {
+  g_slot_ns = ns / FIELD_SLOTS;
+  if (g_slot_ns == 0)
+    g_slot_ns = 1;
+}
+
+bool fields_active(void) { return g_nfields > 0; }
+
+static bool is_key_char(char c) {
+  return isalnum((unsigned char)c) || c == '_' || c == '-' || c == '.';
+}
+
+/*
+ * Find KEY's value in a line: KEY=VALUE, KEY: VALUE or "KEY": VALUE, with
+ * the key not part of a longer name.  A quoted value is returned without
+ * its quotes; otherwise the value runs to whitespace, ',', ';', '}' or
+ * ']'.
+ */
+bool field_value(const char *line, size_t len, const char *key, size_t klen,
+                 const char **val, size_t *vlen) {
+  const char *end = line + len;
+  const char *p = line;
+  while (p < end) {
+    const char *k = memmem(p, (size_t)(end - p), key, klen);
+    if (!k)
+      return false;
+    p = k + 1;
+    if (k > line && is_key_char(k[-1]))
+      continue;
+    const char *q = k + klen;
+    if (q < end && *q == '"' && k > line && k[-1] == '"')
+      q++;
+    while (q < end && *q == ' ')
+      q++;
+    if (q >= end || (*q != '=' && *q != ':'))
+      continue;
+    if (*q++ == ':') {
+      while (q < end && *q == ' ')
+        q++;
+    }
+    if (q < end && *q == '"') {
+      const char *s = ++q;
+      while (q < end && *q != '"') {
+        if (*q == '\\' && q + 1 < end)
+          q++;
+        q++;
+      }
+      *val = s;
+      *vlen = (size_t)(q - s);
+      return true;
+    }
+    const char *s = q;
+    while (q < end && !isspace((unsigned char)*q) && !strchr(",;}]", *q))
+      q++;
+    if (q == s)
+      continue;
+    *val = s;
+    *vlen = (size_t)(q - s);
+    return true;
+  }
+  return false;
+}
+
+/* Leading number of a value ("123ms" -> 123). */
+static bool parse_number(const char *s, size_t n, double *out) {
+  char buf[64];
+  if (n == 0 || n >= sizeof(buf))
+    return false;
+  memcpy(buf, s, n);
+  buf[n] = '\0';
+  char *end;
+  *out = strtod(buf, &end);
+  return end != buf;
+}
+
+void fields_line(const char *line, size_t len, uint64_t now) {
+  for (int i = 0; i < g_nfields; i++) {
+    Field *f = &g_fields[i];
+    const char *val;
+    size_t vlen;
+    if (!field_value(line, len, f->key, f->klen, &val, &vlen))
+      continue;
+
+    if (f->distinct) {
+      hll_add(f->hll, val, vlen);
+      f->lines++;
+      continue;
+    }
+
+    double v;
+    if (!parse_number(val, vlen, &v))
+      continue;
+    uint64_t epoch = now / g_slot_ns;
+    int slot = (int)(epoch % FIELD_SLOTS);
+    if (f->slot_epoch[slot] != epoch) {
+      dds_clear(&f->slots[slot]); /* a full window old: reuse it */
+      f->slot_epoch[slot] = epoch;
+    }
+    dds_add(&f->slots[slot], v);
+    dds_add(&f->slots[FIELD_SLOTS], v);
+    f->lines++;
+  }
+}
+
+/* Compact numbers for the status area: 12, 3.5, 1234, 2.1e+09. */
+static int format_value(char *out, size_t cap, double v) {
+  if (v >= 100 && v < 1e7)
+    return snprintf(out, cap, "%.0f", v);
+  return snprintf(out, cap, "%.3g", v);
+}
+
+/* Format at out + o; the result is clamped so that o never passes the
+   terminating NUL, however much was cut off. */
+static size_t emit(char *out, size_t cap, size_t o, const char *fmt, ...) {
+  if (o + 1 >= cap)
+    return o;
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(out + o, cap - o, fmt, ap);
+  va_end(ap);
+  if (n < 0)
+    return o;
+  return o + (size_t)n < cap ? o + (size_t)n : cap - 1;
+}
+
+static size_t append(char *out, size_t cap, size_t o, const char *fmt,
+                     double v) {
+  char num[32];
+  format_value(num, sizeof(num), v);
+  return emit(out, cap, o, fmt, num);
+}
+
+/* Sketch of the current window for a field. */
+static const DDSketch *window_sketch(Field *f, uint64_t now) {
+  if (!g_merged)
+    g_merged = xcalloc(1, sizeof(DDSketch));
+  dds_clear(g_merged);
+  uint64_t epoch = now / g_slot_ns;
+  for (int s = 0; s < FIELD_SLOTS; s++) {
+    if (f->slot_epoch[s] + FIELD_SLOTS > epoch)
+      dds_merge(g_merged, &f->slots[s]);
+  }
+  return g_merged;
+}
+
+/*
+ * One-line summary for the status area, e.g.
+ * "latency_ms p50=12 p90=40 p99=95 max=120  user~1234".
+ */
+size_t fields_status(char *out, size_t cap, uint64_t now) {
+  if (cap == 0)
+    return 0;
+  size_t o = 0;
+  out[0] = '\0';
+  for (int i = 0; i < g_nfields && o + 1 < cap; i++) {
+    Field *f = &g_fields[i];
+    o = emit(out, cap, o, "%s%s", o ? "  " : "", f->key);
+    if (f->distinct) {
+      o = append(out, cap, o, "~%s", hll_estimate(f->hll));
+      continue;
+    }
+    const DDSketch *w = window_sketch(f, now);
+    if (w->n == 0) {
+      o = emit(out, cap, o, " -");
+      continue;
+    }
+    o = append(out, cap, o, " p50=%s", dds_quantile(w, 0.5));
+    o = append(out, cap, o, " p90=%s", dds_quantile(w, 0.9));
+    o = append(out, cap, o, " p99=%s", dds_quantile(w, 0.99));
+    o = append(out, cap, o, " max=%s", w->max);
+  }
+  return o;
+}
+
+/* Whole-run summary, one line per field. */
+void fields_print(FILE *out) {
+  for (int i = 0; i < g_nfields; i++) {
+    Field *f = &g_fields[i];
+    if (f->distinct) {
+      fprintf(out, "sash: %s: ~%.0f distinct values on %llu lines\n", f->key,
+              hll_estimate(f->hll), (unsigned long long)f->lines);
+      continue;
+    }
+    const DDSketch *all = &f->slots[FIELD_SLOTS];
+    char p50[32], p90[32], p99[32], max[32];
+    format_value(p50, sizeof(p50), dds_quantile(all, 0.5));
+    format_value(p90, sizeof(p90), dds_quantile(all, 0.9));
+    format_value(p99, sizeof(p99), dds_quantile(all, 0.99));
+    format_value(max, sizeof(max), all->max);
+    fprintf(out, "sash: %s: %llu values, p50 %s, p90 %s, p99 %s, max %s\n",
+            f->key, (unsigned long long)all->n, p50, p90, p99, max);
+  }
+}
+
+void fields_free(void) {
+  for (int i = 0; i < g_nfields; i++) {
+    free(g_fields[i].key);
+    free(g_fields[i].slots);
+    free(g_fields[i].hll);
+  }
+  free(g_fields);
+  g_fields = NULL;
+  g_nfields = 0;
+  free(g_merged);
+  g_merged = NULL;
+}
@@ -0,0 +1,28 @@
+/*
+ * fields.h - Live statistics over key=value fields
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef FIELDS_H
+#define FIELDS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define FIELD_WINDOW_NS (60 * 1000000000ULL) /* default --stat-window */
+
+void fields_add(const char *key, bool distinct);
+void fields_set_window(uint64_t ns);
+bool fields_active(void);
+void fields_line(const char *line, size_t len, uint64_t now);
+size_t fields_status(char *out, size_t cap, uint64_t now);
+void fields_print(FILE *out);
+void fields_free(void);
+
+bool field_value(const char *line, size_t len, const char *key, size_t klen,
+                 const char **val, size_t *vlen);
+
+#endif /* FIELDS_H */
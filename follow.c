@@ -0,0 +1,565 @@
+/*
+ * follow.c - Following files across directory trees
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * --follow-dir watches every directory under the given roots with inotify
+ * (one watch per directory, which also reports writes to the files in it)
+ * and follows every file whose name matches --glob: from its end if it
+ * existed at startup, from the start if it appears later.  Nothing is
+ * polled, so quiet files cost nothing.
+ *
+ * Open fds are bounded: files are kept on an LRU list and the least
+ * recently written one is closed when the budget (half of RLIMIT_NOFILE)
+ * is reached.  A closed file keeps its offset and is reopened when inotify
+ * next reports a write.  A name that comes to refer to another file (a
+ * file renamed over it, as log rotation does) is followed from the new
+ * file's start once the old one has been read to its end.  Lines are handed to the callback with the file's
+ * path as its ctx.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sys/inotify.h>
+#endif
+
+#include "follow.h"
+
+#ifdef __linux__
+
+#define FOLLOW_READ_CHUNK 65536
+#define FOLLOW_MAX_PARTIAL (1 << 20) /* longer unterminated lines are cut */
+#define FOLLOW_MAX_OPEN 4096
+
+#define DIR_EVENTS                                                             \
+  (IN_CREATE | IN_MOVED_TO | IN_MODIFY | IN_DELETE | IN_MOVED_FROM |           \
+   IN_DELETE_SELF | IN_ONLYDIR)
+
+typedef struct FollowFile {
+  char *path;
+  dev_t dev;
+  ino_t ino; /* 0 until first opened or seen */
+  off_t offset; /* next byte to read */
+  int fd;       /* -1 while closed */
+  char *partial; /* unterminated tail of the last read */
+  size_t plen;
+  struct FollowFile *prev, *next; /* LRU of open files, newest first */
+  struct FollowFile *hnext;       /* hash chain */
+} FollowFile;
+
+static int g_inotify = -1;
+static char *g_glob = NULL;
+static char **g_dirs = NULL; /* path by watch descriptor */
+static int g_dirs_cap = 0;
+static int g_ndirs = 0;
+
+static FollowFile **g_table = NULL;
+static size_t g_table_cap = 0;
+static size_t g_nfiles = 0;
+
+static FollowFile *g_lru_head = NULL;
+static FollowFile *g_lru_tail = NULL;
+static int g_nopen = 0;
+static int g_max_open = 0;
+static int g_peak_open = 0;
+static unsigned long long g_reopens = 0;
+
+static char *g_chunk = NULL;
+
+static void *xmalloc(size_t n) {
+  void *p = malloc(n);
+  if (!p) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  return p;
+}
+
+static char *join_path(const char *dir, const char *name) {
+  size_t a = strlen(dir), b = strlen(name);
+  char *p = xmalloc(a + b + 2);
+  memcpy(p, dir, a);
+  p[a] = '/';
+  memcpy(p + a + 1, name, b + 1);
+  return p;
+}
+
+/* ── File table ──────────────────────────────────────────────────── */
+
+static size_t hash_path(const char *s) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (; *s; s++) {
+    h ^= (unsigned char)*s;
+    h *= 0x100000001b3ULL;
+  }
+  return (size_t)h;
+}
+
+static FollowFile **table_slot(const char *path) {
+  FollowFile **slot = &g_table[hash_path(path) & (g_table_cap - 1)];
+  while (*slot && strcmp((*slot)->path, path) != 0)
+    slot = &(*slot)->hnext;
+  return slot;
+}
+
+static void table_grow(void) {
+  size_t cap = g_table_cap ? g_table_cap * 2 : 1024;
+  FollowFile **old = g_table;
+  size_t old_cap = g_table_cap;
+  g_table = calloc(cap, sizeof(FollowFile *));
+  if (!g_table) {
+    perror("sash: calloc");
+    exit(1);
+  }
+  g_table_cap = cap;
+  for (size_t i = 0; i < old_cap; i++) {
+    FollowFile *f = old[i];
+    while (f) {
+      FollowFile *next = f->hnext;
+      FollowFile **slot = &g_table[hash_path(f->path) & (cap - 1)];
+      f->hnext = *slot;
+      *slot = f;
+      f = next;
+    }
+  }
+  free(old);
+}
+
+/* ── Open-file LRU ───────────────────────────────────────────────── */
+
+static void lru_unlink(FollowFile *f) {
+  if (f->prev)
+    f->prev->next = f->next;
+  else
+    g_lru_head = f->next;
+  if (f->next)
+    f->next->prev = f->prev;
+  else
+    g_lru_tail = f->prev;
+  f->prev = f->next = NULL;
+}
+
+static void lru_push(FollowFile *f) {
+  f->next = g_lru_head;
+  f->prev = NULL;
+  if (g_lru_head)
+    g_lru_head->prev = f;
+  g_lru_head = f;
+  if (!g_lru_tail)
+    g_lru_tail = f;
+}
+
+static void file_close(FollowFile *f) {
+  if (f->fd < 0)
+    return;
+  lru_unlink(f);
+  close(f->fd);
+  f->fd = -1;
+  g_nopen--;
+}
+
+/*
+ * Make sure the file is open and most recently used, closing the least
+ * recently used one if that would go over budget.  A file replaced since
+ * it was closed (new inode) is read from the start.
+ */
+static bool file_open(FollowFile *f) {
+  if (f->fd >= 0) {
+    lru_unlink(f);
+    lru_push(f);
+    return true;
+  }
+  while (g_nopen >= g_max_open && g_lru_tail)
+    file_close(g_lru_tail);
+  int fd = open(f->path, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return false;
+  }
+  if (f->ino && (st.st_dev != f->dev || st.st_ino != f->ino)) {
+    f->offset = 0;
+    f->plen = 0;
+  }
+  if (f->ino)
+    g_reopens++;
+  f->dev = st.st_dev;
+  f->ino = st.st_ino;
+  f->fd = fd;
+  if (++g_nopen > g_peak_open)
+    g_peak_open = g_nopen;
+  lru_push(f);
+  return true;
+}
+
+/* ── Reading ─────────────────────────────────────────────────────── */
+
+static void keep_partial(FollowFile *f, const char *s, size_t n) {
+  f->partial = realloc(f->partial, f->plen + n);
+  if (!f->partial) {
+    perror("sash: realloc");
+    exit(1);
+  }
+  memcpy(f->partial + f->plen, s, n);
+  f->plen += n;
+}
+
+/* Emit the complete lines in buf, joining the first to any carried tail. */
+static void split_lines(FollowFile *f, const char *buf, size_t n, line_fn fn) {
+  const char *p = buf, *end = buf + n;
+  const char *nl;
+  while ((nl = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+    size_t len = (size_t)(nl - p) + 1;
+    if (f->plen > 0) {
+      keep_partial(f, p, len);
+      fn(f->partial, f->plen, f->path);
+      f->plen = 0;
+    } else {
+      fn(p, len, f->path);
+    }
+    p = nl + 1;
+  }
+  if (p < end)
+    keep_partial(f, p, (size_t)(end - p));
+  if (f->plen > FOLLOW_MAX_PARTIAL) {
+    fn(f->partial, f->plen, f->path);
+    f->plen = 0;
+  }
+}
+
+/* Read whatever has been appended since the last read. */
+static void file_read(FollowFile *f, line_fn fn) {
+  if (!file_open(f))
+    return;
+  struct stat st;
+  if (fstat(f->fd, &st) == 0 && st.st_size < f->offset) {
+    f->offset = 0; /* truncated: start over */
+    f->plen = 0;
+  }
+  ssize_t n;
+  while ((n = pread(f->fd, g_chunk, FOLLOW_READ_CHUNK, f->offset)) > 0) {
+    f->offset += n;
+    split_lines(f, g_chunk, (size_t)n, fn);
+  }
+}
+
+static FollowFile *file_find(const char *path) {
+  if (g_table_cap == 0)
+    return NULL;
+  return *table_slot(path);
+}
+
+static FollowFile *file_add(char *path, bool from_end) {
+  if ((g_nfiles + 1) * 2 > g_table_cap)
+    table_grow();
+  FollowFile **slot = table_slot(path);
+  if (*slot) {
+    free(path);
+    return *slot;
+  }
+  FollowFile *f = calloc(1, sizeof(*f));
+  if (!f) {
+    perror("sash: calloc");
+    exit(1);
+  }
+  f->path = path;
+  f->fd = -1;
+  if (from_end) {
+    struct stat st;
+    if (stat(path, &st) == 0) {
+      f->offset = st.st_size;
+      f->dev = st.st_dev;
+      f->ino = st.st_ino;
+    }
+  }
+  *slot = f;
+  g_nfiles++;
+  return f;
+}
+
+/* Drain what's left of a file that was deleted or moved away, then drop
+   it.  A pending unterminated line is emitted as is. */
+static void file_remove(const char *path, line_fn fn) {
+  if (g_table_cap == 0)
+    return;
+  FollowFile **slot = table_slot(path);
+  FollowFile *f = *slot;
+  if (!f)
+    return;
+  if (f->fd >= 0)
+    file_read(f, fn);
+  if (f->plen > 0)
+    fn(f->partial, f->plen, f->path);
+  file_close(f);
+  *slot = f->hnext;
+  g_nfiles--;
+  free(f->partial);
+  free(f->path);
+  free(f);
+}
+
+/*
+ * A file was created or renamed onto a name we follow.  If the name now
+ * refers to another file, finish the old one (while it's still open) and
+ * start the new one from its first byte.
+ */
+static void file_check_replaced(FollowFile *f, line_fn fn) {
+  struct stat st;
+  if (!f->ino || stat(f->path, &st) == -1 ||
+      (st.st_dev == f->dev && st.st_ino == f->ino))
+    return;
+  if (f->fd >= 0)
+    file_read(f, fn);
+  if (f->plen > 0)
+    fn(f->partial, f->plen, f->path);
+  file_close(f);
+  f->ino = 0;
+  f->offset = 0;
+  f->plen = 0;
+}
+
+static bool name_matches(const char *name) {
+  return fnmatch(g_glob, name, FNM_PERIOD) == 0;
+}
+
+/* ── Directory watches ───────────────────────────────────────────── */
+
+/*
+ * Watch a directory and everything below it, following matching files:
+ * from their end at startup (from_end), from the start when the directory
+ * appeared later.  Symlinks are not followed.
+ */
+static void watch_tree(const char *path, bool from_end, line_fn fn) {
+  int wd = inotify_add_watch(g_inotify, path, DIR_EVENTS);
+  if (wd < 0) {
+    fprintf(stderr, "sash: cannot watch '%s': %s\n", path, strerror(errno));
+    return;
+  }
+  if (wd >= g_dirs_cap) {
+    int cap = g_dirs_cap ? g_dirs_cap : 64;
+    while (cap <= wd)
+      cap *= 2;
+    g_dirs = realloc(g_dirs, (size_t)cap * sizeof(char *));
+    if (!g_dirs) {
+      perror("sash: realloc");
+      exit(1);
+    }
+    memset(g_dirs + g_dirs_cap, 0, (size_t)(cap - g_dirs_cap) * sizeof(char *));
+    g_dirs_cap = cap;
+  }
+  if (!g_dirs[wd]) {
+    g_dirs[wd] = strdup(path);
+    if (!g_dirs[wd]) {
+      perror("sash: strdup");
+      exit(1);
+    }
+    g_ndirs++;
+  }
+
+  DIR *d = opendir(path);
+  if (!d)
+    return;
+  struct dirent *de;
+  while ((de = readdir(d)) != NULL) {
+    if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+      continue;
+    char *child = join_path(path, de->d_name);
+    struct stat st;
+    if (lstat(child, &st) == -1) {
+      free(child);
+      continue;
+    }
+    if (S_ISDIR(st.st_mode)) {
+      watch_tree(child, from_end, fn);
+      free(child);
+    } else if (S_ISREG(st.st_mode) && name_matches(de->d_name)) {
+      FollowFile *f = file_add(child, from_end);
+      if (!from_end && fn)
+        file_read(f, fn);
+    } else {
+      free(child);
+    }
+  }
+  closedir(d);
+}
+
+/* Events were lost: catch up on every file we know about. */
+static void rescan(line_fn fn) {
+  for (size_t i = 0; i < g_table_cap; i++) {
+    for (FollowFile *f = g_table[i]; f; f = f->hnext)
+      file_read(f, fn);
+  }
+}
+
+static void handle_event(const struct inotify_event *ev, line_fn fn) {
+  if (ev->mask & IN_Q_OVERFLOW) {
+    rescan(fn);
+    return;
+  }
+  if (ev->wd < 0 || ev->wd >= g_dirs_cap || !g_dirs[ev->wd])
+    return;
+  if (ev->mask & IN_IGNORED) {
+    free(g_dirs[ev->wd]);
+    g_dirs[ev->wd] = NULL;
+    g_ndirs--;
+    return;
+  }
+  if (ev->len == 0 || !ev->name[0])
+    return;
+
+  char *path = join_path(g_dirs[ev->wd], ev->name);
+  if (ev->mask & IN_ISDIR) {
+    if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+      watch_tree(path, false, fn);
+    free(path);
+    return;
+  }
+  if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+    file_remove(path, fn);
+    free(path);
+    return;
+  }
+  FollowFile *f = file_find(path);
+  if (!f) {
+    if (!name_matches(ev->name)) {
+      free(path);
+      return;
+    }
+    f = file_add(path, false); /* takes path */
+  } else {
+    free(path);
+    if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+      file_check_replaced(f, fn);
+  }
+  file_read(f, fn);
+}
+
+/* ── Public API ──────────────────────────────────────────────────── */
+
+bool follow_open(const char *const *dirs, int ndirs, const char *glob) {
+  g_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (g_inotify < 0) {
+    perror("sash: inotify_init1");
+    return false;
+  }
+  g_glob = strdup(glob ? glob : "*");
+  g_chunk = xmalloc(FOLLOW_READ_CHUNK);
+  if (!g_glob) {
+    perror("sash: strdup");
+    exit(1);
+  }
+
+  /* leave the other half of the fd limit for output files and clients */
+  struct rlimit rl;
+  g_max_open = FOLLOW_MAX_OPEN;
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY &&
+      rl.rlim_cur / 2 < (rlim_t)g_max_open)
+    g_max_open = (int)(rl.rlim_cur / 2);
+  if (g_max_open < 4)
+    g_max_open = 4;
+
+  for (int i = 0; i < ndirs; i++) {
+    struct stat st;
+    if (stat(dirs[i], &st) == -1 || !S_ISDIR(st.st_mode)) {
+      fprintf(stderr, "sash: not a directory: '%s'\n", dirs[i]);
+      return false;
+    }
+    watch_tree(dirs[i], true, NULL);
+  }
+  return true;
+}
+
+int follow_fd(void) { return g_inotify; }
+
+/* Process every queued event. */
+void follow_handle(line_fn fn) {
+  char buf[65536] __attribute__((aligned(__alignof__(struct inotify_event))));
+  for (;;) {
+    ssize_t n = read(g_inotify, buf, sizeof(buf));
+    if (n <= 0)
+      break;
+    for (char *p = buf; p < buf + n;) {
+      const struct inotify_event *ev = (const struct inotify_event *)p;
+      handle_event(ev, fn);
+      p += sizeof(*ev) + ev->len;
+    }
+  }
+}
+
+void follow_print_stats(FILE *out) {
+  fprintf(out,
+          "sash: followed %zu files in %d directories, %d open at most "
+          "(limit %d), %llu reopens\n",
+          g_nfiles, g_ndirs, g_peak_open, g_max_open, g_reopens);
+}
+
+/* Emit pending unterminated lines and release everything.  The counts
+   stay for follow_print_stats(). */
+void follow_close(line_fn fn) {
+  for (size_t i = 0; i < g_table_cap; i++) {
+    FollowFile *f = g_table[i];
+    while (f) {
+      FollowFile *next = f->hnext;
+      if (f->plen > 0 && fn)
+        fn(f->partial, f->plen, f->path);
+      if (f->fd >= 0)
+        close(f->fd);
+      free(f->partial);
+      free(f->path);
+      free(f);
+      f = next;
+    }
+  }
+  free(g_table);
+  g_table = NULL;
+  g_table_cap = 0;
+  g_lru_head = g_lru_tail = NULL;
+  g_nopen = 0;
+  for (int i = 0; i < g_dirs_cap; i++)
+    free(g_dirs[i]);
+  free(g_dirs);
+  g_dirs = NULL;
+  g_dirs_cap = 0;
+  free(g_glob);
+  g_glob = NULL;
+  free(g_chunk);
+  g_chunk = NULL;
+  if (g_inotify >= 0)
+    close(g_inotify);
+  g_inotify = -1;
+}
+
+#else /* !__linux__ */
+
+bool follow_open(const char *const *dirs, int ndirs, const char *glob) {
+  (void)dirs;
+  (void)ndirs;
+  (void)glob;
+  fprintf(stderr, "sash: --follow-dir needs inotify (Linux only)\n");
+  return false;
+}
+
+int follow_fd(void) { return -1; }
+void follow_handle(line_fn fn) { (void)fn; }
+void follow_print_stats(FILE *out) { (void)out; }
+void follow_close(line_fn fn) { (void)fn; }
+
+#endif
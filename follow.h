@@ -0,0 +1,21 @@
+/*
+ * follow.h - Following files across directory trees
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "input.h"
+
+bool follow_open(const char *const *dirs, int ndirs, const char *glob);
+int follow_fd(void);
+void follow_handle(line_fn fn);
+void follow_print_stats(FILE *out);
+void follow_close(line_fn fn);
+
+#endif /* FOLLOW_H */
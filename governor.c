@@ -0,0 +1,105 @@
+/*
+ * governor.c - CPU budget governor
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Keeps sash's own CPU use under a budget by trading away rendering
+ * fidelity.  The caller samples process CPU time (user + system, all
+ * threads) periodically; usage is averaged over the last GOV_SAMPLES
+ * samples.  Over budget, the level goes up one step and the window is
+ * cleared so the next decision sees the new level's cost.  Back under half
+ * the budget for a whole window, it comes down one step.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "governor.h"
+
+uint64_t process_cpu_ns(void) {
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) == -1)
+    return 0;
+  return (uint64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000ULL +
+         (uint64_t)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL;
+}
+
+static void window_reset(Governor *g) {
+  g->nsamples = 0;
+  g->head = 0;
+  g->calm = 0;
+}
+
+void governor_init(Governor *g, double budget, uint64_t cpu, uint64_t now) {
+  memset(g, 0, sizeof(*g));
+  g->budget = budget;
+  g->last_cpu = cpu;
+  g->last_wall = now;
+}
+
+/* CPU used over the window, as a fraction of one CPU. */
+double governor_usage(const Governor *g) {
+  uint64_t cpu = 0, wall = 0;
+  for (int i = 0; i < g->nsamples; i++) {
+    cpu += g->cpu[i];
+    wall += g->wall[i];
+  }
+  return wall > 0 ? (double)cpu / (double)wall : 0;
+}
+
+/* Record a sample; returns true if the level changed. */
+bool governor_sample(Governor *g, uint64_t cpu, uint64_t now) {
+  g->cpu[g->head] = cpu - g->last_cpu;
+  g->wall[g->head] = now - g->last_wall;
+  g->last_cpu = cpu;
+  g->last_wall = now;
+  g->head = (g->head + 1) % GOV_SAMPLES;
+  if (g->nsamples < GOV_SAMPLES)
+    g->nsamples++;
+
+  double usage = governor_usage(g);
+  if (usage > g->budget) {
+    g->calm = 0;
+    if (g->level == GOV_MAX_LEVEL)
+      return false;
+    g->level++;
+    if (g->level > g->peak)
+      g->peak = g->level;
+    window_reset(g);
+    return true;
+  }
+
+  if (usage < g->budget / 2 && g->level > 0) {
+    if (++g->calm < GOV_SAMPLES)
+      return false;
+    g->level--;
+    window_reset(g);
+    return true;
+  }
+
+  g->calm = 0;
+  return false;
+}
+
+/* "5%" or "5" -> 0.05.  Above 100% is allowed (several threads). */
+bool parse_percent(const char *s, double *fraction) {
+  char *end;
+  errno = 0;
+  double v = strtod(s, &end);
+  if (errno != 0 || end == s || v <= 0)
+    return false;
+  if (*end == '%')
+    end++;
+  if (*end != '\0')
+    return false;
+  *fraction = v / 100;
+  return true;
+}
@@ -0,0 +1,36 @@
+/*
+ * governor.h - CPU budget governor
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define GOV_MAX_LEVEL 3
+#define GOV_SAMPLES 4 /* the sliding window, in samples */
+
+typedef struct {
+  double budget; /* fraction of one CPU, e.g. 0.05 */
+  int level;     /* 0 = full fidelity .. GOV_MAX_LEVEL */
+  int peak;      /* highest level reached */
+  int calm;      /* consecutive windows well under budget */
+  uint64_t cpu[GOV_SAMPLES];
+  uint64_t wall[GOV_SAMPLES];
+  int nsamples;
+  int head;
+  uint64_t last_cpu;
+  uint64_t last_wall;
+} Governor;
+
+uint64_t process_cpu_ns(void);
+
+void governor_init(Governor *g, double budget, uint64_t cpu, uint64_t now);
+bool governor_sample(Governor *g, uint64_t cpu, uint64_t now);
+double governor_usage(const Governor *g);
+bool parse_percent(const char *s, double *fraction);
+
+#endif /* GOVERNOR_H */
@@ -0,0 +1,292 @@
+/*
+ * history.c - Compressed line history
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * The ring behind the window holds what fits on screen; the history
+ * holds the last N lines of the stream in far less memory.  Lines are
+ * appended to a raw "hot" block; once it reaches HISTORY_BLOCK_SIZE it
+ * is sealed: compressed with lz.c into a block of its own, so pushing a
+ * line is a memcpy and compression runs once per 64 KB.  Whole blocks
+ * are dropped from the old end while the rest still holds N lines.
+ *
+ * Reading (a dump on SIGUSR1, or a --serve client's backlog, one block
+ * at a time as the client takes it) decompresses a block at a time into
+ * a scratch buffer, skipping whole blocks to reach a starting line.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "history.h"
+#include "lz.h"
+
+typedef struct {
+  char *data; /* compressed */
+  uint32_t comp_len;
+  uint32_t raw_len;
+  uint32_t nlines;
+} Block;
+
+struct History {
+  uint64_t max_lines;
+  Block *blocks; /* sealed, oldest at blocks[head] */
+  size_t head, nblocks, cap;
+  uint64_t sealed_lines;
+  uint64_t sealed_raw;
+  uint64_t sealed_comp;
+  uint64_t evicted;
+
+  char *hot; /* newest lines, uncompressed */
+  size_t hot_len, hot_cap;
+  uint32_t hot_lines;
+
+  char *scratch; /* one decompressed block */
+  size_t scratch_cap;
+};
+
+static void *xrealloc(void *p, size_t n) {
+  p = realloc(p, n);
+  if (!p) {
+    perror("sash: realloc");
+    exit(1);
+  }
+  return p;
+}
+
+History *history_new(uint64_t max_lines) {
+  History *h = calloc(1, sizeof(*h));
+  if (!h) {
+    perror("sash: calloc");
+    exit(1);
+  }
+  h->max_lines = max_lines;
+  h->hot_cap = HISTORY_BLOCK_SIZE;
+  h->hot = xrealloc(NULL, h->hot_cap);
+  return h;
+}
+
+/* Drop the oldest blocks while the others still hold max_lines. */
+static void evict(History *h) {
+  while (h->nblocks > 0) {
+    Block *b = &h->blocks[h->head];
+    if (h->sealed_lines + h->hot_lines - b->nlines < h->max_lines)
+      break;
+    h->sealed_lines -= b->nlines;
+    h->sealed_raw -= b->raw_len;
+    h->sealed_comp -= b->comp_len;
+    h->evicted += b->nlines;
+    free(b->data);
+    h->head++;
+    h->nblocks--;
+  }
+}
+
+static void seal(History *h) {
+  char *comp = xrealloc(NULL, LZ_BOUND(h->hot_len));
+  size_t comp_len = lz_compress(h->hot, h->hot_len, comp);
+  comp = xrealloc(comp, comp_len ? comp_len : 1);
+
+  if (h->head + h->nblocks == h->cap) {
+    if (h->head > h->cap / 2) {
+      /* reuse the slots evicted blocks left at the front */
+      memmove(h->blocks, h->blocks + h->head, h->nblocks * sizeof(Block));
+      h->head = 0;
+    } else {
+      h->cap = h->cap ? h->cap * 2 : 64;
+      h->blocks = xrealloc(h->blocks, h->cap * sizeof(Block));
+    }
+  }
+  h->blocks[h->head + h->nblocks++] = (Block){
+      .data = comp,
+      .comp_len = (uint32_t)comp_len,
+      .raw_len = (uint32_t)h->hot_len,
+      .nlines = h->hot_lines,
+  };
+  h->sealed_lines += h->hot_lines;
+  h->sealed_raw += h->hot_len;
+  h->sealed_comp += comp_len;
+  h->hot_len = 0;
+  h->hot_lines = 0;
+  evict(h);
+}
+
+/* Append a line; a missing trailing newline is added. */
+void history_push(History *h, const char *line, size_t len) {
+  if (len > 0 && line[len - 1] == '\n')
+    len--;
+  if (h->hot_len + len + 1 > h->hot_cap) {
+    if (h->hot_len > 0)
+      seal(h);
+    if (len + 1 > h->hot_cap) { /* one line longer than a block */
+      h->hot_cap = len + 1;
+      h->hot = xrealloc(h->hot, h->hot_cap);
+    }
+  }
+  memcpy(h->hot + h->hot_len, line, len);
+  h->hot[h->hot_len + len] = '\n';
+  h->hot_len += len + 1;
+  h->hot_lines++;
+  if (h->hot_len >= HISTORY_BLOCK_SIZE)
+    seal(h);
+}
+
+uint64_t history_count(const History *h) {
+  return h->sealed_lines + h->hot_lines;
+}
+
+/* Call fn on lines [skip, nlines) of raw[0, len). */
+static bool each_line(const char *raw, size_t len, uint64_t skip,
+                      history_fn fn, void *ctx) {
+  const char *p = raw, *end = raw + len;
+  while (p < end) {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    const char *next = nl ? nl + 1 : end;
+    if (skip > 0)
+      skip--;
+    else if (!fn(p, (size_t)(next - p), ctx))
+      return false;
+    p = next;
+  }
+  return true;
+}
+
+/* Decompress a sealed block into the scratch buffer. */
+static bool unpack(History *h, const Block *b) {
+  if (b->raw_len > h->scratch_cap) {
+    h->scratch_cap = b->raw_len;
+    h->scratch = xrealloc(h->scratch, h->scratch_cap);
+  }
+  if (!lz_decompress(b->data, b->comp_len, h->scratch, b->raw_len)) {
+    fprintf(stderr, "sash: corrupt history block\n");
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Call fn on each kept line from index `from` (0 = the oldest) onwards.
+ * Returns false if fn stopped early or a block failed to decompress.
+ */
+bool history_each(History *h, uint64_t from, history_fn fn, void *ctx) {
+  for (size_t i = 0; i < h->nblocks; i++) {
+    Block *b = &h->blocks[h->head + i];
+    if (from >= b->nlines) {
+      from -= b->nlines;
+      continue;
+    }
+    if (!unpack(h, b))
+      return false;
+    if (!each_line(h->scratch, b->raw_len, from, fn, ctx))
+      return false;
+    from = 0;
+  }
+  return each_line(h->hot, h->hot_len, from, fn, ctx);
+}
+
+/*
+ * Call fn on line `from` and the rest of the block holding it, so a
+ * reader that can't take everything at once can go a block at a time.
+ * Returns how many lines that was: 0 past the end or for a corrupt block.
+ */
+size_t history_each_block(History *h, uint64_t from, history_fn fn,
+                          void *ctx) {
+  for (size_t i = 0; i < h->nblocks; i++) {
+    Block *b = &h->blocks[h->head + i];
+    if (from >= b->nlines) {
+      from -= b->nlines;
+      continue;
+    }
+    if (!unpack(h, b))
+      return 0;
+    each_line(h->scratch, b->raw_len, from, fn, ctx);
+    return (size_t)(b->nlines - from);
+  }
+  if (from >= h->hot_lines)
+    return 0;
+  each_line(h->hot, h->hot_len, from, fn, ctx);
+  return (size_t)(h->hot_lines - from);
+}
+
+static bool write_line(const char *line, size_t len, void *ctx) {
+  return fwrite(line, 1, len, ctx) == len;
+}
+
+/*
+ * Write every kept line to PATH.tmp and rename it over path.  Returns
+ * false (after reporting why) on failure.
+ */
+bool history_write(History *h, const char *path) {
+  size_t n = strlen(path);
+  char *tmp = malloc(n + sizeof(".tmp"));
+  if (!tmp) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  memcpy(tmp, path, n);
+  memcpy(tmp + n, ".tmp", sizeof(".tmp"));
+
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  FILE *fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+  if (!fp) {
+    fprintf(stderr, "sash: cannot write history '%s': %s\n", tmp,
+            strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    free(tmp);
+    return false;
+  }
+
+  bool ok = history_each(h, 0, write_line, fp);
+  if (fclose(fp) != 0)
+    ok = false;
+  if (ok && rename(tmp, path) == -1)
+    ok = false;
+  if (!ok) {
+    fprintf(stderr, "sash: cannot write history '%s': %s\n", path,
+            strerror(errno));
+    unlink(tmp);
+  }
+  free(tmp);
+  return ok;
+}
+
+void history_stats(const History *h, HistoryStats *st) {
+  st->lines = history_count(h);
+  st->blocks = h->nblocks;
+  st->raw_bytes = h->sealed_raw + h->hot_len;
+  st->stored_bytes = h->sealed_comp + h->hot_cap;
+  st->evicted = h->evicted;
+}
+
+void history_print_stats(const History *h) {
+  HistoryStats st;
+  history_stats(h, &st);
+  fprintf(stderr,
+          "sash: history: %llu lines in %llu blocks, %.1f MB of text "
+          "in %.1f MB (%.1fx)\n",
+          (unsigned long long)st.lines, (unsigned long long)st.blocks,
+          st.raw_bytes / 1048576.0, st.stored_bytes / 1048576.0,
+          st.stored_bytes ? (double)st.raw_bytes / st.stored_bytes : 0.0);
+}
+
+void history_free(History *h) {
+  if (!h)
+    return;
+  for (size_t i = 0; i < h->nblocks; i++)
+    free(h->blocks[h->head + i].data);
+  free(h->blocks);
+  free(h->hot);
+  free(h->scratch);
+  free(h);
+}
@@ -0,0 +1,40 @@
+/*
+ * history.h - Compressed line history
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTORY_BLOCK_SIZE (64 * 1024) /* raw bytes per sealed block */
+
+typedef struct History History;
+
+typedef struct {
+  uint64_t lines;        /* lines kept */
+  uint64_t blocks;       /* sealed blocks */
+  uint64_t raw_bytes;    /* text kept, uncompressed */
+  uint64_t stored_bytes; /* what it takes: sealed blocks + the hot block */
+  uint64_t evicted;      /* lines dropped off the old end */
+} HistoryStats;
+
+/* Called per line, newline included; return false to stop. */
+typedef bool (*history_fn)(const char *line, size_t len, void *ctx);
+
+History *history_new(uint64_t max_lines);
+void history_push(History *h, const char *line, size_t len);
+uint64_t history_count(const History *h);
+bool history_each(History *h, uint64_t from, history_fn fn, void *ctx);
+size_t history_each_block(History *h, uint64_t from, history_fn fn,
+                          void *ctx);
+bool history_write(History *h, const char *path);
+void history_stats(const History *h, HistoryStats *st);
+void history_print_stats(const History *h);
+void history_free(History *h);
+
+#endif /* HISTORY_H */
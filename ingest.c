@@ -0,0 +1,373 @@
+/*
+ * ingest.c - Reading inputs on several threads
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * With --reader-threads, the -r files are read by a pool of threads
+ * instead of one after another on the main thread.  Each reader takes the
+ * next unclaimed file, reads it to the end, splits it into lines and
+ * publishes batches of whole lines into a bounded multi-producer,
+ * single-consumer ring.  The main thread drains the ring and does
+ * everything else (window, files, clients) as before.
+ *
+ * The ring is an array of slots with sequence numbers (Vyukov's bounded
+ * queue): producers claim a slot with one CAS on the tail, the consumer
+ * owns the head outright, and neither takes a lock.  A file is read by
+ * one thread, which publishes its batches in order, so lines from one
+ * file keep their order; lines from different files interleave by batch.
+ * A full ring makes readers wait rather than drop, so counts are exact.
+ *
+ * The consumer sleeps in poll() on a pipe.  Before sleeping it sets
+ * `sleeping` and checks the ring once more; a producer that publishes
+ * while it is set writes one byte to wake it.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ingest.h"
+
+#ifndef INGEST_RING_SLOTS
+#define INGEST_RING_SLOTS 256 /* power of two */
+#endif
+#define INGEST_READ_SIZE 65536
+#define INGEST_MAX_THREADS 64
+
+/* ── Ring ────────────────────────────────────────────────────────── */
+
+typedef struct {
+  atomic_size_t seq;
+  IngestBatch *batch;
+} Slot;
+
+static Slot g_slots[INGEST_RING_SLOTS];
+static atomic_size_t g_tail; /* next slot producers claim */
+static size_t g_head;        /* next slot the consumer reads */
+
+static void ring_init(void) {
+  for (size_t i = 0; i < INGEST_RING_SLOTS; i++)
+    atomic_init(&g_slots[i].seq, i);
+  atomic_init(&g_tail, 0);
+  g_head = 0;
+}
+
+/* Publish a batch; false if the ring is full. */
+static bool ring_push(IngestBatch *b) {
+  size_t pos = atomic_load_explicit(&g_tail, memory_order_relaxed);
+  for (;;) {
+    Slot *s = &g_slots[pos & (INGEST_RING_SLOTS - 1)];
+    size_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&g_tail, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        s->batch = b;
+        atomic_store_explicit(&s->seq, pos + 1, memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = atomic_load_explicit(&g_tail, memory_order_relaxed);
+    }
+  }
+}
+
+/* Take the oldest batch, or NULL if the ring is empty.  Consumer only. */
+static IngestBatch *ring_pop(void) {
+  Slot *s = &g_slots[g_head & (INGEST_RING_SLOTS - 1)];
+  size_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+  if (seq != g_head + 1)
+    return NULL;
+  IngestBatch *b = s->batch;
+  atomic_store_explicit(&s->seq, g_head + INGEST_RING_SLOTS,
+                        memory_order_release);
+  g_head++;
+  return b;
+}
+
+/* ── Readers ─────────────────────────────────────────────────────── */
+
+static const int *g_fds = NULL;
+static int g_nfds = 0;
+static atomic_int g_next_fd;  /* next file a reader claims */
+static atomic_int g_live;     /* readers still running */
+static atomic_bool g_stop;
+static atomic_bool g_sleeping; /* consumer is (about to be) in poll() */
+static int g_wake[2] = {-1, -1};
+static pthread_t g_threads[INGEST_MAX_THREADS];
+static int g_nthreads = 0;
+static int g_nthreads_started = 0; /* for the stats, after the join */
+
+static atomic_ullong g_batches;
+static atomic_ullong g_full_waits;
+
+static void wake_consumer(void) {
+  /* order the publish before reading `sleeping` (pairs with drain) */
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_exchange(&g_sleeping, false)) {
+    char c = 0;
+    ssize_t n = write(g_wake[1], &c, 1);
+    (void)n; /* a full pipe already wakes it */
+  }
+}
+
+/* Publish, waiting for the consumer while the ring is full. */
+static bool publish(IngestBatch *b) {
+  unsigned spins = 0;
+  while (!ring_push(b)) {
+    if (atomic_load(&g_stop))
+      return false;
+    if (spins++ == 0)
+      atomic_fetch_add_explicit(&g_full_waits, 1, memory_order_relaxed);
+    if (spins < 64) {
+      sched_yield();
+    } else {
+      struct timespec ts = {0, 50000};
+      nanosleep(&ts, NULL);
+    }
+    wake_consumer();
+  }
+  atomic_fetch_add_explicit(&g_batches, 1, memory_order_relaxed);
+  wake_consumer();
+  return true;
+}
+
+typedef struct {
+  uint32_t *ends;
+  uint32_t cap;
+} Ends;
+
+/* Copy the lines in buf[0, len) (all complete except perhaps the last)
+   into one allocation and publish it. */
+static bool publish_lines(int source, const char *buf, size_t len,
+                          Ends *e) {
+  uint32_t n = 0;
+  for (const char *p = buf, *end = buf + len; p < end;) {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    p = nl ? nl + 1 : end;
+    if (n == e->cap) {
+      e->cap = e->cap ? e->cap * 2 : 1024;
+      e->ends = realloc(e->ends, e->cap * sizeof(uint32_t));
+      if (!e->ends) {
+        perror("sash: realloc");
+        exit(1);
+      }
+    }
+    e->ends[n++] = (uint32_t)(p - buf);
+  }
+
+  IngestBatch *b =
+      malloc(sizeof(IngestBatch) + n * sizeof(uint32_t) + len);
+  if (!b) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  uint32_t *ends = (uint32_t *)(b + 1);
+  char *data = (char *)(ends + n);
+  memcpy(ends, e->ends, n * sizeof(uint32_t));
+  memcpy(data, buf, len);
+  *b = (IngestBatch){.source = source,
+                     .nlines = n,
+                     .len = len,
+                     .ends = ends,
+                     .data = data};
+  if (!publish(b)) {
+    free(b);
+    return false;
+  }
+  return true;
+}
+
+/* Read one source to its end, a batch per read. */
+static void read_source(int source, char **bufp, size_t *capp, Ends *e) {
+  int fd = g_fds[source];
+  size_t len = 0;
+  for (;;) {
+    if (*capp - len < INGEST_READ_SIZE) {
+      *capp = len + INGEST_READ_SIZE;
+      *bufp = realloc(*bufp, *capp);
+      if (!*bufp) {
+        perror("sash: realloc");
+        exit(1);
+      }
+    }
+    char *buf = *bufp;
+    ssize_t n = read(fd, buf + len, *capp - len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      fprintf(stderr, "sash: read: %s\n", strerror(errno));
+    if (n <= 0)
+      break;
+    size_t scanned = len;
+    len += (size_t)n;
+
+    /* publish up to the last newline, keep the rest for the next read */
+    const char *last = NULL;
+    for (const char *p = buf + len; p > buf + scanned;) {
+      if (*--p == '\n') {
+        last = p;
+        break;
+      }
+    }
+    if (!last)
+      continue; /* a line longer than one read: grow and keep reading */
+    size_t whole = (size_t)(last - buf) + 1;
+    if (!publish_lines(source, buf, whole, e))
+      return;
+    memmove(buf, buf + whole, len - whole);
+    len -= whole;
+  }
+  if (len > 0)
+    publish_lines(source, *bufp, len, e);
+}
+
+static void *reader_main(void *arg) {
+  (void)arg;
+  char *buf = NULL;
+  size_t cap = 0;
+  Ends e = {NULL, 0};
+  int source;
+  while (!atomic_load(&g_stop) &&
+         (source = atomic_fetch_add(&g_next_fd, 1)) < g_nfds)
+    read_source(source, &buf, &cap, &e);
+  free(buf);
+  free(e.ends);
+  atomic_fetch_sub(&g_live, 1);
+  atomic_store(&g_sleeping, true); /* always wake: we may be the last */
+  wake_consumer();
+  return NULL;
+}
+
+/* ── Public API ──────────────────────────────────────────────────── */
+
+/*
+ * Start nthreads readers (at most one per fd) over the given fds, which
+ * must stay open until ingest_stop().  Returns false if no thread could
+ * be started.
+ */
+bool ingest_start(const int *fds, int nfds, int nthreads) {
+  ring_init();
+  g_fds = fds;
+  g_nfds = nfds;
+  atomic_init(&g_next_fd, 0);
+  atomic_init(&g_stop, false);
+  atomic_init(&g_sleeping, true); /* the consumer starts in poll() */
+  atomic_init(&g_batches, 0);
+  atomic_init(&g_full_waits, 0);
+  if (pipe(g_wake) == -1) {
+    perror("sash: pipe");
+    return false;
+  }
+  for (int i = 0; i < 2; i++) {
+    fcntl(g_wake[i], F_SETFL, O_NONBLOCK);
+    fcntl(g_wake[i], F_SETFD, FD_CLOEXEC);
+  }
+
+  if (nthreads > nfds)
+    nthreads = nfds;
+  if (nthreads > INGEST_MAX_THREADS)
+    nthreads = INGEST_MAX_THREADS;
+  atomic_init(&g_live, nthreads);
+
+  /* signals stay with the main thread */
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &old);
+  g_nthreads = 0;
+  for (int i = 0; i < nthreads; i++) {
+    int err = pthread_create(&g_threads[i], NULL, reader_main, NULL);
+    if (err) {
+      fprintf(stderr, "sash: cannot start reader thread: %s\n",
+              strerror(err));
+      atomic_fetch_sub(&g_live, nthreads - i);
+      break;
+    }
+    g_nthreads++;
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  g_nthreads_started = g_nthreads;
+  return g_nthreads > 0;
+}
+
+/* Readable when batches may be waiting. */
+int ingest_fd(void) { return g_wake[0]; }
+
+static uint64_t mono_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Hand queued batches to fn, for at most max_ns so a flood doesn't starve
+ * the rest of the loop.  Returns false once every reader has finished and
+ * the ring is empty.
+ */
+bool ingest_drain(batch_fn fn, void *ctx, uint64_t max_ns) {
+  char sink[256];
+  while (read(g_wake[0], sink, sizeof(sink)) > 0)
+    ;
+
+  uint64_t start = mono_ns();
+  for (;;) {
+    IngestBatch *b = ring_pop();
+    if (!b) {
+      /* announce we're going to sleep, then look once more */
+      atomic_store(&g_sleeping, true);
+      atomic_thread_fence(memory_order_seq_cst);
+      bool live = atomic_load(&g_live) > 0;
+      b = ring_pop();
+      if (!b)
+        return live; /* readers finish publishing before they exit */
+      atomic_store(&g_sleeping, false);
+    }
+    fn(b, ctx);
+    free(b);
+    if (mono_ns() - start >= max_ns) {
+      /* more may be queued: make sure poll() comes straight back */
+      atomic_store(&g_sleeping, true);
+      wake_consumer();
+      return true;
+    }
+  }
+}
+
+/* Stop the readers (early, if they're still going) and release it all. */
+void ingest_stop(void) {
+  atomic_store(&g_stop, true);
+  for (int i = 0; i < g_nthreads; i++)
+    pthread_join(g_threads[i], NULL);
+  g_nthreads = 0;
+  IngestBatch *b;
+  while ((b = ring_pop()) != NULL)
+    free(b);
+  for (int i = 0; i < 2; i++) {
+    if (g_wake[i] >= 0)
+      close(g_wake[i]);
+    g_wake[i] = -1;
+  }
+}
+
+void ingest_print_stats(FILE *out) {
+  fprintf(out, "sash: %llu batches from %d reader threads, %llu waits on "
+               "a full ring\n",
+          (unsigned long long)atomic_load(&g_batches), g_nthreads_started,
+          (unsigned long long)atomic_load(&g_full_waits));
+}
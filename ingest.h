@@ -0,0 +1,32 @@
+/*
+ * ingest.h - Reading inputs on several threads
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Complete lines read from one source, in order. */
+typedef struct {
+  int source;      /* index into the fds given to ingest_start() */
+  uint32_t nlines;
+  size_t len;
+  const uint32_t *ends; /* end offset of each line in data */
+  const char *data;
+} IngestBatch;
+
+typedef void (*batch_fn)(const IngestBatch *b, void *ctx);
+
+bool ingest_start(const int *fds, int nfds, int nthreads);
+int ingest_fd(void);
+bool ingest_drain(batch_fn fn, void *ctx, uint64_t max_ns);
+void ingest_stop(void);
+void ingest_print_stats(FILE *out);
+
+#endif /* INGEST_H */
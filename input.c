@@ -0,0 +1,137 @@
+/*
+ * input.c - Line splitting over a readable fd
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Replaces getline() on a FILE* so the main loop can multiplex the input
+ * with timers in poll().  Each fill does exactly one read() and hands every
+ * complete line to the callback; a partial trailing line is carried over to
+ * the next fill, and flushed without a newline at EOF (matching getline).
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "input.h"
+
+#define READ_CHUNK 65536
+
+void linereader_init(LineReader *lr, int fd) {
+  lr->fd = fd;
+  lr->buf = NULL;
+  lr->len = 0;
+  lr->cap = 0;
+  lr->eof = false;
+  lr->nonblock = false;
+}
+
+/* Start out holding len bytes already read: the partial line a replaced
+   sash process had read but not yet seen the end of. */
+void linereader_preload(LineReader *lr, const char *data, size_t len) {
+  if (len == 0)
+    return;
+  lr->buf = malloc(len);
+  if (!lr->buf) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  memcpy(lr->buf, data, len);
+  lr->len = lr->cap = len;
+}
+
+/*
+ * Make reads on the fd non-blocking, so a drain can simply read until
+ * EAGAIN.  Only for fds sash owns (the command's pipe): the O_NONBLOCK flag
+ * lives on the open file description, which an inherited stdin shares
+ * with other processes.
+ */
+void linereader_set_nonblock(LineReader *lr) {
+  int flags = fcntl(lr->fd, F_GETFL);
+  if (flags != -1 && fcntl(lr->fd, F_SETFL, flags | O_NONBLOCK) != -1)
+    lr->nonblock = true;
+}
+
+/*
+ * Read once from the fd and emit the complete lines now available.  Returns
+ * the read() result: >0 bytes read, 0 at EOF, -1 on error with errno set
+ * (EINTR and EAGAIN are for the caller to retry later).
+ */
+ssize_t linereader_fill(LineReader *lr, line_fn fn, void *ctx) {
+  if (lr->eof)
+    return 0;
+
+  if (lr->cap - lr->len < READ_CHUNK) {
+    size_t cap = lr->cap ? lr->cap : READ_CHUNK;
+    while (cap - lr->len < READ_CHUNK)
+      cap *= 2;
+    char *buf = realloc(lr->buf, cap);
+    if (!buf) {
+      perror("sash: realloc");
+      exit(1);
+    }
+    lr->buf = buf;
+    lr->cap = cap;
+  }
+
+  ssize_t n = read(lr->fd, lr->buf + lr->len, lr->cap - lr->len);
+  if (n < 0)
+    return -1;
+
+  if (n == 0) {
+    lr->eof = true;
+    if (lr->len > 0) {
+      fn(lr->buf, lr->len, ctx);
+      lr->len = 0;
+    }
+    return 0;
+  }
+
+  /* only the new bytes can contain a newline we haven't seen */
+  size_t start = 0;
+  size_t scan = lr->len;
+  lr->len += (size_t)n;
+  char *nl;
+  while ((nl = memchr(lr->buf + scan, '\n', lr->len - scan)) != NULL) {
+    size_t end = (size_t)(nl - lr->buf) + 1;
+    fn(lr->buf + start, end - start, ctx);
+    start = end;
+    scan = end;
+  }
+
+  if (start > 0) {
+    memmove(lr->buf, lr->buf + start, lr->len - start);
+    lr->len -= start;
+  }
+  return n;
+}
+
+/*
+ * Whether another fill would find data without blocking.  A non-blocking
+ * fd just says yes and lets the read report EAGAIN; otherwise ask FIONREAD
+ * (pipes, ttys and regular files all answer it).
+ */
+bool linereader_pending(const LineReader *lr) {
+  if (lr->eof)
+    return false;
+  if (lr->nonblock)
+    return true;
+  int avail = 0;
+  return ioctl(lr->fd, FIONREAD, &avail) == 0 && avail > 0;
+}
+
+void linereader_free(LineReader *lr) {
+  free(lr->buf);
+  lr->buf = NULL;
+  lr->len = 0;
+  lr->cap = 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * input.h - Line splitting over a readable fd
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+typedef void (*line_fn)(const char *line, size_t len, void *ctx);
+
+typedef struct {
+  int fd;
+  char *buf;
+  size_t len; /* bytes held (a partial trailing line) */
+  size_t cap;
+  bool eof;
+  bool nonblock; /* fd is O_NONBLOCK: reads end a drain with EAGAIN */
+} LineReader;
+
+void linereader_init(LineReader *lr, int fd);
+void linereader_preload(LineReader *lr, const char *data, size_t len);
+void linereader_set_nonblock(LineReader *lr);
+ssize_t linereader_fill(LineReader *lr, line_fn fn, void *ctx);
+bool linereader_pending(const LineReader *lr);
+void linereader_free(LineReader *lr);
+
+#endif /* INPUT_H */
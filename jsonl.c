@@ -0,0 +1,148 @@
+/*
+ * jsonl.c - JSON string escaping for the JSONL output
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Log text is mostly printable ASCII, so the escaper scans eight bytes at a
+ * time with word-wide bit tricks and copies runs that need nothing done
+ * to them in bulk.  Only a word holding a quote, backslash, control byte
+ * or non-ASCII byte is walked byte by byte.  Valid UTF-8 is copied as is;
+ * each byte of an invalid sequence becomes U+FFFD, so the output is always
+ * valid JSON and valid UTF-8.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "jsonl.h"
+
+#define ONES 0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+/*
+ * Nonzero if any byte of w is below 0x20, '"', '\\' or >= 0x80.  The
+ * zero-byte test can flag extra bytes next to a real hit but never flags a
+ * word without one, which is all the fast path needs.
+ */
+static inline uint64_t needs_escape(uint64_t w) {
+  uint64_t ctl = (w - ONES * 0x20) & ~w;
+  uint64_t q = w ^ (ONES * '"');
+  uint64_t b = w ^ (ONES * '\\');
+  q = (q - ONES) & ~q;
+  b = (b - ONES) & ~b;
+  return (ctl | q | b | w) & HIGHS;
+}
+
+/* Length of the valid UTF-8 sequence at s, or 0 if it isn't one. */
+static size_t utf8_len(const unsigned char *s, size_t n) {
+  unsigned char c = s[0];
+  size_t need;
+  if (c < 0xc2)
+    return 0; /* continuation byte or overlong 2-byte lead */
+  else if (c < 0xe0)
+    need = 2;
+  else if (c < 0xf0)
+    need = 3;
+  else if (c < 0xf5)
+    need = 4;
+  else
+    return 0;
+  if (n < need)
+    return 0;
+  for (size_t k = 1; k < need; k++) {
+    if ((s[k] & 0xc0) != 0x80)
+      return 0;
+  }
+  /* overlongs, surrogates and code points past U+10FFFF */
+  if ((c == 0xe0 && s[1] < 0xa0) || (c == 0xed && s[1] > 0x9f) ||
+      (c == 0xf0 && s[1] < 0x90) || (c == 0xf4 && s[1] > 0x8f))
+    return 0;
+  return need;
+}
+
+/* Escape one byte (or UTF-8 sequence) at in[i]; returns bytes consumed. */
+static size_t escape_one(char *out, size_t *o, const char *in, size_t i,
+                         size_t len) {
+  static const char hex[] = "0123456789abcdef";
+  unsigned char c = (unsigned char)in[i];
+  char esc = 0;
+
+  switch (c) {
+  case '"':
+    esc = '"';
+    break;
+  case '\\':
+    esc = '\\';
+    break;
+  case '\b':
+    esc = 'b';
+    break;
+  case '\f':
+    esc = 'f';
+    break;
+  case '\n':
+    esc = 'n';
+    break;
+  case '\r':
+    esc = 'r';
+    break;
+  case '\t':
+    esc = 't';
+    break;
+  }
+  if (esc) {
+    out[(*o)++] = '\\';
+    out[(*o)++] = esc;
+    return 1;
+  }
+  if (c < 0x20) {
+    memcpy(out + *o, "\\u00", 4);
+    out[*o + 4] = hex[c >> 4];
+    out[*o + 5] = hex[c & 0xf];
+    *o += 6;
+    return 1;
+  }
+  if (c < 0x80) {
+    out[(*o)++] = (char)c;
+    return 1;
+  }
+  size_t n = utf8_len((const unsigned char *)in + i, len - i);
+  if (n == 0) {
+    memcpy(out + *o, "\\ufffd", 6);
+    *o += 6;
+    return 1;
+  }
+  memcpy(out + *o, in + i, n);
+  *o += n;
+  return n;
+}
+
+/*
+ * Write the JSON string body for in[0, len) (no surrounding quotes) to out,
+ * which must hold JSON_ESCAPE_MAX(len) bytes.  Returns the length written.
+ */
+size_t json_escape(char *out, const char *in, size_t len) {
+  size_t i = 0, o = 0;
+  while (i < len) {
+    while (i + 8 <= len) {
+      uint64_t w;
+      memcpy(&w, in + i, 8);
+      if (needs_escape(w))
+        break;
+      memcpy(out + o, in + i, 8);
+      i += 8;
+      o += 8;
+    }
+    /* walk the flagged word (or the tail) a byte at a time */
+    size_t stop = i + 8 < len ? i + 8 : len;
+    while (i < stop)
+      i += escape_one(out, &o, in, i, len);
+  }
+  return o;
+}
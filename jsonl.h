@@ -0,0 +1,17 @@
+/*
+ * jsonl.h - JSON string escaping for the JSONL output
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef JSONL_H
+#define JSONL_H
+
+#include <stddef.h>
+
+/* Worst case output for len input bytes: every byte becomes "\uXXXX". */
+#define JSON_ESCAPE_MAX(len) ((len) * 6)
+
+size_t json_escape(char *out, const char *in, size_t len);
+
+#endif /* JSONL_H */
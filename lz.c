@@ -0,0 +1,169 @@
+/*
+ * lz.c - Small LZ77 block codec
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * A greedy single-pass compressor writing the LZ4 block format, so sash
+ * needs no compression library: a sequence is a token (literal length
+ * and match length, four bits each, extended with 255-runs), the
+ * literals, then a two-byte little-endian offset back into the output.
+ * Matches are found through a hash of the next four bytes; log text,
+ * full of repeated timestamps, levels and paths, typically shrinks three
+ * to six times at a few hundred MB/s.  As in LZ4, the last five bytes are
+ * always literals and no match starts in the last twelve.
+ *
+ * The decompressor checks every length and offset against both buffers,
+ * so a corrupt block is rejected rather than read or written out of
+ * bounds.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "lz.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_MF_LIMIT 12   /* no match starts this close to the end */
+#define LZ_LAST_LITERALS 5
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 14
+
+static uint32_t read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static uint32_t hash4(uint32_t v) {
+  return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* The 255-run that extends a length past its four token bits. */
+static uint8_t *put_length(uint8_t *op, size_t len) {
+  while (len >= 255) {
+    *op++ = 255;
+    len -= 255;
+  }
+  *op++ = (uint8_t)len;
+  return op;
+}
+
+static uint8_t *put_sequence(uint8_t *op, const uint8_t *lit, size_t nlit,
+                             size_t offset, size_t mlen) {
+  uint8_t *token = op++;
+  *token = (uint8_t)((nlit < 15 ? nlit : 15) << 4);
+  if (nlit >= 15)
+    op = put_length(op, nlit - 15);
+  memcpy(op, lit, nlit);
+  op += nlit;
+  if (offset == 0)
+    return op; /* the last sequence: literals only */
+  *op++ = (uint8_t)offset;
+  *op++ = (uint8_t)(offset >> 8);
+  mlen -= LZ_MIN_MATCH;
+  *token |= (uint8_t)(mlen < 15 ? mlen : 15);
+  if (mlen >= 15)
+    op = put_length(op, mlen - 15);
+  return op;
+}
+
+/* Compress n bytes into dst, which must hold LZ_BOUND(n); returns the
+   compressed size. */
+size_t lz_compress(const char *src_, size_t n, char *dst_) {
+  const uint8_t *src = (const uint8_t *)src_;
+  const uint8_t *end = src + n;
+  const uint8_t *ip = src, *anchor = src;
+  uint8_t *op = (uint8_t *)dst_;
+  uint32_t table[1 << LZ_HASH_BITS];
+  memset(table, 0, sizeof(table));
+
+  if (n > LZ_MF_LIMIT) {
+    const uint8_t *mf_limit = end - LZ_MF_LIMIT;
+    const uint8_t *match_limit = end - LZ_LAST_LITERALS;
+    unsigned misses = 0;
+    while (ip < mf_limit) {
+      uint32_t seq = read32(ip);
+      uint32_t h = hash4(seq);
+      const uint8_t *ref = src + table[h];
+      table[h] = (uint32_t)(ip - src);
+      if (ref < ip && ip - ref <= LZ_MAX_OFFSET && read32(ref) == seq) {
+        const uint8_t *m = ip + LZ_MIN_MATCH, *r = ref + LZ_MIN_MATCH;
+        while (m < match_limit && *m == *r) {
+          m++;
+          r++;
+        }
+        op = put_sequence(op, anchor, (size_t)(ip - anchor),
+                          (size_t)(ip - ref), (size_t)(m - ip));
+        ip = anchor = m;
+        misses = 0;
+      } else {
+        /* skip faster through data that doesn't compress */
+        ip += 1 + (misses++ >> 6);
+      }
+    }
+  }
+  op = put_sequence(op, anchor, (size_t)(end - anchor), 0, 0);
+  return (size_t)(op - (uint8_t *)dst_);
+}
+
+/* Read a 255-run length extension; false if it runs off the input. */
+static bool get_length(const uint8_t **ip, const uint8_t *iend, size_t *len) {
+  uint8_t b;
+  do {
+    if (*ip >= iend)
+      return false;
+    b = *(*ip)++;
+    *len += b;
+  } while (b == 255);
+  return true;
+}
+
+/*
+ * Decompress a block that must expand to exactly out_len bytes.  Returns
+ * false if it is corrupt.
+ */
+bool lz_decompress(const char *src_, size_t n, char *dst_, size_t out_len) {
+  const uint8_t *ip = (const uint8_t *)src_, *iend = ip + n;
+  uint8_t *dst = (uint8_t *)dst_, *op = dst, *oend = dst + out_len;
+
+  while (ip < iend) {
+    uint8_t token = *ip++;
+    size_t nlit = token >> 4;
+    if (nlit == 15 && !get_length(&ip, iend, &nlit))
+      return false;
+    if (nlit > (size_t)(iend - ip) || nlit > (size_t)(oend - op))
+      return false;
+    memcpy(op, ip, nlit);
+    ip += nlit;
+    op += nlit;
+    if (ip == iend)
+      break; /* the last sequence */
+
+    if (iend - ip < 2)
+      return false;
+    size_t offset = (size_t)ip[0] | (size_t)ip[1] << 8;
+    ip += 2;
+    size_t mlen = token & 15;
+    if (mlen == 15 && !get_length(&ip, iend, &mlen))
+      return false;
+    mlen += LZ_MIN_MATCH;
+    if (offset == 0 || offset > (size_t)(op - dst) ||
+        mlen > (size_t)(oend - op))
+      return false;
+    const uint8_t *ref = op - offset;
+    if (offset >= mlen) {
+      memcpy(op, ref, mlen);
+      op += mlen;
+    } else {
+      while (mlen--) /* overlapping: a repeated pattern */
+        *op++ = *ref++;
+    }
+  }
+  return op == oend;
+}
@@ -0,0 +1,19 @@
+/*
+ * lz.h - Small LZ77 block codec
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef LZ_H
+#define LZ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Worst-case compressed size of n bytes. */
+#define LZ_BOUND(n) ((n) + (n) / 255 + 16)
+
+size_t lz_compress(const char *src, size_t n, char *dst);
+bool lz_decompress(const char *src, size_t n, char *dst, size_t out_len);
+
+#endif /* LZ_H */
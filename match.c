@@ -0,0 +1,243 @@
+/*
+ * match.c - Line matching with a literal prefilter
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Patterns are POSIX extended regular expressions.  Most lines never match,
+ * so before running the regex we look for a literal the pattern can't
+ * match without: the longest run of plain characters in each top-level
+ * alternative ("FATAL|No space left" needs "FATAL" or "No space left").
+ * memmem() rejects a non-matching line far faster than regexec().  When
+ * any alternative has no such literal the prefilter is skipped.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "match.h"
+
+/* Index just past the bracket expression starting at p[i] == '['.  A
+   class, equivalence class or collating symbol inside it ("[:digit:]",
+   "[=a=]", "[.x.]") has a ']' of its own that doesn't end the bracket. */
+static size_t skip_bracket(const char *p, size_t i, size_t end) {
+  i++;
+  if (i < end && p[i] == '^')
+    i++;
+  if (i < end && p[i] == ']')
+    i++; /* a leading ']' is literal */
+  while (i < end && p[i] != ']') {
+    if (p[i] == '[' && i + 1 < end && strchr(":=.", p[i + 1])) {
+      char kind = p[i + 1];
+      size_t j = i + 2;
+      while (j + 1 < end && !(p[j] == kind && p[j + 1] == ']'))
+        j++;
+      if (j + 1 >= end)
+        return end;
+      i = j + 2;
+      continue;
+    }
+    i++;
+  }
+  return i < end ? i + 1 : end;
+}
+
+/* Index just past the group starting at p[i] == '('. */
+static size_t skip_group(const char *p, size_t i, size_t end) {
+  int depth = 0;
+  while (i < end) {
+    if (p[i] == '\\') {
+      i += 2;
+      continue;
+    }
+    if (p[i] == '[') {
+      i = skip_bracket(p, i, end);
+      continue;
+    }
+    if (p[i] == '(')
+      depth++;
+    else if (p[i] == ')' && --depth == 0)
+      return i + 1;
+    i++;
+  }
+  return end;
+}
+
+static size_t skip_quantifier(const char *p, size_t i, size_t end) {
+  if (i < end && p[i] == '{') {
+    while (i < end && p[i] != '}')
+      i++;
+    return i < end ? i + 1 : end;
+  }
+  return i + 1;
+}
+
+/*
+ * Longest run of characters that every match of p[start, end) must
+ * contain.  Groups and bracket expressions end a run; so does a character
+ * made optional by '?', '*' or '{'.  Writes the run to out (unescaped) and
+ * returns its length.
+ */
+static size_t required_literal(const char *p, size_t start, size_t end,
+                               char *out) {
+  char *run = malloc(end - start + 1);
+  if (!run) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  size_t run_len = 0, best = 0;
+
+  size_t i = start;
+  while (i < end) {
+    char c = p[i];
+    bool literal = false;
+    size_t next = i + 1;
+
+    if (c == '\\' && i + 1 < end) {
+      /* \w, \b, \1 etc. are classes or assertions, not characters */
+      if (!isalnum((unsigned char)p[i + 1])) {
+        c = p[i + 1];
+        literal = true;
+      }
+      next = i + 2;
+    } else if (c == '[') {
+      next = skip_bracket(p, i, end);
+    } else if (c == '(') {
+      next = skip_group(p, i, end);
+    } else if (strchr("*+?{", c)) {
+      next = skip_quantifier(p, i, end);
+    } else if (!strchr(".^$)", c)) {
+      literal = true;
+    }
+
+    bool optional = next < end && strchr("*?{", p[next]);
+    if (literal && !optional) {
+      run[run_len++] = c;
+      if (run_len > best) {
+        best = run_len;
+        memcpy(out, run, best);
+      }
+      if (next < end && p[next] == '+') {
+        run_len = 0; /* repeats: the run can't extend past it */
+        next++;
+      }
+    } else {
+      run_len = 0;
+    }
+    i = next;
+  }
+
+  free(run);
+  return best;
+}
+
+/* Collect one required literal per top-level alternative, if possible. */
+static void build_prefilter(Matcher *m, const char *p) {
+  size_t n = strlen(p);
+  size_t start = 0;
+  for (size_t i = 0; i <= n;) {
+    if (i < n && p[i] == '\\') {
+      i += 2;
+      continue;
+    }
+    if (i < n && p[i] == '[') {
+      i = skip_bracket(p, i, n);
+      continue;
+    }
+    if (i < n && p[i] == '(') {
+      i = skip_group(p, i, n);
+      continue;
+    }
+    if (i == n || p[i] == '|') {
+      size_t end = i < n ? i : n;
+      char *lit = malloc(end - start + 1);
+      if (!lit) {
+        perror("sash: malloc");
+        exit(1);
+      }
+      size_t len = required_literal(p, start, end, lit);
+      if (len == 0 || m->nliterals == MATCH_MAX_LITERALS) {
+        free(lit);
+        goto none;
+      }
+      m->literals[m->nliterals] = lit;
+      m->literal_lens[m->nliterals] = len;
+      m->nliterals++;
+      start = i + 1;
+    }
+    i++;
+  }
+  return;
+
+none:
+  for (int k = 0; k < m->nliterals; k++)
+    free(m->literals[k]);
+  m->nliterals = 0;
+}
+
+/* Compile an extended regex.  Prints the error and returns false if it's
+   invalid. */
+bool matcher_init(Matcher *m, const char *pattern) {
+  memset(m, 0, sizeof(*m));
+  int err = regcomp(&m->re, pattern, REG_EXTENDED | REG_NOSUB);
+  if (err) {
+    char msg[256];
+    regerror(err, &m->re, msg, sizeof(msg));
+    fprintf(stderr, "sash: invalid pattern '%s': %s\n", pattern, msg);
+    return false;
+  }
+  m->compiled = true;
+  build_prefilter(m, pattern);
+  return true;
+}
+
+/* Whether the line (trailing newline excluded) matches. */
+bool matcher_match(Matcher *m, const char *line, size_t len) {
+  if (len > 0 && line[len - 1] == '\n')
+    len--;
+
+  if (m->nliterals > 0) {
+    int k;
+    for (k = 0; k < m->nliterals; k++) {
+      if (memmem(line, len, m->literals[k], m->literal_lens[k]))
+        break;
+    }
+    if (k == m->nliterals)
+      return false;
+  }
+
+#ifdef REG_STARTEND
+  regmatch_t pm[1];
+  pm[0].rm_so = 0;
+  pm[0].rm_eo = (regoff_t)len;
+  return regexec(&m->re, line, 1, pm, REG_STARTEND) == 0;
+#else
+  if (len + 1 > m->scratch_cap) {
+    m->scratch_cap = len + 1;
+    m->scratch = realloc(m->scratch, m->scratch_cap);
+    if (!m->scratch) {
+      perror("sash: realloc");
+      exit(1);
+    }
+  }
+  memcpy(m->scratch, line, len);
+  m->scratch[len] = '\0';
+  return regexec(&m->re, m->scratch, 0, NULL, 0) == 0;
+#endif
+}
+
+void matcher_free(Matcher *m) {
+  if (m->compiled)
+    regfree(&m->re);
+  for (int k = 0; k < m->nliterals; k++)
+    free(m->literals[k]);
+  free(m->scratch);
+  memset(m, 0, sizeof(*m));
+}
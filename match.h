@@ -0,0 +1,31 @@
+/*
+ * match.h - Line matching with a literal prefilter
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef MATCH_H
+#define MATCH_H
+
+#include <regex.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MATCH_MAX_LITERALS 8
+
+typedef struct {
+  regex_t re;
+  bool compiled;
+  /* one required literal per top-level alternative; 0 = no prefilter */
+  int nliterals;
+  char *literals[MATCH_MAX_LITERALS];
+  size_t literal_lens[MATCH_MAX_LITERALS];
+  char *scratch; /* NUL-terminated copy when REG_STARTEND is missing */
+  size_t scratch_cap;
+} Matcher;
+
+bool matcher_init(Matcher *m, const char *pattern);
+bool matcher_match(Matcher *m, const char *line, size_t len);
+void matcher_free(Matcher *m);
+
+#endif /* MATCH_H */
@@ -0,0 +1,126 @@
+/*
+ * minimap.c - Error-density strip of the whole run
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * --minimap draws one row under the window covering every line so far,
+ * left to right, each cell shaded by how many of its lines were errors
+ * or warnings.  Lines are counted into up to MINIMAP_BUCKETS buckets of
+ * `span` lines each.  When the last bucket is full and there's no room
+ * for another, neighbouring pairs are merged and the span doubles, so
+ * the buckets always cover the whole run and adding a line is O(1)
+ * amortised.  A frame folds the buckets into the terminal's columns.
+ *
+ * Clean cells are the lowest bar.  Flagged density is on a log scale,
+ * from one line in a thousand (the next bar up) to every line (a full
+ * block): errors are usually rare, and a linear scale would leave all but
+ * the worst cells looking clean.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include "minimap.h"
+
+void minimap_init(Minimap *m) {
+  memset(m, 0, sizeof(*m));
+  m->span = 1;
+}
+
+/* Merge neighbouring pairs: half as many buckets, each twice as long. */
+static void rebucket(Minimap *m) {
+  size_t n = 0;
+  for (size_t i = 0; i < m->nbuckets; i += 2) {
+    MinimapBucket b = m->buckets[i];
+    if (i + 1 < m->nbuckets) {
+      b.lines += m->buckets[i + 1].lines;
+      b.warnings += m->buckets[i + 1].warnings;
+      b.errors += m->buckets[i + 1].errors;
+    }
+    m->buckets[n++] = b;
+  }
+  memset(&m->buckets[n], 0, (m->nbuckets - n) * sizeof(MinimapBucket));
+  m->nbuckets = n;
+  m->span *= 2;
+}
+
+/* Count a line: MINIMAP_CLEAN, MINIMAP_WARN or MINIMAP_ERROR. */
+void minimap_add(Minimap *m, int kind) {
+  if (m->nbuckets == 0 || m->buckets[m->nbuckets - 1].lines == m->span) {
+    if (m->nbuckets == MINIMAP_BUCKETS)
+      rebucket(m);
+    /* after merging, the last bucket may have room again */
+    if (m->nbuckets == 0 || m->buckets[m->nbuckets - 1].lines == m->span)
+      m->nbuckets++;
+  }
+  MinimapBucket *b = &m->buckets[m->nbuckets - 1];
+  b->lines++;
+  if (kind == MINIMAP_ERROR)
+    b->errors++;
+  else if (kind == MINIMAP_WARN)
+    b->warnings++;
+}
+
+/* 0 for no flagged lines, else 1-7 on a log scale of the fraction. */
+static int density_level(uint64_t flagged, uint64_t lines) {
+  if (flagged == 0 || lines == 0)
+    return 0;
+  double f = (double)flagged / (double)lines;
+  int level = 1 + (int)(6.0 * (log10(f) + 3.0) / 3.0);
+  return level < 1 ? 1 : level > 7 ? 7 : level;
+}
+
+/*
+ * Write cols cells (UTF-8 block characters, coloured red for errors and
+ * yellow for warnings when color is set) to out, which must hold
+ * MINIMAP_ROW_MAX(cols).  Returns the bytes written; 0 before any lines.
+ */
+size_t minimap_render(const Minimap *m, int cols, bool color, char *out) {
+  static const char *const bars[] = {"\xe2\x96\x81", "\xe2\x96\x82",
+                                     "\xe2\x96\x83", "\xe2\x96\x84",
+                                     "\xe2\x96\x85", "\xe2\x96\x86",
+                                     "\xe2\x96\x87", "\xe2\x96\x88"};
+  static const char *const colors[] = {"\033[90m", "\033[33m", "\033[31m"};
+  size_t n = 0;
+  if (m->nbuckets == 0 || cols < 1)
+    return 0;
+
+  int current = -1;
+  for (int c = 0; c < cols; c++) {
+    /* the buckets this cell covers; a short run stretches across cells */
+    size_t lo = (size_t)c * m->nbuckets / (size_t)cols;
+    size_t hi = (size_t)(c + 1) * m->nbuckets / (size_t)cols;
+    if (hi <= lo)
+      hi = lo + 1;
+    MinimapBucket sum = {0, 0, 0};
+    for (size_t i = lo; i < hi; i++) {
+      sum.lines += m->buckets[i].lines;
+      sum.warnings += m->buckets[i].warnings;
+      sum.errors += m->buckets[i].errors;
+    }
+
+    int kind = sum.errors     ? MINIMAP_ERROR
+               : sum.warnings ? MINIMAP_WARN
+                              : MINIMAP_CLEAN;
+    int level = density_level(sum.errors + sum.warnings, sum.lines);
+    if (color && kind != current) {
+      memcpy(out + n, colors[kind], 5);
+      n += 5;
+      current = kind;
+    }
+    /* clean cells get the lowest bar, so the strip's extent shows */
+    memcpy(out + n, bars[level], 3);
+    n += 3;
+  }
+  if (color) {
+    memcpy(out + n, "\033[0m", 4);
+    n += 4;
+  }
+  return n;
+}
@@ -0,0 +1,37 @@
+/*
+ * minimap.h - Error-density strip of the whole run
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MINIMAP_BUCKETS 1024 /* halved to 512 when full */
+
+enum { MINIMAP_CLEAN, MINIMAP_WARN, MINIMAP_ERROR };
+
+typedef struct {
+  uint64_t lines;
+  uint64_t warnings;
+  uint64_t errors;
+} MinimapBucket;
+
+typedef struct {
+  MinimapBucket buckets[MINIMAP_BUCKETS];
+  size_t nbuckets;
+  uint64_t span; /* lines per bucket */
+} Minimap;
+
+/* Bytes minimap_render() may write for cols cells. */
+#define MINIMAP_ROW_MAX(cols) ((size_t)(cols) * 8 + 8)
+
+void minimap_init(Minimap *m);
+void minimap_add(Minimap *m, int kind);
+size_t minimap_render(const Minimap *m, int cols, bool color, char *out);
+
+#endif /* MINIMAP_H */
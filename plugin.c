@@ -0,0 +1,149 @@
+/*
+ * plugin.c - Loading and running line plugins
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * A pipeline is the stages loaded for one place in the stream (every line,
+ * or one output file), run in the order given.  Each stage sees the whole
+ * batch; dropping, rewriting and annotating are all done through the
+ * slices, so a stage that changes nothing costs one pass over them.
+ *
+ * Rewritten text lives in the pipeline's arena: chunks that are only
+ * appended to while a batch is processed (pointers into them stay valid)
+ * and emptied, keeping the first, once the batch has been written.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "plugin.h"
+
+#define ARENA_CHUNK (64 * 1024)
+
+struct ArenaChunk {
+  ArenaChunk *next;
+  size_t used;
+  size_t cap;
+  max_align_t data[];
+};
+
+static void *arena_alloc(sash_arena *pub, size_t n) {
+  Arena *a = (Arena *)pub;
+  size_t align = sizeof(max_align_t);
+  n = (n + align - 1) / align * align;
+  ArenaChunk *c = a->chunks;
+  if (!c || c->cap - c->used < n) {
+    size_t cap = n > ARENA_CHUNK ? n : ARENA_CHUNK;
+    ArenaChunk *fresh = malloc(sizeof(ArenaChunk) + cap);
+    if (!fresh)
+      return NULL;
+    fresh->next = c;
+    fresh->used = 0;
+    fresh->cap = cap;
+    a->chunks = c = fresh;
+  }
+  void *p = (char *)c->data + c->used;
+  c->used += n;
+  return p;
+}
+
+/* Add a stage; false (after init() has said why) if it won't start. */
+bool pipeline_add(Pipeline *p, const sash_plugin *plugin, const char *args,
+                  void *handle) {
+  void *state = plugin->init ? plugin->init(args ? args : "") : NULL;
+  if (plugin->init && !state) {
+    fprintf(stderr, "sash: plugin '%s' failed to start\n", plugin->name);
+    return false;
+  }
+  Stage *stages = realloc(p->stages, (size_t)(p->nstages + 1) * sizeof(Stage));
+  if (!stages) {
+    perror("sash: realloc");
+    exit(1);
+  }
+  p->stages = stages;
+  p->stages[p->nstages++] = (Stage){plugin, state, handle};
+  p->arena.pub.alloc = arena_alloc;
+  return true;
+}
+
+/*
+ * Load "PATH[:ARGS]" as a stage.  PATH is passed to dlopen(), so a bare
+ * name is searched for like a library; use ./name.so for the current
+ * directory.
+ */
+bool pipeline_load(Pipeline *p, const char *spec) {
+  const char *colon = strchr(spec, ':');
+  size_t n = colon ? (size_t)(colon - spec) : strlen(spec);
+  char *path = strndup(spec, n);
+  if (!path) {
+    perror("sash: strndup");
+    exit(1);
+  }
+
+  void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (!handle) {
+    fprintf(stderr, "sash: cannot load plugin: %s\n", dlerror());
+    free(path);
+    return false;
+  }
+  const sash_plugin *plugin = dlsym(handle, "sash_plugin_entry");
+  if (!plugin || plugin->abi_version != SASH_PLUGIN_ABI_VERSION ||
+      !plugin->process) {
+    if (!plugin)
+      fprintf(stderr, "sash: %s: no sash_plugin_entry symbol\n", path);
+    else
+      fprintf(stderr, "sash: %s: plugin ABI version %u, expected %u\n", path,
+              plugin->abi_version, SASH_PLUGIN_ABI_VERSION);
+    dlclose(handle);
+    free(path);
+    return false;
+  }
+  free(path);
+
+  if (!pipeline_add(p, plugin, colon ? colon + 1 : "", handle)) {
+    dlclose(handle);
+    return false;
+  }
+  return true;
+}
+
+void pipeline_run(Pipeline *p, sash_line *lines, size_t n) {
+  for (int i = 0; i < p->nstages; i++)
+    p->stages[i].plugin->process(p->stages[i].state, lines, n, &p->arena.pub);
+}
+
+/* The batch has been written: free what the plugins allocated. */
+void pipeline_reset(Pipeline *p) {
+  ArenaChunk *c = p->arena.chunks;
+  if (!c)
+    return;
+  while (c->next) {
+    ArenaChunk *next = c->next;
+    free(c);
+    c = next;
+  }
+  c->used = 0;
+  p->arena.chunks = c;
+}
+
+void pipeline_free(Pipeline *p) {
+  for (int i = 0; i < p->nstages; i++) {
+    Stage *s = &p->stages[i];
+    if (s->plugin->fini)
+      s->plugin->fini(s->state);
+    if (s->handle)
+      dlclose(s->handle);
+  }
+  free(p->stages);
+  pipeline_reset(p);
+  free(p->arena.chunks);
+  memset(p, 0, sizeof(*p));
+}
@@ -0,0 +1,41 @@
+/*
+ * plugin.h - Loading and running line plugins
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sash_plugin.h"
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct {
+  sash_arena pub; /* first: plugins see a sash_arena * */
+  ArenaChunk *chunks;
+} Arena;
+
+typedef struct {
+  const sash_plugin *plugin;
+  void *state;
+  void *handle; /* from dlopen(), NULL for a built-in */
+} Stage;
+
+typedef struct {
+  Stage *stages;
+  int nstages;
+  Arena arena;
+} Pipeline;
+
+bool pipeline_load(Pipeline *p, const char *spec);
+bool pipeline_add(Pipeline *p, const sash_plugin *plugin, const char *args,
+                  void *handle);
+void pipeline_run(Pipeline *p, sash_line *lines, size_t n);
+void pipeline_reset(Pipeline *p);
+void pipeline_free(Pipeline *p);
+
+#endif /* PLUGIN_H */
@@ -0,0 +1,135 @@
+/*
+ * redact.c - Example sash plugin: mask secret values
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ *   sash --plugin ./redact.so:password=,token= -w app.log ./app
+ *
+ * ARGS is a comma-separated list of keys.  Wherever a key appears in a
+ * line, the value after it (up to whitespace, '&', ',', ';' or a quote)
+ * is replaced by "***".  Lines without a key pass untouched and cost a
+ * memmem() per key.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../sash_plugin.h"
+
+#define MASK "***"
+
+typedef struct {
+  char **keys;
+  size_t *key_lens;
+  int nkeys;
+} Redact;
+
+static void *redact_init(const char *args) {
+  Redact *r = calloc(1, sizeof(*r));
+  char *copy = strdup(args);
+  if (!r || !copy) {
+    free(r);
+    free(copy);
+    return NULL;
+  }
+  for (char *save = NULL, *k = strtok_r(copy, ",", &save); k;
+       k = strtok_r(NULL, ",", &save)) {
+    char **keys = realloc(r->keys, (size_t)(r->nkeys + 1) * sizeof(char *));
+    size_t *lens =
+        realloc(r->key_lens, (size_t)(r->nkeys + 1) * sizeof(size_t));
+    if (keys)
+      r->keys = keys;
+    if (lens)
+      r->key_lens = lens;
+    if (!keys || !lens || !(r->keys[r->nkeys] = strdup(k)))
+      break;
+    r->key_lens[r->nkeys++] = strlen(k);
+  }
+  free(copy);
+  if (r->nkeys == 0) {
+    fprintf(stderr, "redact: usage: redact.so:KEY[,KEY...]\n");
+    free(r->keys);
+    free(r->key_lens);
+    free(r);
+    return NULL;
+  }
+  return r;
+}
+
+static int ends_value(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '&' ||
+         c == ',' || c == ';' || c == '"' || c == '\'';
+}
+
+/* Copy line to out with every keyed value masked; returns the new length,
+   at most len * (1 + strlen(MASK)). */
+static size_t mask(const Redact *r, const char *line, size_t len, char *out) {
+  size_t o = 0, i = 0;
+  while (i < len) {
+    int k;
+    for (k = 0; k < r->nkeys; k++)
+      if (len - i >= r->key_lens[k] &&
+          memcmp(line + i, r->keys[k], r->key_lens[k]) == 0)
+        break;
+    if (k == r->nkeys) {
+      out[o++] = line[i++];
+      continue;
+    }
+    memcpy(out + o, r->keys[k], r->key_lens[k]);
+    o += r->key_lens[k];
+    i += r->key_lens[k];
+    size_t start = i;
+    while (i < len && !ends_value(line[i]))
+      i++;
+    if (i > start) {
+      memcpy(out + o, MASK, sizeof(MASK) - 1);
+      o += sizeof(MASK) - 1;
+    }
+  }
+  return o;
+}
+
+static void redact_process(void *state, sash_line *lines, size_t n,
+                           sash_arena *arena) {
+  const Redact *r = state;
+  for (size_t j = 0; j < n; j++) {
+    sash_line *l = &lines[j];
+    if (l->flags & SASH_LINE_DROP)
+      continue;
+    int k;
+    for (k = 0; k < r->nkeys; k++)
+      if (memmem(l->ptr, l->len, r->keys[k], r->key_lens[k]))
+        break;
+    if (k == r->nkeys)
+      continue;
+    char *out = arena->alloc(arena, l->len * (sizeof(MASK)) + 1);
+    if (!out)
+      continue;
+    l->len = mask(r, l->ptr, l->len, out);
+    l->ptr = out;
+  }
+}
+
+static void redact_fini(void *state) {
+  Redact *r = state;
+  for (int k = 0; k < r->nkeys; k++)
+    free(r->keys[k]);
+  free(r->keys);
+  free(r->key_lens);
+  free(r);
+}
+
+const sash_plugin sash_plugin_entry = {
+    .abi_version = SASH_PLUGIN_ABI_VERSION,
+    .name = "redact",
+    .init = redact_init,
+    .process = redact_process,
+    .fini = redact_fini,
+};
@@ -42,9 +42,18 @@ static char *join_args(char **argv) {
   return buf;
 }
 
-pid_t spawn_command(char **cmd_argv, bool use_exec, int *read_fd) {
+/*
+ * Spawn the command with stdout and stderr on a pipe; returns its pid and
+ * the read end in *read_fd.  With own_pgrp the command leads a new process
+ * group, so it and everything it starts can be signalled together.  With a
+ * progress_fd, the command also gets the write end of a second pipe as that
+ * fd (named in $SASH_PROGRESS_FD), and the read end goes in *progress_fd.
+ */
+pid_t spawn_command(char **cmd_argv, const SpawnOptions *opts, int *read_fd,
+                    int *progress_fd) {
   int pipefd[2];
-  if (pipe(pipefd) == -1) {
+  int progfd[2] = {-1, -1};
+  if (pipe(pipefd) == -1 || (opts->progress_fd >= 0 && pipe(progfd) == -1)) {
     perror("sash: pipe");
     exit(1);
   }
@@ -57,11 +66,25 @@ pid_t spawn_command(char **cmd_argv, bool use_exec, int *read_fd) {
 
   if (pid == 0) {
     /* child */
+    if (opts->own_pgrp)
+      setpgid(0, 0);
     close(pipefd[0]);
     dup2(pipefd[1], STDOUT_FILENO);
     dup2(pipefd[1], STDERR_FILENO);
-    close(pipefd[1]);
-    if (use_exec) {
+    if (pipefd[1] != opts->progress_fd)
+      close(pipefd[1]);
+    if (opts->progress_fd >= 0) {
+      close(progfd[0]);
+      /* dup2 replaces whatever held the fd, even the output pipe above */
+      if (progfd[1] != opts->progress_fd) {
+        dup2(progfd[1], opts->progress_fd);
+        close(progfd[1]);
+      }
+      char num[16];
+      snprintf(num, sizeof(num), "%d", opts->progress_fd);
+      setenv("SASH_PROGRESS_FD", num, 1);
+    }
+    if (opts->use_exec) {
       execvp(cmd_argv[0], cmd_argv);
     } else {
       char *cmd = join_args(cmd_argv);
@@ -76,10 +99,18 @@ pid_t spawn_command(char **cmd_argv, bool use_exec, int *read_fd) {
     _exit(127);
   }
 
-  /* parent */
+  /* parent (also sets the group, so it's in place before we signal it) */
+  if (opts->own_pgrp)
+    setpgid(pid, pid);
   close(pipefd[1]);
   /* Set close-on-exec so the read fd doesn't leak into grandchildren */
   fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
   *read_fd = pipefd[0];
+  if (opts->progress_fd >= 0) {
+    close(progfd[1]);
+    fcntl(progfd[0], F_SETFD, FD_CLOEXEC);
+  }
+  if (progress_fd)
+    *progress_fd = progfd[0];
   return pid;
 }
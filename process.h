@@ -10,6 +10,13 @@
 #include <stdbool.h>
 #include <sys/types.h>
 
-pid_t spawn_command(char **cmd_argv, bool use_exec, int *read_fd);
+typedef struct {
+  bool use_exec;   /* execvp() the argv instead of sh -c */
+  bool own_pgrp;   /* the command leads a new process group */
+  int progress_fd; /* the command's fd for a progress pipe, -1 = none */
+} SpawnOptions;
+
+pid_t spawn_command(char **cmd_argv, const SpawnOptions *opts, int *read_fd,
+                    int *progress_fd);
 
 #endif /* PROCESS_H */
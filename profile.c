@@ -0,0 +1,419 @@
+/*
+ * profile.c - Built-in sampling profiler
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * --profile samples sash's own stacks about a thousand times per second
+ * of CPU time (ITIMER_PROF) so users can send us a profile without perf.
+ * The SIGPROF handler only walks the frame-pointer chain (sash is built
+ * with -fno-omit-frame-pointer) and copies return addresses into a buffer
+ * allocated up front; it never allocates or locks.  At exit the addresses
+ * are resolved against the executable's ELF symbol table (static
+ * functions included) or, for shared libraries, dladdr(), and written as
+ * collapsed stacks ("main;run_input;on_line 42") for flamegraph tools.
+ *
+ * Only the main thread's stack is unwound.  Samples landing on reader or
+ * indexer threads record just the function they were in.  libc is built
+ * without frame pointers, so a sample taken inside it finds its way back
+ * to sash's frames by scanning the stack for a return address instead.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+
+#include <dlfcn.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#define PROFILE_HZ 997 /* not a round number, so it doesn't beat with timers */
+#define PROFILE_DEPTH 48
+#define PROFILE_MAX_SAMPLES 60000 /* a minute of CPU time */
+#define PROFILE_SCAN_WORDS 512     /* stack searched below a library frame */
+
+static uintptr_t *g_frames; /* PROFILE_MAX_SAMPLES x PROFILE_DEPTH */
+static uint8_t *g_depths;
+static atomic_uint g_nsamples;
+static atomic_uint g_dropped;
+static uintptr_t g_stack_lo, g_stack_hi; /* the main thread's stack */
+static uintptr_t g_text_lo, g_text_hi;   /* the executable's code */
+static uintptr_t g_exe_base;             /* its load bias */
+
+static bool in_text(uintptr_t addr) {
+  return addr >= g_text_lo && addr < g_text_hi;
+}
+
+/* ── Sampling ────────────────────────────────────────────────────── */
+
+static void on_sigprof(int sig, siginfo_t *si, void *uc_) {
+  (void)sig;
+  (void)si;
+  ucontext_t *uc = uc_;
+#if defined(__x86_64__)
+  uintptr_t pc = (uintptr_t)uc->uc_mcontext.gregs[REG_RIP];
+  uintptr_t fp = (uintptr_t)uc->uc_mcontext.gregs[REG_RBP];
+  uintptr_t sp = (uintptr_t)uc->uc_mcontext.gregs[REG_RSP];
+#else
+  uintptr_t pc = (uintptr_t)uc->uc_mcontext.pc;
+  uintptr_t fp = (uintptr_t)uc->uc_mcontext.regs[29];
+  uintptr_t sp = (uintptr_t)uc->uc_mcontext.sp;
+#endif
+
+  unsigned i = atomic_fetch_add_explicit(&g_nsamples, 1, memory_order_relaxed);
+  if (i >= PROFILE_MAX_SAMPLES) {
+    atomic_fetch_sub_explicit(&g_nsamples, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+    return;
+  }
+  uintptr_t *out = &g_frames[(size_t)i * PROFILE_DEPTH];
+  unsigned n = 0;
+  out[n++] = pc;
+
+  bool on_main = sp >= g_stack_lo && sp < g_stack_hi;
+
+  /* Library code may use the frame pointer as a plain register.  Find
+     the way back into sash instead: the first word on the stack that
+     points into our code is the return address into the caller, and the
+     next {fp, return address} pair above it is a frame record. */
+  if (on_main && !in_text(pc)) {
+    const uintptr_t *w = (const uintptr_t *)sp;
+    const uintptr_t *lim = w + PROFILE_SCAN_WORDS;
+    if ((uintptr_t)lim > g_stack_hi - sizeof(uintptr_t))
+      lim = (const uintptr_t *)(g_stack_hi - sizeof(uintptr_t));
+    while (w < lim && !in_text(*w))
+      w++;
+    if (w < lim) {
+      out[n++] = *w - 1;
+      for (w++; w < lim; w++) {
+        if (w[0] > (uintptr_t)w && w[0] < g_stack_hi && in_text(w[1])) {
+          sp = fp = (uintptr_t)w;
+          break;
+        }
+      }
+    }
+  }
+
+  /* each frame record is {caller's fp, return address}; only follow it
+     while it stays inside the live part of the main stack */
+  while (on_main && n < PROFILE_DEPTH) {
+    if (fp < sp || fp >= g_stack_hi - 2 * sizeof(uintptr_t) ||
+        (fp & (sizeof(uintptr_t) - 1)))
+      break;
+    const uintptr_t *rec = (const uintptr_t *)fp;
+    uintptr_t next = rec[0], ret = rec[1];
+    if (ret == 0)
+      break;
+    out[n++] = ret - 1; /* inside the call instruction */
+    if (next <= fp)
+      break;
+    sp = fp;
+    fp = next;
+  }
+  g_depths[i] = (uint8_t)n;
+}
+
+static int find_exe(struct dl_phdr_info *info, size_t size, void *arg) {
+  (void)size;
+  (void)arg;
+  /* the first object is the executable */
+  g_exe_base = info->dlpi_addr;
+  for (int i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+    if (ph->p_type == PT_LOAD && (ph->p_flags & PF_X)) {
+      g_text_lo = info->dlpi_addr + ph->p_vaddr;
+      g_text_hi = g_text_lo + ph->p_memsz;
+    }
+  }
+  return 1;
+}
+
+/* Arm the sampler.  Returns false (with a message) if it can't run. */
+bool profile_start(void) {
+  g_frames = calloc((size_t)PROFILE_MAX_SAMPLES * PROFILE_DEPTH,
+                    sizeof(uintptr_t));
+  g_depths = calloc(PROFILE_MAX_SAMPLES, 1);
+  if (!g_frames || !g_depths) {
+    perror("sash: calloc");
+    exit(1);
+  }
+
+  pthread_attr_t attr;
+  void *addr;
+  size_t size;
+  if (pthread_getattr_np(pthread_self(), &attr) != 0 ||
+      pthread_attr_getstack(&attr, &addr, &size) != 0) {
+    fprintf(stderr, "sash: --profile: cannot find the stack\n");
+    return false;
+  }
+  pthread_attr_destroy(&attr);
+  g_stack_lo = (uintptr_t)addr;
+  g_stack_hi = (uintptr_t)addr + size;
+  dl_iterate_phdr(find_exe, NULL);
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_sigaction = on_sigprof;
+  sa.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(SIGPROF, &sa, NULL) == -1) {
+    perror("sash: sigaction");
+    return false;
+  }
+
+  struct itimerval it;
+  it.it_interval.tv_sec = 0;
+  it.it_interval.tv_usec = 1000000 / PROFILE_HZ;
+  it.it_value = it.it_interval;
+  if (setitimer(ITIMER_PROF, &it, NULL) == -1) {
+    perror("sash: setitimer");
+    return false;
+  }
+  return true;
+}
+
+/* ── Symbols ─────────────────────────────────────────────────────── */
+
+typedef struct {
+  uintptr_t start, end;
+  const char *name;
+} Symbol;
+
+static Symbol *g_syms = NULL;
+static size_t g_nsyms = 0;
+static char *g_strtab = NULL; /* copy of the executable's .strtab */
+
+
+static int cmp_symbol(const void *a, const void *b) {
+  uintptr_t x = ((const Symbol *)a)->start, y = ((const Symbol *)b)->start;
+  return x < y ? -1 : x > y;
+}
+
+/* Load the function symbols of /proc/self/exe, static ones included. */
+static void load_exe_symbols(void) {
+  int fd = open("/proc/self/exe", O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(ElfW(Ehdr))) {
+    close(fd);
+    return;
+  }
+  size_t size = (size_t)st.st_size;
+  const unsigned char *img = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (img == MAP_FAILED)
+    return;
+
+  const ElfW(Ehdr) *eh = (const ElfW(Ehdr) *)img;
+  if (memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 || eh->e_shoff == 0 ||
+      eh->e_shoff + (size_t)eh->e_shnum * sizeof(ElfW(Shdr)) > size)
+    goto out;
+  const ElfW(Shdr) *sh = (const ElfW(Shdr) *)(img + eh->e_shoff);
+  for (int i = 0; i < eh->e_shnum; i++) {
+    if (sh[i].sh_type != SHT_SYMTAB || sh[i].sh_link >= eh->e_shnum)
+      continue;
+    const ElfW(Shdr) *strs = &sh[sh[i].sh_link];
+    if (sh[i].sh_offset + sh[i].sh_size > size ||
+        strs->sh_offset + strs->sh_size > size || strs->sh_size == 0)
+      break;
+    g_strtab = malloc(strs->sh_size + 1);
+    size_t nsyms = sh[i].sh_size / sizeof(ElfW(Sym));
+    g_syms = malloc((nsyms + 1) * sizeof(Symbol));
+    if (!g_strtab || !g_syms) {
+      perror("sash: malloc");
+      exit(1);
+    }
+    memcpy(g_strtab, img + strs->sh_offset, strs->sh_size);
+    g_strtab[strs->sh_size] = '\0';
+    const ElfW(Sym) *sym = (const ElfW(Sym) *)(img + sh[i].sh_offset);
+    for (size_t k = 0; k < nsyms; k++) {
+      if (ELF64_ST_TYPE(sym[k].st_info) != STT_FUNC || sym[k].st_value == 0 ||
+          sym[k].st_name >= strs->sh_size)
+        continue;
+      uintptr_t start = g_exe_base + sym[k].st_value;
+      g_syms[g_nsyms++] = (Symbol){start, start + sym[k].st_size,
+                                   g_strtab + sym[k].st_name};
+    }
+    qsort(g_syms, g_nsyms, sizeof(Symbol), cmp_symbol);
+    break;
+  }
+out:
+  munmap((void *)img, size);
+}
+
+/* Name of the function containing addr, written to buf if need be. */
+static const char *symbolize(uintptr_t addr, char *buf, size_t cap) {
+  size_t lo = 0, hi = g_nsyms;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (g_syms[mid].start <= addr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo > 0) {
+    const Symbol *s = &g_syms[lo - 1];
+    if (addr < s->end)
+      return s->name;
+  }
+  Dl_info info;
+  if (dladdr((void *)addr, &info) && info.dli_fname) {
+    if (info.dli_sname)
+      return info.dli_sname;
+    const char *base = strrchr(info.dli_fname, '/');
+    snprintf(buf, cap, "[%s]", base ? base + 1 : info.dli_fname);
+    return buf;
+  }
+  return "[unknown]";
+}
+
+/* ── Output ──────────────────────────────────────────────────────── */
+
+typedef struct {
+  char *stack;
+  unsigned long count;
+} Stack;
+
+static int cmp_stack(const void *a, const void *b) {
+  return strcmp(((const Stack *)a)->stack, ((const Stack *)b)->stack);
+}
+
+static size_t hash_str(const char *s) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (; *s; s++) {
+    h ^= (unsigned char)*s;
+    h *= 0x100000001b3ULL;
+  }
+  return (size_t)h;
+}
+
+/*
+ * Stop sampling and write one "root;...;leaf COUNT" line per distinct
+ * stack to path, or append them after an upgrade (flamegraph tools add up
+ * a stack listed twice).  Returns false if the file can't be written.
+ */
+bool profile_write(const char *path, bool append) {
+  struct itimerval off;
+  memset(&off, 0, sizeof(off));
+  setitimer(ITIMER_PROF, &off, NULL);
+  signal(SIGPROF, SIG_IGN);
+
+  unsigned nsamples = atomic_load(&g_nsamples);
+  load_exe_symbols();
+
+  size_t cap = 64;
+  while (cap < (size_t)nsamples * 2)
+    cap *= 2;
+  Stack *table = calloc(cap, sizeof(Stack));
+  char *line = malloc(PROFILE_DEPTH * 256);
+  if (!table || !line) {
+    perror("sash: malloc");
+    exit(1);
+  }
+
+  for (unsigned i = 0; i < nsamples; i++) {
+    const uintptr_t *frames = &g_frames[(size_t)i * PROFILE_DEPTH];
+    size_t len = 0;
+    for (int k = g_depths[i] - 1; k >= 0; k--) {
+      char buf[256];
+      const char *name = symbolize(frames[k], buf, sizeof(buf));
+      size_t n = strnlen(name, 250);
+      if (len > 0)
+        line[len++] = ';';
+      memcpy(line + len, name, n);
+      len += n;
+    }
+    line[len] = '\0';
+    if (len == 0)
+      continue;
+
+    size_t h = hash_str(line) & (cap - 1);
+    while (table[h].stack && strcmp(table[h].stack, line) != 0)
+      h = (h + 1) & (cap - 1);
+    if (!table[h].stack) {
+      table[h].stack = strdup(line);
+      if (!table[h].stack) {
+        perror("sash: strdup");
+        exit(1);
+      }
+    }
+    table[h].count++;
+  }
+  free(line);
+
+  /* compact and sort so runs are reproducible */
+  size_t n = 0;
+  for (size_t i = 0; i < cap; i++) {
+    if (table[i].stack)
+      table[n++] = table[i];
+  }
+  qsort(table, n, sizeof(Stack), cmp_stack);
+
+  bool ok = true;
+  FILE *out = fopen(path, append ? "a" : "w");
+  if (!out) {
+    fprintf(stderr, "sash: %s: %s\n", path, strerror(errno));
+    ok = false;
+  } else {
+    for (size_t i = 0; i < n; i++)
+      fprintf(out, "%s %lu\n", table[i].stack, table[i].count);
+    if (fclose(out) != 0) {
+      fprintf(stderr, "sash: %s: %s\n", path, strerror(errno));
+      ok = false;
+    }
+  }
+  unsigned dropped = atomic_load(&g_dropped);
+  if (dropped > 0)
+    fprintf(stderr, "sash: profile buffer full, %u samples not recorded\n",
+            dropped);
+
+  for (size_t i = 0; i < n; i++)
+    free(table[i].stack);
+  free(table);
+  free(g_syms);
+  free(g_strtab);
+  free(g_frames);
+  free(g_depths);
+  g_syms = NULL;
+  g_strtab = NULL;
+  g_frames = NULL;
+  g_depths = NULL;
+  return ok;
+}
+
+#else /* unsupported platform */
+
+bool profile_start(void) {
+  fprintf(stderr, "sash: --profile is only supported on Linux x86-64 and "
+                  "arm64\n");
+  return false;
+}
+
+bool profile_write(const char *path, bool append) {
+  (void)path;
+  (void)append;
+  return false;
+}
+
+#endif
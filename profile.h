@@ -0,0 +1,15 @@
+/*
+ * profile.h - Built-in sampling profiler
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+
+bool profile_start(void);
+bool profile_write(const char *path, bool append);
+
+#endif /* PROFILE_H */
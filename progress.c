@@ -0,0 +1,120 @@
+/*
+ * progress.c - Structured progress from the command
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * With --progress-fd the command writes progress lines to a pipe of their
+ * own instead of sash scanning its output.  Each line may have, in order
+ * and each optional:
+ *
+ *   42/100 [compile] building libfoo.a
+ *
+ * items done (of an optional total), a bracketed phase name, and free
+ * status text.  Counts and phase persist until a later line changes them;
+ * the text is replaced by every line.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "progress.h"
+
+static size_t skip_spaces(const char *s, size_t i, size_t len) {
+  while (i < len && isspace((unsigned char)s[i]))
+    i++;
+  return i;
+}
+
+/* Parse "N" at s[i]; returns the index after it, or i if there's none. */
+static size_t parse_uint(const char *s, size_t i, size_t len, uint64_t *out) {
+  uint64_t v = 0;
+  size_t start = i;
+  while (i < len && isdigit((unsigned char)s[i]) && i - start < 19)
+    v = v * 10 + (uint64_t)(s[i++] - '0');
+  *out = v;
+  return i;
+}
+
+/* Copy s[0, n) into a fixed field, turning control bytes into spaces. */
+static void copy_field(char *dst, size_t cap, const char *s, size_t n) {
+  if (n >= cap)
+    n = cap - 1;
+  for (size_t k = 0; k < n; k++) {
+    unsigned char c = (unsigned char)s[k];
+    dst[k] = c < 0x20 || c == 0x7f ? ' ' : (char)c;
+  }
+  dst[n] = '\0';
+}
+
+void progress_parse(Progress *p, const char *line, size_t len) {
+  while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+    len--;
+  size_t i = skip_spaces(line, 0, len);
+
+  /* counts: a word of digits, optionally "/" and more digits */
+  uint64_t done, total;
+  size_t j = parse_uint(line, i, len, &done);
+  if (j > i && (j == len || isspace((unsigned char)line[j]) ||
+                line[j] == '/')) {
+    bool has_total = false;
+    size_t k = j;
+    if (k < len && line[k] == '/') {
+      k = parse_uint(line, j + 1, len, &total);
+      has_total = k > j + 1;
+    }
+    if (k == len || isspace((unsigned char)line[k])) {
+      p->has_done = true;
+      p->done = done;
+      p->has_total = has_total;
+      if (has_total)
+        p->total = total;
+      i = skip_spaces(line, k, len);
+    }
+  }
+
+  if (i < len && line[i] == '[') {
+    const char *close = memchr(line + i, ']', len - i);
+    if (close) {
+      copy_field(p->phase, sizeof(p->phase), line + i + 1,
+                 (size_t)(close - line) - i - 1);
+      i = skip_spaces(line, (size_t)(close - line) + 1, len);
+    }
+  }
+
+  copy_field(p->text, sizeof(p->text), line + i, len - i);
+}
+
+/* Status-area form: "[compile] 42/100 42% building libfoo.a". */
+size_t progress_format(const Progress *p, char *out, size_t cap) {
+  size_t o = 0;
+  int n;
+  out[0] = '\0';
+  if (p->phase[0]) {
+    n = snprintf(out + o, cap - o, "[%s]", p->phase);
+    o += n > 0 ? (size_t)n : 0;
+  }
+  if (o < cap && p->has_done) {
+    if (p->has_total && p->total > 0)
+      n = snprintf(out + o, cap - o, "%s%llu/%llu %d%%", o ? " " : "",
+                   (unsigned long long)p->done, (unsigned long long)p->total,
+                   p->done >= p->total
+                       ? 100
+                       : (int)((double)p->done * 100 / (double)p->total));
+    else
+      n = snprintf(out + o, cap - o, "%s%llu", o ? " " : "",
+                   (unsigned long long)p->done);
+    o += n > 0 ? (size_t)n : 0;
+  }
+  if (o < cap && p->text[0]) {
+    n = snprintf(out + o, cap - o, "%s%s", o ? " " : "", p->text);
+    o += n > 0 ? (size_t)n : 0;
+  }
+  return o < cap ? o : cap - 1;
+}
@@ -0,0 +1,26 @@
+/*
+ * progress.h - Structured progress from the command
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  bool has_done;
+  bool has_total;
+  uint64_t done;
+  uint64_t total;
+  char phase[32];
+  char text[96];
+} Progress;
+
+void progress_parse(Progress *p, const char *line, size_t len);
+size_t progress_format(const Progress *p, char *out, size_t cap);
+
+#endif /* PROGRESS_H */
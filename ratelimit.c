@@ -0,0 +1,94 @@
+/*
+ * ratelimit.c - Token bucket
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * The bucket holds one second's worth of tokens and refills continuously,
+ * so short bursts up to the per-second budget pass untouched while the
+ * long-run average is held to the rate.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#include "ratelimit.h"
+#include "timer.h"
+
+void bucket_init(TokenBucket *b, double rate, uint64_t now) {
+  b->rate = rate;
+  b->burst = rate;
+  b->tokens = rate;
+  b->last = now;
+}
+
+/*
+ * Take n tokens if available.  A request larger than the whole bucket
+ * (e.g. one line longer than a second's byte budget) is let through when
+ * the bucket is full and leaves it in debt, so it can't starve forever.
+ */
+bool bucket_take(TokenBucket *b, double n, uint64_t now) {
+  if (b->rate <= 0)
+    return true;
+
+  if (now > b->last) {
+    b->tokens += b->rate * (double)(now - b->last) / (double)NS_PER_SEC;
+    if (b->tokens > b->burst)
+      b->tokens = b->burst;
+    b->last = now;
+  }
+
+  double need = n < b->burst ? n : b->burst;
+  if (b->tokens < need)
+    return false;
+  b->tokens -= n;
+  return true;
+}
+
+/*
+ * Parse a byte rate such as "500K", "10MB/s" or "1.5MiB/s".  Suffixes are
+ * binary (K = 1024).  Returns false on malformed input or a rate <= 0.
+ */
+bool parse_rate(const char *s, double *rate) {
+  char *end;
+  errno = 0;
+  double v = strtod(s, &end);
+  if (errno != 0 || end == s || v <= 0)
+    return false;
+
+  double mult = 1;
+  switch (*end) {
+  case 'k':
+  case 'K':
+    mult = 1024.0;
+    end++;
+    break;
+  case 'm':
+  case 'M':
+    mult = 1024.0 * 1024;
+    end++;
+    break;
+  case 'g':
+  case 'G':
+    mult = 1024.0 * 1024 * 1024;
+    end++;
+    break;
+  }
+  if (mult > 1 && *end == 'i')
+    end++;
+  if (*end == 'B' || *end == 'b')
+    end++;
+  if (strcasecmp(end, "/s") == 0 || strcasecmp(end, "ps") == 0)
+    end += 2;
+  if (*end != '\0')
+    return false;
+
+  *rate = v * mult;
+  return true;
+}
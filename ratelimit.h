@@ -0,0 +1,24 @@
+/*
+ * ratelimit.h - Token bucket
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+  double rate;   /* tokens per second, 0 = unlimited */
+  double burst;  /* bucket size */
+  double tokens;
+  uint64_t last; /* monotonic ns of the last refill */
+} TokenBucket;
+
+void bucket_init(TokenBucket *b, double rate, uint64_t now);
+bool bucket_take(TokenBucket *b, double n, uint64_t now);
+bool parse_rate(const char *s, double *rate);
+
+#endif /* RATELIMIT_H */
@@ -26,6 +26,7 @@ void ringbuf_init(RingBuf *rb, size_t cap) {
   rb->capacity = cap;
   rb->head = 0;
   rb->count = 0;
+  rb->generation = 0;
 }
 
 void ringbuf_push(RingBuf *rb, const char *line, size_t len) {
@@ -38,6 +39,7 @@ void ringbuf_push(RingBuf *rb, const char *line, size_t len) {
     rb->head = (rb->head + 1) % rb->capacity;
     free(rb->lines[slot]);
   }
+  rb->generation++;
   rb->lines[slot] = strndup(line, len);
   if (!rb->lines[slot]) {
     rb->lengths[slot] = 0;
@@ -8,6 +8,7 @@
 #define RINGBUF_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 typedef struct {
   char **lines;
@@ -15,6 +16,7 @@ typedef struct {
   size_t capacity;
   size_t head;
   size_t count;
+  uint64_t generation; /* bumped on every push */
 } RingBuf;
 
 void ringbuf_init(RingBuf *rb, size_t cap);
@@ -15,32 +15,57 @@
 #endif
 
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <limits.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "cast.h"
 #include "display.h"
+#include "fields.h"
+#include "follow.h"
+#include "ingest.h"
+#include "governor.h"
+#include "history.h"
+#include "input.h"
+#include "match.h"
+#include "minimap.h"
+#include "plugin.h"
+#include "profile.h"
 #include "process.h"
+#include "progress.h"
+#include "ratelimit.h"
 #include "ringbuf.h"
 #include "sash.h"
+#include "serve.h"
+#include "sidx.h"
+#include "sink.h"
+#include "snapshot.h"
+#include "stall.h"
+#include "syslogsink.h"
+#include "timer.h"
+#include "upgrade.h"
 
 /* ── Globals ─────────────────────────────────────────────────────── */
 
 volatile sig_atomic_t g_resize = 0;
 static volatile sig_atomic_t g_sigint = 0;
+static volatile sig_atomic_t g_sigterm = 0;
 static volatile sig_atomic_t g_sigpipe = 0;
+static volatile sig_atomic_t g_dump_history = 0;
+static volatile sig_atomic_t g_upgrade = 0;
 
 static pid_t g_child_pid = 0;
 
 RingBuf g_ring;
-static FILE **g_files = NULL;
-static int g_nfiles = 0;
 static FILE *g_tty = NULL;
 int g_tty_fd = -1;
 bool g_is_tty = false;
@@ -59,26 +84,166 @@ bool g_started = false;
 size_t g_total_lines = 0;
 bool g_ansi = true;
 static int g_ansi_mode = 0; /* 0=auto, 1=force on, -1=force off */
+Stats g_stats = {0};
+static bool g_show_stats = false;
+static const char *g_profile_path = NULL; /* --profile */
+static bool g_index_search = false;
+static bool g_grep = false;
+static double g_byte_rate = 0; /* limits for the -w/-W files that follow */
+static double g_line_rate = 0;
+static const char *g_serve_path = NULL;
+static bool g_serve_backlog = false;
+static bool g_keep_ring = false; /* ring is read by more than the window */
+static bool g_own_pgrp = false;   /* child leads its own process group */
+static bool g_stop_input = false;
 
-/* ── Helpers ─────────────────────────────────────────────────────── */
+/* --fail-on: the first matching line stops the command */
+#define EXIT_FAIL_ON 3
+#define KILL_GRACE_NS (5 * NS_PER_SEC)
+static char *g_fail_pattern = NULL;
+static Matcher g_fail_on;
+static char *g_failed_line = NULL;
+static size_t g_failed_lineno = 0;
+static Timer g_kill_timer;
 
-static void add_file(const char *path, const char *mode) {
-  g_files = realloc(g_files, (size_t)(g_nfiles + 1) * sizeof(FILE *));
-  if (!g_files) {
-    perror("sash: realloc");
-    exit(1);
-  }
-  g_files[g_nfiles] = fopen(path, mode);
-  if (!g_files[g_nfiles]) {
-    fprintf(stderr, "sash: cannot open '%s': %s\n", path, strerror(errno));
-    /* non-fatal: store NULL, skip during writes */
-  }
-  g_nfiles++;
-}
+/* --ready: a detached monitor reports readiness to the waiting parent */
+#define EXIT_READY_TIMEOUT 124
+static char *g_ready_pattern = NULL;
+static Matcher g_ready;
+static double g_ready_timeout = 0; /* seconds, 0 = wait forever */
+static int g_ready_fd = -1;        /* status pipe to the parent */
+static bool g_passthrough = true;  /* copy input to stdout without a tty */
+static Timer g_ready_timer;
+
+/* --snapshot-file: the window as a file, rewritten when it changes */
+static const char *g_snapshot_path = NULL;
+static uint64_t g_snapshot_interval = NS_PER_SEC;
+static uint64_t g_snapshot_gen = 0; /* ring generation last written */
+static uint64_t g_snapshot_time = 0;
+static size_t g_snapshot_lines = 0;
+static char g_command_state[64] = ""; /* for the snapshot header */
+static Timer g_snapshot_timer;
+
+/* --history: the last N lines, compressed; SIGUSR1 writes them out */
+static History *g_history = NULL;
+static uint64_t g_history_lines = 0;
+static const char *g_history_path = NULL;
+
+/* --minimap: the whole run's error density on a row under the window */
+#define MINIMAP_ERROR_DEFAULT                                                  \
+  "error|Error|ERROR|FATAL|fatal|panic|failed|FAILED"
+#define MINIMAP_WARN_DEFAULT "warning|Warning|WARNING|WARN"
+static bool g_minimap_on = false;
+static char *g_minimap_error_pattern = NULL;
+static char *g_minimap_warn_pattern = NULL;
+static Matcher g_minimap_error;
+static Matcher g_minimap_warn;
+static Minimap g_minimap;
+
+/* --plugin: stages every line passes through, run once per read */
+static Pipeline g_plugins;
+static bool g_batching = false; /* any plugin loaded, here or on a file */
+static sash_line *g_batch = NULL;
+static size_t g_batch_n = 0;
+static size_t g_batch_cap = 0;
+static char *g_batch_data = NULL;
+static size_t g_batch_len = 0;
+static size_t g_batch_data_cap = 0;
+
+/* SIGUSR2: re-exec ourselves (a new version, say), handing over state */
+static char **g_argv = NULL;          /* as started: getopt permutes argv */
+static LineReader *g_input_lr = NULL; /* the command's pipe or stdin */
+static FILE *g_inherited = NULL;      /* state from the process replaced */
+static int g_inherited_input = -1;
+static uint64_t g_inherited_kill_ns = 0; /* left of a --fail-on grace */
+static bool g_upgraded = false;          /* started by an upgrade */
+static int g_inherited_win_top = 0;
+static char *g_inherited_partial = NULL;
+static size_t g_inherited_partial_len = 0;
+
+/* --syslog: lines to the local syslog daemon too */
+static const char *g_syslog_spec = NULL;
+static const char *g_syslog_path = SYSLOG_DEFAULT_PATH;
+
+/* --cast: an asciicast recording of the window, at most cast-fps frames/s */
+static const char *g_cast_path = NULL;
+static bool g_cast_diff = false;
+static uint64_t g_cast_interval = NS_PER_SEC / 10;
+static uint64_t g_cast_time = 0; /* last frame recorded */
+static Timer g_cast_timer;
+
+/* --progress-fd: progress lines from the command on a pipe of their own */
+static int g_progress_fd = -1;   /* the command's fd number */
+static int g_progress_read = -1; /* our end */
+static LineReader g_progress_lr;
+static Progress g_progress;
+static bool g_have_progress = false;
+
+/* --follow-dir: files across directory trees instead of one input */
+static const char **g_follow_dirs = NULL;
+static int g_nfollow_dirs = 0;
+static const char *g_follow_glob = NULL;
+static char *g_follow_source = NULL; /* file of the last line followed */
+
+/* --reader-threads: -r files read concurrently, lines fed through a ring */
+static int g_reader_threads = 0;
+static char **g_ingest_paths = NULL;
+static int g_ingest_source = -1; /* source of the last batch */
+
+/* ── Timers ──────────────────────────────────────────────────────── */
+
+/* Frames are capped at 60/s; a line arriving after a quiet spell paints
+   immediately, bursts collapse into one frame per interval. */
+#define FRAME_INTERVAL_NS (NS_PER_SEC / 60)
+#define FRAME_SLACK_NS (4 * NS_PER_MS)
+
+/* Without -f, buffered file output is flushed this long after the first
+   unflushed write, rather than whenever stdio's buffer happens to fill. */
+#define FLUSH_INTERVAL_NS (1 * NS_PER_SEC)
+#define FLUSH_SLACK_NS (250 * NS_PER_MS)
+
+static uint64_t g_frame_interval = FRAME_INTERVAL_NS;
+static uint64_t g_flush_interval = FLUSH_INTERVAL_NS;
+static uint64_t g_last_frame = 0;
+static bool g_frame_dirty = false;
+static Timer g_frame_timer;
+static Timer g_flush_timer;
+
+/* --cpu-budget: each level trades fidelity for CPU */
+#define GOV_SAMPLE_NS (250 * NS_PER_MS)
+#define GOV_SLACK_NS (50 * NS_PER_MS)
+
+static const struct {
+  uint64_t frame_interval;
+  uint64_t flush_interval;
+  const char *status;
+} gov_levels[GOV_MAX_LEVEL + 1] = {
+    {FRAME_INTERVAL_NS, FLUSH_INTERVAL_NS, ""},
+    {NS_PER_SEC / 15, 2 * NS_PER_SEC, "cpu: 15 fps"},
+    {NS_PER_SEC / 4, 5 * NS_PER_SEC, "cpu: 4 fps"},
+    {NS_PER_SEC, 10 * NS_PER_SEC, "cpu: 1 fps"},
+};
+
+static double g_cpu_budget = 0; /* fraction of a CPU, 0 = unlimited */
+static Governor g_gov;
+static Timer g_gov_timer;
+static uint64_t g_gov_start = 0;
+static size_t g_gov_bytes = 0; /* input seen at the last sample */
+
+/* --stall-after: what the command is blocked on once it goes quiet */
+#define STALL_SAMPLE_NS NS_PER_SEC /* CPU use is measured over this */
+static uint64_t g_stall_after = 0; /* 0 = off */
+static uint64_t g_stall_quiet_since = 0;
+static bool g_stall_sampling = false; /* first sample taken, report next */
+static Stall g_stall;
+static Timer g_stall_timer;
+static char g_stall_status[96] = "";
+
+/* ── Helpers ─────────────────────────────────────────────────────── */
 
 static void usage(void) {
-  fprintf(stderr, "Usage: sash [-n lines] [-f] [-r] [-x] [-l] [-c|-C] [-a|-A] "
-                  "[-w file] [-W file] [-h] [command [args...]]\n"
+  fprintf(stderr, "Usage: sash [options] [command [args...]]\n"
+                  "       sash --grep FILE PATTERN\n"
                   "\n"
                   "  -n N    Window height (default: 10)\n"
                   "  -f      Flush output files after each line\n"
@@ -91,6 +256,103 @@ static void usage(void) {
                   "  -A      Force ANSI escape sequences off\n"
                   "  -w FILE Write output to FILE (truncate)\n"
                   "  -W FILE Append output to FILE\n"
+                  "  --jsonl FILE\n"
+                  "          Write each line to FILE as a JSON object with "
+                  "metadata\n"
+                  "  --max-rate RATE\n"
+                  "          Limit the files that follow to RATE bytes/s "
+                  "(e.g. 10MB/s)\n"
+                  "  --max-lines-per-sec N\n"
+                  "          Limit the files that follow to N lines/s\n"
+                  "  --index-search\n"
+                  "          Build a FILE.sidx trigram index for each output "
+                  "file\n"
+                  "  --grep FILE PATTERN\n"
+                  "          Print lines of FILE containing the literal "
+                  "PATTERN,\n"
+                  "          reading only the blocks its index points to\n"
+                  "  --syslog TAG[,FACILITY]\n"
+                  "          Send each line to syslog (/dev/log) as TAG, "
+                  "at info level\n"
+                  "  --syslog-socket PATH\n"
+                  "          Use the syslog daemon's socket at PATH\n"
+                  "  --serve PATH\n"
+                  "          Stream the raw input to clients of a Unix socket "
+                  "at PATH\n"
+                  "  --serve-backlog\n"
+                  "          Send new clients the lines in the window (or "
+                  "history) first\n"
+                  "  --history N\n"
+                  "          Keep the last N lines compressed in memory "
+                  "(e.g. 5M)\n"
+                  "  --history-file PATH\n"
+                  "          Write the history to PATH on SIGUSR1\n"
+                  "  --fail-on REGEX\n"
+                  "          Stop the command when a line matches; exit 3\n"
+                  "  --ready REGEX\n"
+                  "          Detach once a line matches; print the monitor "
+                  "pid, exit 0\n"
+                  "  --ready-timeout S\n"
+                  "          Give up on --ready after S seconds (exit 124)\n"
+                  "  --cpu-budget PCT\n"
+                  "          Keep sash under PCT%% of a CPU by drawing less "
+                  "often\n"
+                  "  --stall-after S\n"
+                  "          Report what the command is blocked on after S "
+                  "seconds quiet\n"
+                  "  --progress-fd N\n"
+                  "          Give the command a progress pipe on fd N "
+                  "($SASH_PROGRESS_FD)\n"
+                  "  --stat-field KEY\n"
+                  "          Show p50/p90/p99/max of KEY=NUMBER over the "
+                  "stat window\n"
+                  "  --distinct-field KEY\n"
+                  "          Show an estimate of the distinct values of KEY\n"
+                  "  --stat-window S\n"
+                  "          Window for --stat-field, in seconds (default: "
+                  "60)\n"
+                  "  --minimap\n"
+                  "          Show the whole run's error density on a row "
+                  "under the window\n"
+                  "  --minimap-error REGEX\n"
+                  "          Count lines matching REGEX as errors "
+                  "(repeatable)\n"
+                  "  --minimap-warn REGEX\n"
+                  "          Count lines matching REGEX as warnings "
+                  "(repeatable)\n"
+                  "  --plugin SO[:ARGS]\n"
+                  "          Run lines through the plugin SO (repeatable, "
+                  "in order)\n"
+                  "  --file-plugin SO[:ARGS]\n"
+                  "          Run the next -w/-W/--jsonl file's lines through "
+                  "SO\n"
+                  "  --snapshot-file PATH\n"
+                  "          Keep the window's lines, with a short header, "
+                  "in PATH\n"
+                  "  --snapshot-interval S\n"
+                  "          Rewrite the snapshot at most every S seconds "
+                  "(default: 1)\n"
+                  "  --cast FILE\n"
+                  "          Record the window to FILE as an asciicast v2 "
+                  "stream\n"
+                  "  --cast-fps N\n"
+                  "          Record at most N frames per second (default: "
+                  "10)\n"
+                  "  --cast-diff\n"
+                  "          Record only the rows that changed in each "
+                  "frame\n"
+                  "  --follow-dir DIR\n"
+                  "          Follow the files under DIR as they grow "
+                  "(repeatable)\n"
+                  "  --reader-threads N\n"
+                  "          With -r, read the files on N threads at once\n"
+                  "  --glob PAT\n"
+                  "          Only follow files whose name matches PAT "
+                  "(default: *)\n"
+                  "  --profile FILE\n"
+                  "          Sample sash's own CPU use; write collapsed "
+                  "stacks to FILE\n"
+                  "  --stats Print line, byte and wakeup counts at exit\n"
                   "  -V      Show version\n"
                   "  -h      Show this help\n"
                   "\n"
@@ -101,18 +363,886 @@ static void usage(void) {
 /* ── File I/O ────────────────────────────────────────────────────── */
 
 static void write_to_files(const char *buf, size_t len) {
-  for (int i = 0; i < g_nfiles; i++) {
-    if (g_files[i]) {
-      if (fwrite(buf, 1, len, g_files[i]) < len) {
-        fprintf(stderr, "sash: write error on file %d: %s\n", i,
-                strerror(errno));
-        fclose(g_files[i]);
-        g_files[i] = NULL;
-      } else if (g_flush) {
-        fflush(g_files[i]);
+  sink_write(buf, len, g_flush);
+  if (!g_flush && sink_count() > 0 && !timer_armed(&g_flush_timer))
+    timer_arm_in(&g_flush_timer, g_flush_interval);
+}
+
+static void flush_files(void *arg) {
+  (void)arg;
+  sink_flush_all();
+}
+
+/* ── Frames ──────────────────────────────────────────────────────── */
+
+/* Append part to the status in buf[0, n), two spaces after anything
+   already there; returns the new length, clamped to the buffer. */
+static size_t status_part(char *buf, size_t cap, size_t n, const char *part) {
+  if (!*part || n + 1 >= cap)
+    return n;
+  int w = snprintf(buf + n, cap - n, "%s%s", n ? "  " : "", part);
+  n += w > 0 ? (size_t)w : 0;
+  return n < cap ? n : cap - 1;
+}
+
+/*
+ * The status area: the command's progress, field statistics, the
+ * governor's level, then what a quiet command is stalled on.
+ */
+static void update_status(void) {
+  char buf[192];
+  size_t n = 0;
+  buf[0] = '\0';
+  if (g_have_progress)
+    n = progress_format(&g_progress, buf, sizeof(buf));
+  if (fields_active() && n + 2 < sizeof(buf)) {
+    if (n > 0) {
+      memcpy(buf + n, "  ", 3);
+      n += 2;
+    }
+    n += fields_status(buf + n, sizeof(buf) - n, now_ns());
+  }
+  n = status_part(buf, sizeof(buf), n, gov_levels[g_gov.level].status);
+  status_part(buf, sizeof(buf), n, g_stall_status);
+  display_set_status(buf);
+}
+
+/* Fold the minimap's buckets into a row as wide as the terminal. */
+static void update_minimap(void) {
+  if (!g_minimap_on)
+    return;
+  char row[MINIMAP_ROW_MAX(MINIMAP_BUCKETS)];
+  int cols = g_term_cols < MINIMAP_BUCKETS ? g_term_cols : MINIMAP_BUCKETS;
+  display_set_minimap(row, minimap_render(&g_minimap, cols, g_color, row));
+}
+
+static void record_cast(void) {
+  if (!g_is_tty) {
+    update_status(); /* otherwise draw_frame() keeps them current */
+    update_minimap();
+  }
+  g_cast_time = now_ns();
+  cast_frame(g_cast_time);
+}
+
+static void cast_due(void *arg) {
+  (void)arg;
+  record_cast();
+}
+
+/* Record now if a cast frame interval has passed, otherwise schedule it;
+   frames in between are folded into the next recorded one. */
+static void request_cast(void) {
+  if (!g_cast_path || timer_armed(&g_cast_timer))
+    return;
+  uint64_t now = now_ns();
+  if (now - g_cast_time >= g_cast_interval)
+    record_cast();
+  else
+    timer_arm(&g_cast_timer, g_cast_time + g_cast_interval);
+}
+
+static void draw_frame(void *arg) {
+  (void)arg;
+  if (g_is_tty) {
+    update_status();
+    update_minimap();
+  }
+  redraw_window();
+  g_last_frame = now_ns();
+  g_frame_dirty = false;
+  request_cast(); /* the status may have changed without a new line */
+}
+
+/* Draw now if the frame interval has elapsed, otherwise schedule it. */
+static void request_frame(void) {
+  if (!g_frame_dirty || timer_armed(&g_frame_timer))
+    return;
+  uint64_t now = now_ns();
+  if (now - g_last_frame >= g_frame_interval)
+    draw_frame(NULL);
+  else
+    timer_arm(&g_frame_timer, g_last_frame + g_frame_interval);
+}
+
+/* ── CPU budget ──────────────────────────────────────────────────── */
+
+/*
+ * Sample our CPU use while input is flowing and move between levels.
+ * Sampling stops once input goes quiet, so an idle stream still costs no
+ * wakeups; the first sample after it resumes sees the quiet spell as low
+ * usage and helps fidelity come back.
+ */
+static void governor_tick(void *arg) {
+  (void)arg;
+  if (governor_sample(&g_gov, process_cpu_ns(), now_ns())) {
+    g_frame_interval = gov_levels[g_gov.level].frame_interval;
+    g_flush_interval = gov_levels[g_gov.level].flush_interval;
+    g_frame_dirty = true; /* to show the new level */
+    request_frame();
+  }
+  if (g_stats.bytes != g_gov_bytes) {
+    g_gov_bytes = g_stats.bytes;
+    timer_arm_in(&g_gov_timer, GOV_SAMPLE_NS);
+  }
+}
+
+/* ── Stall diagnostics ───────────────────────────────────────────── */
+
+/* A report line goes to the output files and, without a window to show
+   the summary in, to stderr. */
+static void stall_emit(const char *line, size_t len) {
+  write_to_files(line, len);
+  if (!g_is_tty)
+    fwrite(line, 1, len, stderr);
+}
+
+/*
+ * The command has been quiet for --stall-after.  The first sample only
+ * sets a baseline; STALL_SAMPLE_NS later the second one is reported, with
+ * the CPU each process used in between.  While the quiet lasts, reports
+ * repeat each time it has doubled, so a long wait doesn't flood the log.
+ */
+static void stall_tick(void *arg) {
+  (void)arg;
+  uint64_t now = now_ns();
+  if (g_child_pid <= 0 || stall_sample(&g_stall, (int)g_child_pid, now) == 0)
+    return; /* nothing left to look at */
+  if (!g_stall_sampling) {
+    g_stall_sampling = true;
+    timer_arm_in(&g_stall_timer, STALL_SAMPLE_NS);
+    return;
+  }
+
+  uint64_t quiet = now - g_stall_quiet_since;
+  char line[320];
+  int n = snprintf(line, sizeof(line), "sash: stall: no output for %llus\n",
+                   (unsigned long long)(quiet / NS_PER_SEC));
+  stall_emit(line, (size_t)n);
+  memcpy(line, "sash: stall: ", 13);
+  for (int i = 0; i < g_stall.nprocs; i++) {
+    size_t len = 13 + stall_format(&g_stall, i, line + 13, sizeof(line) - 14);
+    line[len++] = '\n';
+    stall_emit(line, len);
+  }
+  sink_flush_all(); /* the job may never write again */
+
+  stall_summary(&g_stall, quiet, g_stall_status, sizeof(g_stall_status));
+  g_frame_dirty = true;
+  request_frame();
+  request_cast();
+  g_stall_sampling = false;
+  timer_arm(&g_stall_timer, now + quiet - STALL_SAMPLE_NS);
+}
+
+/* Output arrived: any stall is over and the next one counts from now. */
+static void stall_input(void) {
+  if (!g_stall_after)
+    return;
+  stall_forget(&g_stall);
+  g_stall_sampling = false;
+  g_stall_quiet_since = now_ns();
+  timer_arm(&g_stall_timer, g_stall_quiet_since + g_stall_after);
+  if (g_stall_status[0]) {
+    g_stall_status[0] = '\0';
+    g_frame_dirty = true;
+  }
+}
+
+/* ── Snapshots ───────────────────────────────────────────────────── */
+
+static void write_snapshot(void) {
+  uint64_t now = now_ns();
+  double secs = (double)(now - g_snapshot_time) / NS_PER_SEC;
+  SnapshotInfo info = {
+      .lines = g_total_lines,
+      .rate = secs > 0 ? (double)(g_total_lines - g_snapshot_lines) / secs : 0,
+      .command = g_command_state[0] ? g_command_state : NULL,
+  };
+  if (!snapshot_write(g_snapshot_path, &info)) {
+    g_snapshot_path = NULL; /* don't repeat the error every interval */
+    return;
+  }
+  g_snapshot_gen = g_ring.generation;
+  g_snapshot_time = now;
+  g_snapshot_lines = g_total_lines;
+}
+
+/* Only armed while the ring has changed, so an idle stream costs nothing. */
+static void snapshot_due(void *arg) {
+  (void)arg;
+  if (g_snapshot_path && g_ring.generation != g_snapshot_gen)
+    write_snapshot();
+}
+
+static void request_snapshot(void) {
+  if (g_snapshot_path && !timer_armed(&g_snapshot_timer))
+    timer_arm(&g_snapshot_timer, g_snapshot_time + g_snapshot_interval);
+}
+
+/* ── Child control ───────────────────────────────────────────────── */
+
+/* Signal the child, and its whole process group when it has one. */
+static void signal_child(int sig) {
+  if (g_child_pid <= 0)
+    return;
+  if (g_own_pgrp)
+    kill(-g_child_pid, sig);
+  else
+    kill(g_child_pid, sig);
+}
+
+static void kill_child(void *arg) {
+  (void)arg;
+  signal_child(SIGKILL);
+}
+
+/* Append an alternative to an extended regex ("a" + "b" -> "a|b"). */
+static char *pattern_join(char *acc, const char *pattern) {
+  size_t old = acc ? strlen(acc) : 0;
+  size_t n = strlen(pattern);
+  acc = realloc(acc, old + n + 2);
+  if (!acc) {
+    perror("sash: realloc");
+    exit(1);
+  }
+  if (old > 0)
+    acc[old++] = '|';
+  memcpy(acc + old, pattern, n + 1);
+  return acc;
+}
+
+/*
+ * A --fail-on pattern matched: remember the line and terminate the
+ * command's process group, escalating to SIGKILL after a grace period.
+ * Output keeps being drained until the pipe closes, so the log holds
+ * everything the command printed.  Without a command there's nothing to
+ * signal, so input simply stops.
+ */
+static void fail_fast(const char *line, size_t len) {
+  if (len > 0 && line[len - 1] == '\n')
+    len--;
+  g_failed_line = strndup(line, len);
+  g_failed_lineno = g_total_lines;
+  if (g_child_pid > 0) {
+    signal_child(SIGTERM);
+    timer_arm_in(&g_kill_timer, KILL_GRACE_NS);
+  } else {
+    g_stop_input = true;
+  }
+}
+
+/*
+ * Wait for the command and return its wait status.  Input may have
+ * stopped while a TERM is still pending escalation (a --ready timeout,
+ * or --fail-on with the pipe closed), and the event loop no longer runs
+ * the kill timer, so poll for the exit here and send KILL on its
+ * deadline rather than waiting forever on a command that ignores TERM.
+ */
+static int reap_child(void) {
+  int status = 0;
+  while (timer_armed(&g_kill_timer)) {
+    pid_t r = waitpid(g_child_pid, &status, WNOHANG);
+    if (r == g_child_pid) {
+      timer_disarm(&g_kill_timer);
+      return status;
+    }
+    if (r < 0 && errno != EINTR)
+      break;
+    uint64_t now = now_ns();
+    if (now >= g_kill_timer.deadline) {
+      timer_disarm(&g_kill_timer);
+      kill_child(NULL);
+      break;
+    }
+    uint64_t wait = g_kill_timer.deadline - now;
+    if (wait > 10 * NS_PER_MS)
+      wait = 10 * NS_PER_MS;
+    struct timespec ts = {0, (long)wait};
+    nanosleep(&ts, NULL);
+  }
+  while (waitpid(g_child_pid, &status, 0) < 0 && errno == EINTR)
+    ;
+  return status;
+}
+
+/* ── Ready mode ──────────────────────────────────────────────────── */
+
+/* What the monitor reports, followed by the status the parent exits with */
+enum { READY_OK, READY_TIMED_OUT, READY_EXITED };
+
+/*
+ * Tell the waiting parent how things went, once.  The outcome travels
+ * apart from the status so a command that exits 124 isn't taken for a
+ * timeout.
+ */
+static void ready_notify(unsigned char outcome, unsigned char status) {
+  if (g_ready_fd < 0)
+    return;
+  unsigned char msg[2] = {outcome, status};
+  (void)!write(g_ready_fd, msg, sizeof(msg));
+  close(g_ready_fd);
+  g_ready_fd = -1;
+}
+
+static void ready_timed_out(void *arg) {
+  (void)arg;
+  ready_notify(READY_TIMED_OUT, EXIT_READY_TIMEOUT);
+  g_stop_input = true;
+  signal_child(SIGTERM);
+  timer_arm_in(&g_kill_timer, KILL_GRACE_NS);
+}
+
+/*
+ * Split into a waiting parent and a detached monitor.  The monitor (which
+ * returns from here) starts its own session with stdio on /dev/null and
+ * runs the command, teeing to the output files.  The parent blocks until
+ * the monitor reports, then prints the monitor's pid and exits 0 when
+ * ready, or with the failure status.
+ */
+static void ready_daemonize(void) {
+  int fds[2];
+  if (pipe(fds) == -1) {
+    perror("sash: pipe");
+    exit(1);
+  }
+  fflush(NULL);
+  pid_t pid = fork();
+  if (pid == -1) {
+    perror("sash: fork");
+    exit(1);
+  }
+
+  if (pid > 0) {
+    close(fds[1]);
+    /* the monitor dying without reporting counts as an exit with 1 */
+    unsigned char msg[2] = {READY_EXITED, 1};
+    size_t got = 0;
+    while (got < sizeof(msg)) {
+      ssize_t n = read(fds[0], msg + got, sizeof(msg) - got);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        break;
+      got += (size_t)n;
+    }
+    if (got < sizeof(msg)) {
+      msg[0] = READY_EXITED;
+      msg[1] = 1;
+    }
+    if (msg[0] == READY_OK)
+      printf("%d\n", (int)pid);
+    else if (msg[0] == READY_TIMED_OUT)
+      fprintf(stderr, "sash: not ready after %g seconds\n", g_ready_timeout);
+    else
+      fprintf(stderr, "sash: command exited before it was ready\n");
+    fflush(stdout);
+    _exit(msg[0] == READY_OK ? 0 : msg[1]);
+  }
+
+  close(fds[0]);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  g_ready_fd = fds[1];
+  setsid();
+  int null = open("/dev/null", O_RDWR);
+  if (null >= 0) {
+    dup2(null, STDIN_FILENO);
+    dup2(null, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    if (null > STDERR_FILENO)
+      close(null);
+  }
+  g_passthrough = false;
+}
+
+/* ── Live upgrade ────────────────────────────────────────────────── */
+
+static bool put_line(const char *line, size_t len, void *ctx) {
+  upgrade_put_bytes(ctx, line, len);
+  return true;
+}
+
+/*
+ * SIGUSR2: exec the binary we were started as, keeping the command, its
+ * pipe and the output files.  Everything read so far has been written
+ * out; the line read only in part, the window's lines, the history, the
+ * counters and a --fail-on match with its pending KILL go in the state.
+ * Lines still in the pipe are read by the new process, so none is lost
+ * or written twice.  Returns only if the upgrade isn't possible or the
+ * exec fails.
+ */
+static void upgrade_self(void) {
+  if (!g_input_lr || g_file_input || g_cast_path || g_ready_fd >= 0) {
+    fprintf(stderr, "sash: can't upgrade: needs a command or piped input, "
+                    "and not --cast or a pending --ready\n");
+    return;
+  }
+  FILE *st = upgrade_create();
+  if (!st)
+    return;
+
+  int nsinks = sink_count();
+  int *keep = malloc((size_t)(nsinks + 2) * sizeof(int));
+  if (!keep) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  sink_prepare_upgrade(keep);
+  if (g_passthrough)
+    fflush(stdout);
+  /* what syslog won't take in a second is reported by the new process */
+  unsigned long long syslog_lost = g_syslog_spec ? syslogsink_drain() : 0;
+  if (g_profile_path) {
+    /* the new process profiles itself and appends */
+    profile_write(g_profile_path, g_upgraded);
+    g_profile_path = NULL;
+  }
+
+  upgrade_put_u64(st, (uint64_t)g_child_pid);
+  upgrade_put_u64(st, (uint64_t)g_input_lr->fd);
+  upgrade_put_u64(st, (uint64_t)(int64_t)g_progress_read);
+  upgrade_put_u64(st, (uint64_t)(g_started ? g_win_top : 0));
+  upgrade_put_u64(st, g_passthrough);
+  upgrade_put_u64(st, g_total_lines);
+  upgrade_put_u64(st, g_stats.bytes);
+  upgrade_put_u64(st, g_stats.wakeups);
+  upgrade_put_u64(st, g_stats.frames);
+  upgrade_put_u64(st, g_stats.dropped_lines);
+  upgrade_put_u64(st, g_failed_line != NULL);
+  upgrade_put_u64(st, g_failed_lineno);
+  upgrade_put_bytes(st, g_failed_line ? g_failed_line : "",
+                    g_failed_line ? strlen(g_failed_line) : 0);
+  uint64_t kill_in = 0; /* no KILL pending */
+  if (timer_armed(&g_kill_timer)) {
+    uint64_t now = now_ns();
+    kill_in = g_kill_timer.deadline > now ? g_kill_timer.deadline - now : 1;
+  }
+  upgrade_put_u64(st, kill_in);
+  upgrade_put_u64(st, syslog_lost);
+  upgrade_put_bytes(st, g_input_lr->buf, g_input_lr->len);
+  upgrade_put_u64(st, (uint64_t)nsinks);
+  for (int i = 0; i < nsinks; i++)
+    upgrade_put_u64(st, (uint64_t)(int64_t)keep[i]);
+  upgrade_put_u64(st, g_ring.count);
+  for (size_t i = 0; i < g_ring.count; i++) {
+    size_t len;
+    const char *line = ringbuf_get(&g_ring, i, &len);
+    upgrade_put_bytes(st, line, len);
+  }
+  upgrade_put_u64(st, g_history ? history_count(g_history) : 0);
+  if (g_history)
+    history_each(g_history, 0, put_line, st);
+
+  int nkeep = 0;
+  for (int i = 0; i < nsinks; i++)
+    if (keep[i] >= 0)
+      keep[nkeep++] = keep[i];
+  keep[nkeep++] = g_input_lr->fd;
+  if (g_progress_read >= 0)
+    keep[nkeep++] = g_progress_read;
+  if (g_tty_fd >= 0)
+    fcntl(g_tty_fd, F_SETFD, FD_CLOEXEC); /* the new process opens its own */
+
+  upgrade_exec(st, g_argv, keep, nkeep);
+
+  /* still here: carry on as we were */
+  free(keep);
+  if (g_index_search)
+    sink_enable_index();
+}
+
+static int64_t get_int(void) {
+  uint64_t v;
+  if (!upgrade_get_u64(g_inherited, &v)) {
+    fprintf(stderr, "sash: truncated upgrade state\n");
+    exit(1);
+  }
+  return (int64_t)v;
+}
+
+/* The part of the state needed before the options are acted on: the
+   command, the input and the files -w and -W are to adopt. */
+static void restore_early(void) {
+  g_child_pid = (pid_t)get_int();
+  g_inherited_input = (int)get_int();
+  g_progress_read = (int)get_int();
+  g_inherited_win_top = (int)get_int();
+  g_passthrough = get_int() != 0;
+  g_total_lines = (size_t)get_int();
+  g_stats.bytes = (size_t)get_int();
+  g_stats.wakeups = (size_t)get_int();
+  g_stats.frames = (size_t)get_int();
+  g_stats.dropped_lines = (size_t)get_int();
+  bool failed = get_int() != 0;
+  g_failed_lineno = (size_t)get_int();
+  size_t len;
+  char *line = upgrade_get_bytes(g_inherited, &len);
+  if (!line) {
+    fprintf(stderr, "sash: truncated upgrade state\n");
+    exit(1);
+  }
+  if (failed)
+    g_failed_line = line;
+  else
+    free(line);
+  g_inherited_kill_ns = (uint64_t)get_int();
+  syslogsink_add_dropped((unsigned long long)get_int());
+  g_inherited_partial =
+      upgrade_get_bytes(g_inherited, &g_inherited_partial_len);
+  int nsinks = (int)get_int();
+  int *fds = malloc((size_t)(nsinks > 0 ? nsinks : 1) * sizeof(int));
+  if (!g_inherited_partial || !fds || nsinks < 0) {
+    fprintf(stderr, "sash: truncated upgrade state\n");
+    exit(1);
+  }
+  for (int i = 0; i < nsinks; i++)
+    fds[i] = (int)get_int();
+  sink_inherit(fds, nsinks);
+  free(fds);
+}
+
+/* The rest: the window's lines and the history. */
+static void restore_lines(void) {
+  for (int pass = 0; pass < 2; pass++) {
+    int64_t n = get_int();
+    for (int64_t i = 0; i < n; i++) {
+      size_t len;
+      char *line = upgrade_get_bytes(g_inherited, &len);
+      if (!line) {
+        fprintf(stderr, "sash: truncated upgrade state\n");
+        exit(1);
       }
+      if (pass == 0)
+        ringbuf_push(&g_ring, line, len);
+      else if (g_history)
+        history_push(g_history, line, len);
+      free(line);
+    }
+  }
+  fclose(g_inherited);
+  g_inherited = NULL;
+}
+
+/* ── Input ───────────────────────────────────────────────────────── */
+
+/*
+ * Everything a line goes to.  flags are the plugins' verdict
+ * (SASH_LINE_ERROR, SASH_LINE_WARN), which overrides the minimap's own
+ * patterns.
+ */
+static void process_line(const char *line, size_t len, unsigned flags) {
+  if (g_resize)
+    handle_resize();
+  g_total_lines++;
+  g_stats.bytes += len;
+  write_to_files(line, len);
+  serve_line(line, len);
+  if (g_syslog_spec)
+    syslogsink_line(line, len);
+  if (g_history)
+    history_push(g_history, line, len);
+  if (g_minimap_on)
+    minimap_add(&g_minimap,
+                flags & SASH_LINE_ERROR ? MINIMAP_ERROR
+                : flags & SASH_LINE_WARN
+                    ? MINIMAP_WARN
+                : matcher_match(&g_minimap_error, line, len) ? MINIMAP_ERROR
+                : matcher_match(&g_minimap_warn, line, len)  ? MINIMAP_WARN
+                                                             : MINIMAP_CLEAN);
+  if (fields_active())
+    fields_line(line, len, now_ns());
+  if (g_fail_pattern && !g_failed_line && matcher_match(&g_fail_on, line, len))
+    fail_fast(line, len);
+  if (g_ready_fd >= 0 && matcher_match(&g_ready, line, len)) {
+    sink_flush_all(); /* so the files hold everything up to the ready line */
+    ready_notify(READY_OK, 0);
+    timer_disarm(&g_ready_timer);
+  }
+  if (g_is_tty || g_keep_ring)
+    ringbuf_push(&g_ring, line, len);
+  request_snapshot();
+  request_cast();
+  if (g_is_tty)
+    g_frame_dirty = true;
+  else if (g_passthrough)
+    fwrite(line, 1, len, stdout);
+}
+
+/*
+ * With plugins loaded, lines are copied into a batch as they're read and
+ * run through the stages together once the read is done: one call per
+ * stage per read rather than per line.  ptr is filled in by run_plugins(),
+ * since the data buffer may move while the batch grows.
+ */
+static void batch_line(const char *line, size_t len) {
+  if (g_batch_n == g_batch_cap) {
+    g_batch_cap = g_batch_cap ? g_batch_cap * 2 : 256;
+    g_batch = realloc(g_batch, g_batch_cap * sizeof(sash_line));
+    if (!g_batch) {
+      perror("sash: realloc");
+      exit(1);
+    }
+  }
+  if (g_batch_len + len > g_batch_data_cap) {
+    while (g_batch_len + len > g_batch_data_cap)
+      g_batch_data_cap = g_batch_data_cap ? g_batch_data_cap * 2 : 65536;
+    g_batch_data = realloc(g_batch_data, g_batch_data_cap);
+    if (!g_batch_data) {
+      perror("sash: realloc");
+      exit(1);
+    }
+  }
+  memcpy(g_batch_data + g_batch_len, line, len);
+  g_batch_len += len;
+  g_batch[g_batch_n++] = (sash_line){.ptr = NULL, .len = len, .flags = 0};
+}
+
+static void on_line(const char *line, size_t len, void *ctx) {
+  (void)ctx;
+  if (g_batching)
+    batch_line(line, len);
+  else
+    process_line(line, len, 0);
+}
+
+/* Run the batch through --plugin, then hand what's left on. */
+static void run_plugins(void) {
+  if (g_batch_n == 0)
+    return;
+  size_t off = 0;
+  for (size_t i = 0; i < g_batch_n; i++) {
+    g_batch[i].ptr = g_batch_data + off;
+    off += g_batch[i].len;
+  }
+  pipeline_run(&g_plugins, g_batch, g_batch_n);
+
+  size_t kept = 0;
+  for (size_t i = 0; i < g_batch_n; i++)
+    if (!(g_batch[i].flags & SASH_LINE_DROP))
+      g_batch[kept++] = g_batch[i];
+  sink_begin_batch(g_batch, kept);
+  for (size_t i = 0; i < kept; i++)
+    process_line(g_batch[i].ptr, g_batch[i].len, g_batch[i].flags);
+  sink_end_batch();
+
+  pipeline_reset(&g_plugins);
+  g_batch_n = 0;
+  g_batch_len = 0;
+}
+
+/* Hand what the last read produced to the socket outputs. */
+static void flush_sockets(void) {
+  serve_flush();
+  if (g_syslog_spec)
+    syslogsink_flush();
+}
+
+/* Tag the lines that follow (in --jsonl records) as coming from a file. */
+static void set_file_source(const char *path) {
+  run_plugins(); /* the batch so far came from the old source */
+  size_t n = strlen(path);
+  char *source = malloc(n + sizeof("file:"));
+  if (!source) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  memcpy(source, "file:", 5);
+  memcpy(source + 5, path, n + 1);
+  sink_set_source(source);
+  free(source);
+}
+
+/* A line from a --follow-dir file; ctx is its path. */
+static void on_follow_line(const char *line, size_t len, void *ctx) {
+  const char *path = ctx;
+  if (!g_follow_source || strcmp(g_follow_source, path) != 0) {
+    free(g_follow_source);
+    g_follow_source = strdup(path);
+    if (!g_follow_source) {
+      perror("sash: strdup");
+      exit(1);
+    }
+    set_file_source(path);
+  }
+  on_line(line, len, NULL);
+}
+
+static void on_progress(const char *line, size_t len, void *ctx) {
+  (void)ctx;
+  progress_parse(&g_progress, line, len);
+  g_have_progress = true;
+  g_frame_dirty = true;
+}
+
+/* Read progress lines until the pipe is empty; stop watching it at EOF. */
+static void drain_progress(void) {
+  ssize_t n;
+  while ((n = linereader_fill(&g_progress_lr, on_progress, NULL)) > 0)
+    ;
+  if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+    linereader_free(&g_progress_lr);
+    close(g_progress_read);
+    g_progress_read = -1;
+  }
+  request_frame();
+}
+
+/*
+ * Read everything already waiting before drawing: a burst of lines costs
+ * one frame however many reads it takes, while a lone line still paints
+ * straight away.  A producer that never lets up is cut off after a frame
+ * interval so the window, timers and clients still get serviced.  Returns
+ * false on a read error.
+ */
+static bool drain_input(LineReader *lr) {
+  uint64_t start = now_ns();
+  bool ok = true;
+  for (;;) {
+    ssize_t n = linereader_fill(lr, on_line, NULL);
+    if (n < 0) {
+      ok = errno == EINTR || errno == EAGAIN;
+      break;
     }
+    run_plugins();
+    flush_sockets();
+    if (n == 0 || g_sigint || g_sigterm || g_stop_input)
+      break;
+    if (!linereader_pending(lr) || now_ns() - start >= g_frame_interval)
+      break;
+  }
+  request_frame();
+  return ok;
+}
+
+/*
+ * Event loop: sleep in poll() until the input fd is readable or the
+ * earliest timer is due, and hand readable input to ready().  With no
+ * timer armed the timeout is infinite, so an idle command costs no
+ * wakeups at all.  Runs until ready() reports the input is done or a
+ * signal stops us; returns false if interrupted by SIGINT or SIGTERM.
+ */
+static bool event_loop(int fd, bool (*ready)(void *arg), void *arg) {
+  while (!g_sigint && !g_sigterm && !g_stop_input) {
+    struct pollfd pfds[3 + SERVE_MAX_FDS];
+    pfds[0] = (struct pollfd){.fd = fd, .events = POLLIN};
+    /* a negative fd is ignored by poll() */
+    pfds[1] = (struct pollfd){.fd = g_progress_read, .events = POLLIN};
+    pfds[2] = (struct pollfd){
+        .fd = g_syslog_spec ? syslogsink_pollfd() : -1, .events = POLLOUT};
+    int nserve = serve_pollfds(&pfds[3]);
+    int rc = poll(pfds, (nfds_t)(3 + nserve), timer_poll_timeout(now_ns()));
+    g_stats.wakeups++;
+    if (rc < 0 && errno != EINTR)
+      break;
+
+    if (g_resize)
+      handle_resize();
+    if (g_dump_history) {
+      g_dump_history = 0;
+      history_write(g_history, g_history_path);
+    }
+    if (g_upgrade) {
+      g_upgrade = 0;
+      upgrade_self();
+    }
+    if (rc > 0 && pfds[0].revents)
+      stall_input(); /* before a stall report would run */
+    timer_run(now_ns());
+    if (rc <= 0)
+      continue;
+
+    serve_handle(&pfds[3], nserve);
+    if (g_progress_read >= 0 && pfds[1].revents)
+      drain_progress();
+    if (pfds[2].fd >= 0 && pfds[2].revents)
+      syslogsink_flush();
+    if (pfds[0].revents) {
+      if (!ready(arg))
+        break;
+      if (g_cpu_budget > 0 && !timer_armed(&g_gov_timer))
+        timer_arm_in(&g_gov_timer, GOV_SAMPLE_NS);
+    }
+  }
+
+  /* don't leave the last lines of the stream waiting on the frame cap */
+  if (timer_armed(&g_frame_timer)) {
+    timer_disarm(&g_frame_timer);
+    draw_frame(NULL);
+  }
+  return !g_sigint && !g_sigterm && !g_stop_input;
+}
+
+static bool input_ready(void *arg) {
+  LineReader *lr = arg;
+  return drain_input(lr) && !lr->eof;
+}
+
+/* Read one input fd to its end. */
+static bool run_input(int fd, bool owned) {
+  LineReader lr;
+  linereader_init(&lr, fd);
+  if (g_inherited_partial) {
+    linereader_preload(&lr, g_inherited_partial, g_inherited_partial_len);
+    free(g_inherited_partial);
+    g_inherited_partial = NULL;
   }
+  if (owned)
+    linereader_set_nonblock(&lr);
+  g_input_lr = &lr;
+  bool more = event_loop(fd, input_ready, &lr);
+  g_input_lr = NULL;
+  linereader_free(&lr);
+  return more;
+}
+
+static bool follow_ready(void *arg) {
+  (void)arg;
+  follow_handle(on_follow_line);
+  run_plugins();
+  flush_sockets();
+  request_frame();
+  return true;
+}
+
+static void on_batch(const IngestBatch *b, void *ctx) {
+  (void)ctx;
+  if (b->source != g_ingest_source) {
+    g_ingest_source = b->source;
+    set_file_source(g_ingest_paths[b->source]);
+  }
+  uint32_t start = 0;
+  for (uint32_t i = 0; i < b->nlines; i++) {
+    on_line(b->data + start, b->ends[i] - start, NULL);
+    start = b->ends[i];
+  }
+}
+
+static bool ingest_ready(void *arg) {
+  (void)arg;
+  bool more = ingest_drain(on_batch, NULL, g_frame_interval);
+  run_plugins();
+  flush_sockets();
+  request_frame();
+  return more;
+}
+
+/* Read the -r files on reader threads; lines of different files
+   interleave.  Returns false if interrupted. */
+static bool run_ingest(char **paths, const int *fds, int nfds) {
+  g_ingest_paths = paths;
+  if (!ingest_start(fds, nfds, g_reader_threads))
+    return false;
+  bool more = event_loop(ingest_fd(), ingest_ready, NULL);
+  ingest_stop();
+  return more;
+}
+
+/* Follow the --follow-dir trees until interrupted. */
+static void run_follow(void) {
+  event_loop(follow_fd(), follow_ready, NULL);
+  follow_close(on_follow_line);
+  free(g_follow_source);
+  g_follow_source = NULL;
 }
 
 /* ── Signal handling ─────────────────────────────────────────────── */
@@ -125,9 +1255,18 @@ static void sig_handler(int sig) {
   case SIGINT:
     g_sigint = 1;
     break;
+  case SIGTERM:
+    g_sigterm = 1;
+    break;
   case SIGPIPE:
     g_sigpipe = 1;
     break;
+  case SIGUSR1:
+    g_dump_history = 1;
+    break;
+  case SIGUSR2:
+    g_upgrade = 1;
+    break;
   }
 }
 
@@ -140,25 +1279,40 @@ static void setup_signals(void) {
   sa.sa_flags = SA_RESTART;
   sigaction(SIGWINCH, &sa, NULL);
 
-  /* SIGINT - do NOT restart, so getline returns */
+  /* SIGINT - do NOT restart, so poll returns */
   memset(&sa, 0, sizeof(sa));
   sa.sa_handler = sig_handler;
   sa.sa_flags = 0;
   sigaction(SIGINT, &sa, NULL);
 
+  /* SIGTERM - same: stop reading, then clean up and take the command down */
+  sigaction(SIGTERM, &sa, NULL);
+
   /* SIGPIPE - do NOT restart */
   memset(&sa, 0, sizeof(sa));
   sa.sa_handler = sig_handler;
   sa.sa_flags = 0;
   sigaction(SIGPIPE, &sa, NULL);
+
+  /* SIGUSR1 - write the history; do NOT restart, so poll returns */
+  if (g_history_path)
+    sigaction(SIGUSR1, &sa, NULL);
+
+  /* SIGUSR2 - upgrade in place; the same */
+  sigaction(SIGUSR2, &sa, NULL);
 }
 
 /* ── Cleanup ─────────────────────────────────────────────────────── */
 
 static void cleanup(void) {
+  if (g_profile_path) {
+    profile_write(g_profile_path, g_upgraded);
+    g_profile_path = NULL;
+  }
+
   /* kill child if still running */
   if (g_child_pid > 0) {
-    kill(g_child_pid, SIGTERM);
+    signal_child(SIGTERM);
     waitpid(g_child_pid, NULL, 0);
     g_child_pid = 0;
   }
@@ -166,12 +1320,7 @@ static void cleanup(void) {
   /* reset scroll region, move cursor below the window, show it */
   if (g_is_tty && g_started && g_tty_fd >= 0) {
     char buf[64];
-    int height = g_win_height;
-    if (height > g_term_rows - 1)
-      height = g_term_rows - 1;
-    if (height < 1)
-      height = 1;
-    int after = g_win_top + height;
+    int after = g_win_top + display_rows();
     if (after > g_term_rows)
       after = g_term_rows;
     int n = snprintf(buf, sizeof(buf), "\033[r\033[%d;1H\n\033[?25h", after);
@@ -179,14 +1328,77 @@ static void cleanup(void) {
       tty_write(buf, (size_t)n);
   }
 
-  /* close output files */
-  for (int i = 0; i < g_nfiles; i++) {
-    if (g_files[i])
-      fclose(g_files[i]);
+  /* before the stats, which count what it couldn't send */
+  syslogsink_close();
+
+  if (g_show_stats) {
+    fprintf(stderr, "sash: %zu lines, %zu bytes, %zu wakeups, %zu frames",
+            g_total_lines, g_stats.bytes, g_stats.wakeups, g_stats.frames);
+    if (g_stats.dropped_lines > 0)
+      fprintf(stderr, ", %zu dropped", g_stats.dropped_lines);
+    fputc('\n', stderr);
+    sink_print_stats(stderr);
+    if (g_syslog_spec)
+      syslogsink_print_stats(stderr);
+    if (g_history)
+      history_print_stats(g_history);
+    if (g_nfollow_dirs > 0)
+      follow_print_stats(stderr);
+    if (g_reader_threads > 0)
+      ingest_print_stats(stderr);
+    if (g_cpu_budget > 0) {
+      uint64_t wall = now_ns() - g_gov_start;
+      fprintf(stderr, "sash: cpu budget %g%%, used %.1f%%, peak level %d\n",
+              g_cpu_budget * 100,
+              wall ? 100.0 * (double)process_cpu_ns() / (double)wall : 0.0,
+              g_gov.peak);
+    }
+  }
+
+  if (fields_active()) {
+    fields_print(stderr);
+    fields_free();
   }
-  free(g_files);
-  g_files = NULL;
-  g_nfiles = 0;
+
+  if (g_failed_line) {
+    fprintf(stderr, "sash: --fail-on matched line %zu: %s\n", g_failed_lineno,
+            g_failed_line);
+    free(g_failed_line);
+    g_failed_line = NULL;
+  }
+  if (g_fail_pattern) {
+    matcher_free(&g_fail_on);
+    free(g_fail_pattern);
+    g_fail_pattern = NULL;
+  }
+  if (g_minimap_on) {
+    matcher_free(&g_minimap_error);
+    matcher_free(&g_minimap_warn);
+    g_minimap_on = false;
+  }
+  free(g_minimap_error_pattern);
+  free(g_minimap_warn_pattern);
+  g_minimap_error_pattern = g_minimap_warn_pattern = NULL;
+  if (g_ready_pattern) {
+    matcher_free(&g_ready);
+    free(g_ready_pattern);
+    g_ready_pattern = NULL;
+  }
+
+  if (g_progress_read >= 0) {
+    linereader_free(&g_progress_lr);
+    close(g_progress_read);
+    g_progress_read = -1;
+  }
+
+  /* close output files (and finish their indexes) */
+  sink_close_all();
+  pipeline_free(&g_plugins);
+  free(g_batch);
+  free(g_batch_data);
+  serve_close();
+  history_free(g_history);
+  g_history = NULL;
 
   /* close tty */
   if (g_tty) {
@@ -202,9 +1414,100 @@ static void cleanup(void) {
 
 /* ── Main ────────────────────────────────────────────────────────── */
 
+enum {
+  OPT_STATS = 256,
+  OPT_INDEX_SEARCH,
+  OPT_GREP,
+  OPT_MAX_RATE,
+  OPT_MAX_LINES,
+  OPT_SERVE,
+  OPT_SERVE_BACKLOG,
+  OPT_FAIL_ON,
+  OPT_READY,
+  OPT_READY_TIMEOUT,
+  OPT_CPU_BUDGET,
+  OPT_JSONL,
+  OPT_STAT_FIELD,
+  OPT_DISTINCT_FIELD,
+  OPT_STAT_WINDOW,
+  OPT_SNAPSHOT_FILE,
+  OPT_SNAPSHOT_INTERVAL,
+  OPT_PROGRESS_FD,
+  OPT_FOLLOW_DIR,
+  OPT_GLOB,
+  OPT_READER_THREADS,
+  OPT_PROFILE,
+  OPT_CAST,
+  OPT_CAST_FPS,
+  OPT_CAST_DIFF,
+  OPT_SYSLOG,
+  OPT_SYSLOG_SOCKET,
+  OPT_HISTORY,
+  OPT_HISTORY_FILE,
+  OPT_MINIMAP,
+  OPT_MINIMAP_ERROR,
+  OPT_MINIMAP_WARN,
+  OPT_PLUGIN,
+  OPT_FILE_PLUGIN,
+  OPT_STALL_AFTER,
+};
+
+static const struct option long_options[] = {
+    {"stats", no_argument, NULL, OPT_STATS},
+    {"index-search", no_argument, NULL, OPT_INDEX_SEARCH},
+    {"grep", no_argument, NULL, OPT_GREP},
+    {"max-rate", required_argument, NULL, OPT_MAX_RATE},
+    {"max-lines-per-sec", required_argument, NULL, OPT_MAX_LINES},
+    {"serve", required_argument, NULL, OPT_SERVE},
+    {"serve-backlog", no_argument, NULL, OPT_SERVE_BACKLOG},
+    {"fail-on", required_argument, NULL, OPT_FAIL_ON},
+    {"ready", required_argument, NULL, OPT_READY},
+    {"ready-timeout", required_argument, NULL, OPT_READY_TIMEOUT},
+    {"cpu-budget", required_argument, NULL, OPT_CPU_BUDGET},
+    {"jsonl", required_argument, NULL, OPT_JSONL},
+    {"stat-field", required_argument, NULL, OPT_STAT_FIELD},
+    {"distinct-field", required_argument, NULL, OPT_DISTINCT_FIELD},
+    {"stat-window", required_argument, NULL, OPT_STAT_WINDOW},
+    {"snapshot-file", required_argument, NULL, OPT_SNAPSHOT_FILE},
+    {"snapshot-interval", required_argument, NULL, OPT_SNAPSHOT_INTERVAL},
+    {"progress-fd", required_argument, NULL, OPT_PROGRESS_FD},
+    {"follow-dir", required_argument, NULL, OPT_FOLLOW_DIR},
+    {"glob", required_argument, NULL, OPT_GLOB},
+    {"reader-threads", required_argument, NULL, OPT_READER_THREADS},
+    {"profile", required_argument, NULL, OPT_PROFILE},
+    {"cast", required_argument, NULL, OPT_CAST},
+    {"cast-fps", required_argument, NULL, OPT_CAST_FPS},
+    {"cast-diff", no_argument, NULL, OPT_CAST_DIFF},
+    {"syslog", required_argument, NULL, OPT_SYSLOG},
+    {"syslog-socket", required_argument, NULL, OPT_SYSLOG_SOCKET},
+    {"history", required_argument, NULL, OPT_HISTORY},
+    {"history-file", required_argument, NULL, OPT_HISTORY_FILE},
+    {"minimap", no_argument, NULL, OPT_MINIMAP},
+    {"minimap-error", required_argument, NULL, OPT_MINIMAP_ERROR},
+    {"minimap-warn", required_argument, NULL, OPT_MINIMAP_WARN},
+    {"plugin", required_argument, NULL, OPT_PLUGIN},
+    {"file-plugin", required_argument, NULL, OPT_FILE_PLUGIN},
+    {"stall-after", required_argument, NULL, OPT_STALL_AFTER},
+    {"help", no_argument, NULL, 'h'},
+    {"version", no_argument, NULL, 'V'},
+    {NULL, 0, NULL, 0},
+};
+
 int main(int argc, char *argv[]) {
+  g_argv = malloc((size_t)(argc + 1) * sizeof(char *));
+  if (!g_argv) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  memcpy(g_argv, argv, (size_t)(argc + 1) * sizeof(char *));
+  g_inherited = upgrade_inherited();
+  g_upgraded = g_inherited != NULL;
+  if (g_inherited)
+    restore_early();
+
   int opt;
-  while ((opt = getopt(argc, argv, "Vn:frxlcCaAw:W:h")) != -1) {
+  while ((opt = getopt_long(argc, argv, "Vn:frxlcCaAw:W:h", long_options,
+                            NULL)) != -1) {
     switch (opt) {
     case 'V':
       printf("sash %s\n", SASH_VERSION);
@@ -245,10 +1548,207 @@ int main(int argc, char *argv[]) {
       g_ansi_mode = -1;
       break;
     case 'w':
-      add_file(optarg, "w");
+      sink_add(optarg, "w");
       break;
     case 'W':
-      add_file(optarg, "a");
+      sink_add(optarg, "a");
+      break;
+    case OPT_STAT_FIELD:
+    case OPT_DISTINCT_FIELD:
+      if (!*optarg) {
+        fprintf(stderr, "sash: empty field name\n");
+        return 1;
+      }
+      fields_add(optarg, opt == OPT_DISTINCT_FIELD);
+      break;
+    case OPT_STAT_WINDOW: {
+      char *endptr;
+      errno = 0;
+      double val = strtod(optarg, &endptr);
+      if (errno != 0 || *endptr != '\0' || endptr == optarg || val <= 0) {
+        fprintf(stderr, "sash: invalid window: '%s'\n", optarg);
+        return 1;
+      }
+      fields_set_window((uint64_t)(val * NS_PER_SEC));
+    } break;
+    case OPT_PROGRESS_FD: {
+      char *endptr;
+      errno = 0;
+      long val = strtol(optarg, &endptr, 10);
+      if (errno != 0 || *endptr != '\0' || endptr == optarg || val < 3 ||
+          val > 255) {
+        fprintf(stderr, "sash: invalid progress fd: '%s' (3-255)\n", optarg);
+        return 1;
+      }
+      g_progress_fd = (int)val;
+    } break;
+    case OPT_SNAPSHOT_FILE:
+      g_snapshot_path = optarg;
+      break;
+    case OPT_FOLLOW_DIR:
+      g_follow_dirs = realloc(g_follow_dirs, (size_t)(g_nfollow_dirs + 1) *
+                                                 sizeof(*g_follow_dirs));
+      if (!g_follow_dirs) {
+        perror("sash: realloc");
+        exit(1);
+      }
+      g_follow_dirs[g_nfollow_dirs++] = optarg;
+      break;
+    case OPT_GLOB:
+      g_follow_glob = optarg;
+      break;
+    case OPT_READER_THREADS: {
+      char *endptr;
+      errno = 0;
+      long val = strtol(optarg, &endptr, 10);
+      if (errno != 0 || *endptr != '\0' || endptr == optarg || val < 1 ||
+          val > 64) {
+        fprintf(stderr, "sash: invalid thread count: '%s' (1-64)\n",
+                optarg);
+        return 1;
+      }
+      g_reader_threads = (int)val;
+    } break;
+    case OPT_SNAPSHOT_INTERVAL: {
+      char *endptr;
+      errno = 0;
+      double val = strtod(optarg, &endptr);
+      if (errno != 0 || *endptr != '\0' || endptr == optarg || val <= 0) {
+        fprintf(stderr, "sash: invalid interval: '%s'\n", optarg);
+        return 1;
+      }
+      g_snapshot_interval = (uint64_t)(val * NS_PER_SEC);
+    } break;
+    case OPT_JSONL:
+      sink_add_jsonl(optarg);
+      break;
+    case OPT_STATS:
+      g_show_stats = true;
+      break;
+    case OPT_PROFILE:
+      g_profile_path = optarg;
+      break;
+    case OPT_CAST:
+      g_cast_path = optarg;
+      break;
+    case OPT_CAST_DIFF:
+      g_cast_diff = true;
+      break;
+    case OPT_SYSLOG:
+      g_syslog_spec = optarg;
+      break;
+    case OPT_SYSLOG_SOCKET:
+      g_syslog_path = optarg;
+      break;
+    case OPT_CAST_FPS: {
+      char *endptr;
+      errno = 0;
+      double val = strtod(optarg, &endptr);
+      if (errno != 0 || *endptr != '\0' || endptr == optarg || val <= 0 ||
+          val > 1000) {
+        fprintf(stderr, "sash: invalid frame rate: '%s'\n", optarg);
+        return 1;
+      }
+      g_cast_interval = (uint64_t)(NS_PER_SEC / val);
+    } break;
+    case OPT_INDEX_SEARCH:
+      g_index_search = true;
+      break;
+    case OPT_GREP:
+      g_grep = true;
+      break;
+    case OPT_MAX_RATE:
+      if (strcmp(optarg, "0") == 0) {
+        g_byte_rate = 0;
+      } else if (!parse_rate(optarg, &g_byte_rate)) {
+        fprintf(stderr, "sash: invalid rate: '%s'\n", optarg);
+        return 1;
+      }
+      sink_set_limits(g_byte_rate, g_line_rate);
+      break;
+    case OPT_MAX_LINES: {
+      char *endptr;
+      errno = 0;
+      double val = strtod(optarg, &endptr);
+      if (errno != 0 || *endptr != '\0' || endptr == optarg || val < 0) {
+        fprintf(stderr, "sash: invalid line rate: '%s'\n", optarg);
+        return 1;
+      }
+      g_line_rate = val;
+      sink_set_limits(g_byte_rate, g_line_rate);
+    } break;
+    case OPT_SERVE:
+      g_serve_path = optarg;
+      break;
+    case OPT_SERVE_BACKLOG:
+      g_serve_backlog = true;
+      break;
+    case OPT_HISTORY: {
+      char *endptr;
+      errno = 0;
+      double val = strtod(optarg, &endptr);
+      if (*endptr == 'K' || *endptr == 'k')
+        val *= 1e3, endptr++;
+      else if (*endptr == 'M' || *endptr == 'm')
+        val *= 1e6, endptr++;
+      if (errno != 0 || *endptr != '\0' || endptr == optarg || val < 1 ||
+          val > 1e12) {
+        fprintf(stderr, "sash: invalid line count: '%s'\n", optarg);
+        return 1;
+      }
+      g_history_lines = (uint64_t)val;
+    } break;
+    case OPT_HISTORY_FILE:
+      g_history_path = optarg;
+      break;
+    case OPT_MINIMAP:
+      g_minimap_on = true;
+      break;
+    case OPT_MINIMAP_ERROR:
+      g_minimap_error_pattern = pattern_join(g_minimap_error_pattern, optarg);
+      break;
+    case OPT_MINIMAP_WARN:
+      g_minimap_warn_pattern = pattern_join(g_minimap_warn_pattern, optarg);
+      break;
+    case OPT_PLUGIN:
+      if (!pipeline_load(&g_plugins, optarg))
+        return 1;
+      break;
+    case OPT_FILE_PLUGIN:
+      if (!sink_add_plugin(optarg))
+        return 1;
+      break;
+    case OPT_STALL_AFTER: {
+      char *endptr;
+      errno = 0;
+      double val = strtod(optarg, &endptr);
+      if (errno != 0 || *endptr != '\0' || endptr == optarg || val <= 0) {
+        fprintf(stderr, "sash: invalid stall threshold: '%s'\n", optarg);
+        return 1;
+      }
+      g_stall_after = (uint64_t)(val * NS_PER_SEC);
+    } break;
+    case OPT_FAIL_ON:
+      g_fail_pattern = pattern_join(g_fail_pattern, optarg);
+      break;
+    case OPT_READY:
+      g_ready_pattern = pattern_join(g_ready_pattern, optarg);
+      break;
+    case OPT_READY_TIMEOUT: {
+      char *endptr;
+      errno = 0;
+      double val = strtod(optarg, &endptr);
+      if (errno != 0 || *endptr != '\0' || endptr == optarg || val <= 0) {
+        fprintf(stderr, "sash: invalid timeout: '%s'\n", optarg);
+        return 1;
+      }
+      g_ready_timeout = val;
+    } break;
+    case OPT_CPU_BUDGET:
+      if (!parse_percent(optarg, &g_cpu_budget)) {
+        fprintf(stderr, "sash: invalid CPU budget: '%s'\n", optarg);
+        return 1;
+      }
       break;
     case 'h':
       usage();
@@ -259,6 +1759,111 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  if (g_grep) {
+    if (argc - optind != 2) {
+      usage();
+      return 2;
+    }
+    SidxStats st;
+    int rc = sidx_grep(argv[optind], argv[optind + 1], stdout, &st);
+    if (g_show_stats)
+      fprintf(stderr,
+              "sash: read %llu of %llu bytes (%u of %u indexed blocks)\n",
+              (unsigned long long)st.bytes_read,
+              (unsigned long long)st.file_bytes, st.blocks_read, st.blocks);
+    return rc;
+  }
+
+  if (g_fail_pattern) {
+    if (!matcher_init(&g_fail_on, g_fail_pattern)) {
+      free(g_fail_pattern);
+      g_fail_pattern = NULL;
+      return 1;
+    }
+    g_own_pgrp = true;
+  }
+
+  if (g_progress_fd >= 0 && (g_file_input || optind >= argc)) {
+    fprintf(stderr, "sash: --progress-fd needs a command to run\n");
+    return 1;
+  }
+  if (g_stall_after && (g_file_input || optind >= argc)) {
+    fprintf(stderr, "sash: --stall-after needs a command to run\n");
+    return 1;
+  }
+
+  if (g_minimap_on) {
+    if (!matcher_init(&g_minimap_error, g_minimap_error_pattern
+                                            ? g_minimap_error_pattern
+                                            : MINIMAP_ERROR_DEFAULT))
+      return 1;
+    if (!matcher_init(&g_minimap_warn, g_minimap_warn_pattern
+                                           ? g_minimap_warn_pattern
+                                           : MINIMAP_WARN_DEFAULT)) {
+      matcher_free(&g_minimap_error);
+      return 1;
+    }
+    minimap_init(&g_minimap);
+    display_set_minimap("", 0); /* reserve its row */
+  }
+
+  g_batching = g_plugins.nstages > 0 || sink_has_plugins();
+
+  if (g_history_path && g_history_lines == 0) {
+    fprintf(stderr, "sash: --history-file needs --history\n");
+    return 1;
+  }
+  if (g_follow_glob && g_nfollow_dirs == 0) {
+    fprintf(stderr, "sash: --glob needs --follow-dir\n");
+    return 1;
+  }
+  if (g_reader_threads > 0 && !(g_file_input && optind < argc)) {
+    fprintf(stderr, "sash: --reader-threads needs -r and files\n");
+    return 1;
+  }
+  if (g_nfollow_dirs > 0 && (g_file_input || optind < argc)) {
+    fprintf(stderr, "sash: --follow-dir can't be used with a command or -r\n");
+    return 1;
+  }
+
+  if (g_ready_pattern) {
+    if (g_file_input || optind >= argc) {
+      fprintf(stderr, "sash: --ready needs a command to run\n");
+      return 1;
+    }
+    if (!matcher_init(&g_ready, g_ready_pattern))
+      return 1;
+    g_own_pgrp = true;
+    /* before any threads or sockets: only this process carries on (an
+       upgraded one already has, and is the command's parent) */
+    if (!g_inherited)
+      ready_daemonize();
+  }
+
+  /* after ready_daemonize(): timers don't survive fork() */
+  if (g_profile_path && !profile_start())
+    return 1;
+
+  if (g_index_search)
+    sink_enable_index();
+
+  if (g_syslog_spec && !syslogsink_open(g_syslog_spec, g_syslog_path))
+    return 1;
+
+  if (g_history_lines > 0)
+    g_history = history_new(g_history_lines);
+
+  if (g_serve_path) {
+    if (!serve_open(g_serve_path, g_serve_backlog))
+      return 1;
+    if (g_history)
+      serve_set_history(g_history);
+    else
+      g_keep_ring = g_serve_backlog;
+  }
+  if (g_snapshot_path || g_cast_path)
+    g_keep_ring = true;
+
   /* detect controlling terminal */
   g_tty = fopen("/dev/tty", "r+");
   if (g_tty) {
@@ -285,24 +1890,37 @@ int main(int argc, char *argv[]) {
   }
 
   /* set up input source */
-  FILE *input = stdin;
+  int input_fd = STDIN_FILENO;
   int exit_code = 0;
 
-  if (g_file_input && optind < argc) {
+  if (g_nfollow_dirs > 0) {
+    if (!follow_open(g_follow_dirs, g_nfollow_dirs, g_follow_glob))
+      return 1;
+  } else if (g_file_input && optind < argc) {
     /* -r: treat positional args as input files */
   } else if (optind < argc) {
     /* command mode: positional args are the command */
-    int pipe_fd;
-    g_child_pid = spawn_command(&argv[optind], g_exec, &pipe_fd);
-    input = fdopen(pipe_fd, "r");
-    if (!input) {
-      perror("sash: fdopen");
-      close(pipe_fd);
-      kill(g_child_pid, SIGTERM);
-      waitpid(g_child_pid, NULL, 0);
-      g_child_pid = 0;
-      return 1;
+    SpawnOptions spawn = {
+        .use_exec = g_exec,
+        .own_pgrp = g_own_pgrp,
+        .progress_fd = g_progress_fd,
+    };
+    if (g_inherited)
+      input_fd = g_inherited_input; /* still running, still ours */
+    else
+      g_child_pid =
+          spawn_command(&argv[optind], &spawn, &input_fd, &g_progress_read);
+    if (g_syslog_spec)
+      syslogsink_set_pid((int)g_child_pid);
+    if (g_progress_read >= 0) {
+      linereader_init(&g_progress_lr, g_progress_read);
+      linereader_set_nonblock(&g_progress_lr);
     }
+    sink_set_source("command");
+    snprintf(g_command_state, sizeof(g_command_state), "running, pid %d",
+             (int)g_child_pid);
+  } else if (g_inherited) {
+    input_fd = g_inherited_input;
   } else if (isatty(STDIN_FILENO)) {
     fprintf(stderr, "sash: warning: reading from terminal "
                     "(did you forget to pipe input?)\n");
@@ -312,70 +1930,127 @@ int main(int argc, char *argv[]) {
   setup_signals();
 
   ringbuf_init(&g_ring, (size_t)g_win_height);
+  if (g_inherited)
+    restore_lines();
 
-  if (g_is_tty)
+  if (g_is_tty && g_inherited_win_top > 0)
+    resume_window(g_inherited_win_top);
+  else if (g_is_tty)
     setup_window();
 
-  /* main loop — process lines from one or more inputs */
-  char *line = NULL;
-  size_t line_cap = 0;
-  ssize_t nread;
+  timer_init(&g_frame_timer, draw_frame, NULL, FRAME_SLACK_NS);
+  timer_init(&g_flush_timer, flush_files, NULL, FLUSH_SLACK_NS);
+  timer_init(&g_kill_timer, kill_child, NULL, 100 * NS_PER_MS);
+  if (g_inherited_kill_ns > 0)
+    timer_arm_in(&g_kill_timer, g_inherited_kill_ns);
+  timer_init(&g_ready_timer, ready_timed_out, NULL, 100 * NS_PER_MS);
+  if (g_ready_fd >= 0 && g_ready_timeout > 0)
+    timer_arm_in(&g_ready_timer, (uint64_t)(g_ready_timeout * NS_PER_SEC));
+  timer_init(&g_gov_timer, governor_tick, NULL, GOV_SLACK_NS);
+  timer_init(&g_stall_timer, stall_tick, NULL, 100 * NS_PER_MS);
+  stall_init(&g_stall, NULL);
+  stall_input(); /* quiet so far */
+  timer_init(&g_snapshot_timer, snapshot_due, NULL, 100 * NS_PER_MS);
+  g_snapshot_time = now_ns();
+  timer_init(&g_cast_timer, cast_due, NULL, 10 * NS_PER_MS);
+  if (g_cast_path) {
+    if (!cast_open(g_cast_path, g_cast_diff, now_ns()))
+      return 1;
+    record_cast(); /* the empty window */
+    g_cast_time = 0; /* the first line needn't wait a frame interval */
+  }
+  g_gov_start = now_ns();
+  governor_init(&g_gov, g_cpu_budget, process_cpu_ns(), g_gov_start);
+  timer_apply_slack(FRAME_SLACK_NS);
 
-  if (g_file_input && optind < argc) {
+  /* main loop — process lines from one or more inputs */
+  if (g_nfollow_dirs > 0) {
+    run_follow();
+  } else if (g_file_input && optind < argc && g_reader_threads > 0) {
+    int *fds = malloc((size_t)(argc - optind) * sizeof(int));
+    char **paths = malloc((size_t)(argc - optind) * sizeof(char *));
+    if (!fds || !paths) {
+      perror("sash: malloc");
+      exit(1);
+    }
+    int nfds = 0;
     for (int i = optind; i < argc; i++) {
-      FILE *f = fopen(argv[i], "r");
-      if (!f) {
+      int fd = open(argv[i], O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
         fprintf(stderr, "sash: %s: %s\n", argv[i], strerror(errno));
         exit_code = 1;
         continue;
       }
-      while ((nread = getline(&line, &line_cap, f)) > 0) {
-        if (g_resize)
-          handle_resize();
-        g_total_lines++;
-        write_to_files(line, (size_t)nread);
-        if (g_is_tty) {
-          ringbuf_push(&g_ring, line, (size_t)nread);
-          redraw_window();
-        } else {
-          fwrite(line, 1, (size_t)nread, stdout);
-        }
-      }
-      fclose(f);
+      fds[nfds] = fd;
+      paths[nfds++] = argv[i];
     }
-  } else {
-    while ((nread = getline(&line, &line_cap, input)) > 0) {
-      if (g_resize)
-        handle_resize();
-      g_total_lines++;
-      write_to_files(line, (size_t)nread);
-      if (g_is_tty) {
-        ringbuf_push(&g_ring, line, (size_t)nread);
-        redraw_window();
-      } else {
-        fwrite(line, 1, (size_t)nread, stdout);
+    if (nfds > 0 && !run_ingest(paths, fds, nfds) && !g_sigint &&
+        !g_sigterm)
+      exit_code = 1;
+    for (int i = 0; i < nfds; i++)
+      close(fds[i]);
+    free(fds);
+    free(paths);
+  } else if (g_file_input && optind < argc) {
+    for (int i = optind; i < argc; i++) {
+      int fd = open(argv[i], O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        fprintf(stderr, "sash: %s: %s\n", argv[i], strerror(errno));
+        exit_code = 1;
+        continue;
       }
+      set_file_source(argv[i]);
+      bool more = run_input(fd, true);
+      close(fd);
+      if (!more)
+        break;
     }
+  } else {
+    run_input(input_fd, input_fd != STDIN_FILENO);
   }
 
-  free(line);
-
   /* reap child and propagate exit code */
   if (g_child_pid > 0) {
     int status;
-    waitpid(g_child_pid, &status, 0);
+    /* in its own group the child didn't see the terminal's ^C */
+    if (g_sigint && g_own_pgrp)
+      signal_child(SIGINT);
+    if (g_sigterm)
+      signal_child(SIGTERM);
+    /* and KILL it if it ignores the signal, as after --fail-on */
+    if ((g_sigint || g_sigterm) && !timer_armed(&g_kill_timer))
+      timer_arm_in(&g_kill_timer, KILL_GRACE_NS);
+    status = reap_child();
     g_child_pid = 0;
     if (WIFEXITED(status))
       exit_code = WEXITSTATUS(status);
     else if (WIFSIGNALED(status))
       exit_code = 128 + WTERMSIG(status);
+    snprintf(g_command_state, sizeof(g_command_state), "exited %d",
+             exit_code);
   }
 
-  if (input != stdin)
-    fclose(input);
+  /* a last snapshot with everything shown and the command's status */
+  if (g_snapshot_path)
+    write_snapshot();
+  if (g_cast_path) {
+    timer_disarm(&g_cast_timer);
+    record_cast();
+    cast_close();
+  }
+
+  if (input_fd != STDIN_FILENO)
+    close(input_fd);
+
+  /* exited without ever becoming ready */
+  ready_notify(READY_EXITED, exit_code ? (unsigned char)exit_code : 1);
 
-  if (g_sigint) {
+  if (g_failed_line) {
+    exit_code = EXIT_FAIL_ON;
+  } else if (g_sigint) {
     exit_code = 130;
+  } else if (g_sigterm) {
+    exit_code = 143;
   } else if (g_sigpipe) {
     exit_code = 141;
   }
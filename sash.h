@@ -13,6 +13,13 @@
 
 #include "ringbuf.h"
 
+typedef struct {
+  size_t bytes;
+  size_t wakeups; /* returns from poll(), whatever the cause */
+  size_t frames;
+  size_t dropped_lines; /* by output file rate limits */
+} Stats;
+
 extern volatile sig_atomic_t g_resize;
 
 extern RingBuf g_ring;
@@ -28,5 +35,6 @@ extern int g_win_top;
 extern bool g_started;
 extern size_t g_total_lines;
 extern bool g_ansi;
+extern Stats g_stats;
 
 #endif /* SASH_H */
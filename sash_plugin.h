@@ -0,0 +1,56 @@
+/*
+ * sash_plugin.h - ABI for in-process line plugins
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * A plugin is a shared object exporting `const sash_plugin
+ * sash_plugin_entry` with abi_version set to SASH_PLUGIN_ABI_VERSION.
+ * sash loads it with `--plugin PATH[:ARGS]` (every line, before the
+ * window and all outputs) or `--file-plugin PATH[:ARGS]` (just the output
+ * file named next), and calls init() once with ARGS.
+ *
+ * process() gets the lines of one read as a batch of slices and may, per
+ * line:
+ *   - drop it: set SASH_LINE_DROP (lines already dropped by an earlier
+ *     stage arrive with it set and should be skipped);
+ *   - rewrite it: point ptr at new text from arena->alloc(), which stays
+ *     valid until the batch has been written;
+ *   - annotate it: SASH_LINE_ERROR or SASH_LINE_WARN classify it for
+ *     --minimap.
+ * A slice's text must not be modified in place.  Calls are made from
+ * sash's main thread only.
+ */
+
+#ifndef SASH_PLUGIN_H
+#define SASH_PLUGIN_H
+
+#include <stddef.h>
+
+#define SASH_PLUGIN_ABI_VERSION 1
+
+#define SASH_LINE_DROP 0x1u
+#define SASH_LINE_ERROR 0x2u
+#define SASH_LINE_WARN 0x4u
+
+typedef struct {
+  const char *ptr;
+  size_t len; /* including the trailing newline, if the line has one */
+  unsigned flags;
+} sash_line;
+
+typedef struct sash_arena {
+  /* n bytes of scratch; NULL if out of memory */
+  void *(*alloc)(struct sash_arena *arena, size_t n);
+} sash_arena;
+
+typedef struct {
+  unsigned abi_version;
+  const char *name;
+  /* returns the plugin's state, or NULL (after saying why) on failure */
+  void *(*init)(const char *args);
+  void (*process)(void *state, sash_line *lines, size_t n,
+                  sash_arena *arena);
+  void (*fini)(void *state);
+} sash_plugin;
+
+#endif /* SASH_PLUGIN_H */
@@ -0,0 +1,457 @@
+/*
+ * serve.c - Fan-out of the raw stream over a Unix socket
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Lines read in one pass of the input are gathered into a reference-counted
+ * chunk, and every connected client queues a reference to it rather than a
+ * copy.  Clients are written with non-blocking sendmsg() straight away, so
+ * in the common case nothing stays queued; a client that can't keep up has
+ * whole chunks dropped once its queue reaches SERVE_CLIENT_LIMIT bytes, and
+ * is told how many lines it missed when it catches up.  The main loop never
+ * waits on a client.
+ *
+ * A history backlog can run to hundreds of megabytes, so it isn't queued
+ * up front: each new client keeps a cursor into the history and is given
+ * the next decompressed block only once it has sent the last, holding
+ * about one block however deep the history.  Live chunks aren't queued
+ * while it catches up, since the history has those lines too.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "history.h"
+#include "ringbuf.h"
+#include "sash.h"
+#include "serve.h"
+#include "timer.h"
+
+#define SERVE_CLIENT_LIMIT (1 << 20) /* queued bytes per client */
+#define SERVE_IOV_MAX 64
+#define SERVE_LINGER_MS 1000
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS (MSG_NOSIGNAL | MSG_DONTWAIT)
+#else
+#define SEND_FLAGS MSG_DONTWAIT
+#endif
+
+typedef struct {
+  int refs;
+  size_t len;
+  size_t cap;
+  size_t lines;
+  char data[];
+} Chunk;
+
+typedef struct {
+  int fd;
+  Chunk **q; /* ring of queued chunks */
+  size_t qhead;
+  size_t qlen;
+  size_t qcap;
+  size_t off;    /* bytes of q[qhead] already sent */
+  size_t queued; /* bytes not yet sent */
+  bool catching_up;      /* still sending the history backlog */
+  uint64_t history_next; /* next history line, counting evicted ones */
+  uint64_t dropped;
+  bool dead;
+} Client;
+
+static int g_listen_fd = -1;
+static char *g_path = NULL;
+static bool g_backlog = false;
+static History *g_history = NULL; /* backlog source instead of the ring */
+static Client g_clients[SERVE_MAX_CLIENTS];
+static int g_nclients = 0;
+static Chunk *g_pending = NULL; /* chunk being filled by serve_line() */
+
+/* ── Chunks ──────────────────────────────────────────────────────── */
+
+static Chunk *chunk_reserve(Chunk *c, size_t need) {
+  size_t len = c ? c->len : 0;
+  size_t cap = c ? c->cap : 0;
+  if (len + need <= cap)
+    return c;
+  cap = cap ? cap * 2 : 16384;
+  while (cap < len + need)
+    cap *= 2;
+  Chunk *grown = realloc(c, sizeof(Chunk) + cap);
+  if (!grown) {
+    perror("sash: realloc");
+    exit(1);
+  }
+  if (!c) {
+    grown->refs = 0;
+    grown->len = 0;
+    grown->lines = 0;
+  }
+  grown->cap = cap;
+  return grown;
+}
+
+static Chunk *chunk_append(Chunk *c, const char *data, size_t len) {
+  c = chunk_reserve(c, len);
+  memcpy(c->data + c->len, data, len);
+  c->len += len;
+  c->lines++;
+  return c;
+}
+
+static void chunk_release(Chunk *c) {
+  if (--c->refs == 0)
+    free(c);
+}
+
+/* ── Clients ─────────────────────────────────────────────────────── */
+
+static void client_enqueue(Client *c, Chunk *chunk) {
+  if (c->qlen == c->qcap) {
+    size_t cap = c->qcap ? c->qcap * 2 : 16;
+    Chunk **q = malloc(cap * sizeof(Chunk *));
+    if (!q) {
+      perror("sash: malloc");
+      exit(1);
+    }
+    for (size_t i = 0; i < c->qlen; i++)
+      q[i] = c->q[(c->qhead + i) % c->qcap];
+    free(c->q);
+    c->q = q;
+    c->qhead = 0;
+    c->qcap = cap;
+  }
+  c->q[(c->qhead + c->qlen) % c->qcap] = chunk;
+  c->qlen++;
+  c->queued += chunk->len;
+  chunk->refs++;
+}
+
+/* Queue the marker for lines dropped so far, if any.  It's a few bytes,
+   so it goes in whatever the client already has queued. */
+static void client_mark_dropped(Client *c) {
+  if (c->dead || c->dropped == 0)
+    return;
+  char msg[64];
+  int n = snprintf(msg, sizeof(msg), "\xe2\x80\xa6 %llu lines dropped\n",
+                   (unsigned long long)c->dropped);
+  Chunk *marker = chunk_append(NULL, msg, (size_t)n);
+  client_enqueue(c, marker); /* the queue holds the only reference */
+  c->dropped = 0;
+}
+
+/* Queue a chunk, or drop it if the client is too far behind. */
+static void client_push(Client *c, Chunk *chunk) {
+  if (c->dead)
+    return;
+  if (c->queued + chunk->len > SERVE_CLIENT_LIMIT) {
+    c->dropped += chunk->lines;
+    return;
+  }
+  client_mark_dropped(c);
+  client_enqueue(c, chunk);
+}
+
+static bool backlog_line(const char *line, size_t len, void *ctx) {
+  Chunk **chunk = ctx;
+  *chunk = chunk_append(*chunk, line, len);
+  return true;
+}
+
+/*
+ * Queue the next block of history for a client catching up.  Lines
+ * evicted before it got to them count as dropped; once it has been
+ * given the last line it takes live chunks again.
+ */
+static void client_refill(Client *c) {
+  HistoryStats st;
+  history_stats(g_history, &st);
+  if (c->history_next < st.evicted) {
+    c->dropped += st.evicted - c->history_next;
+    c->history_next = st.evicted;
+  }
+  Chunk *chunk = NULL;
+  size_t n = history_each_block(g_history, c->history_next - st.evicted,
+                                backlog_line, &chunk);
+  c->history_next += n;
+  if (n == 0 || c->history_next - st.evicted == st.lines)
+    c->catching_up = false;
+  client_mark_dropped(c);
+  if (chunk)
+    client_enqueue(c, chunk); /* the queue holds the only reference */
+}
+
+/* Write as much of the queue as the socket takes without blocking. */
+static void client_send(Client *c) {
+  while (!c->dead) {
+    if (c->qlen == 0 && c->catching_up)
+      client_refill(c);
+    if (c->qlen == 0)
+      return;
+    struct iovec iov[SERVE_IOV_MAX];
+    int niov = 0;
+    for (size_t i = 0; i < c->qlen && niov < SERVE_IOV_MAX; i++) {
+      Chunk *ch = c->q[(c->qhead + i) % c->qcap];
+      size_t skip = i == 0 ? c->off : 0;
+      iov[niov].iov_base = ch->data + skip;
+      iov[niov].iov_len = ch->len - skip;
+      niov++;
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = niov;
+    ssize_t n = sendmsg(c->fd, &msg, SEND_FLAGS);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        c->dead = true;
+      return;
+    }
+
+    size_t left = (size_t)n;
+    c->queued -= left;
+    while (left > 0) {
+      Chunk *ch = c->q[c->qhead];
+      size_t avail = ch->len - c->off;
+      if (left < avail) {
+        c->off += left;
+        break;
+      }
+      left -= avail;
+      c->off = 0;
+      c->qhead = (c->qhead + 1) % c->qcap;
+      c->qlen--;
+      chunk_release(ch);
+    }
+  }
+}
+
+static void client_free(Client *c) {
+  for (size_t i = 0; i < c->qlen; i++)
+    chunk_release(c->q[(c->qhead + i) % c->qcap]);
+  free(c->q);
+  close(c->fd);
+}
+
+static void reap_clients(void) {
+  int n = 0;
+  for (int i = 0; i < g_nclients; i++) {
+    if (g_clients[i].dead)
+      client_free(&g_clients[i]);
+    else
+      g_clients[n++] = g_clients[i];
+  }
+  g_nclients = n;
+}
+
+static void accept_clients(void) {
+  for (;;) {
+    int fd = accept(g_listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR)
+        continue;
+      return; /* EAGAIN, or a transient error; poll will report again */
+    }
+    if (g_nclients == SERVE_MAX_CLIENTS) {
+      close(fd);
+      continue;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+    Client *c = &g_clients[g_nclients++];
+    memset(c, 0, sizeof(*c));
+    c->fd = fd;
+
+    if (g_backlog && g_history) {
+      HistoryStats st;
+      history_stats(g_history, &st);
+      c->history_next = st.evicted;
+      c->catching_up = st.lines > 0;
+      client_send(c);
+    } else if (g_backlog && g_ring.count > 0) {
+      Chunk *backlog = NULL;
+      for (size_t i = 0; i < g_ring.count; i++) {
+        size_t len;
+        const char *line = ringbuf_get(&g_ring, i, &len);
+        backlog = chunk_append(backlog, line, len);
+      }
+      client_enqueue(c, backlog);
+      client_send(c);
+    }
+  }
+}
+
+/* ── Public API ──────────────────────────────────────────────────── */
+
+/*
+ * Listen on a Unix socket at path.  A stale socket left by an earlier run
+ * is replaced; any other existing file is an error.  With backlog, each
+ * new client first receives the lines currently in the ring, or the whole
+ * history once serve_set_history() has been called.
+ */
+bool serve_open(const char *path, bool backlog) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "sash: socket path too long: '%s'\n", path);
+    return false;
+  }
+  strcpy(addr.sun_path, path);
+
+  struct stat sb;
+  if (lstat(path, &sb) == 0 && S_ISSOCK(sb.st_mode))
+    unlink(path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("sash: socket");
+    return false;
+  }
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(fd, 16) != 0) {
+    fprintf(stderr, "sash: cannot listen on '%s': %s\n", path,
+            strerror(errno));
+    close(fd);
+    return false;
+  }
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  g_path = strdup(path);
+  if (!g_path) {
+    perror("sash: strdup");
+    exit(1);
+  }
+  g_listen_fd = fd;
+  g_backlog = backlog;
+  return true;
+}
+
+/* Send new clients the history as their backlog, a block at a time as
+   each one takes it. */
+void serve_set_history(History *h) { g_history = h; }
+
+bool serve_active(void) { return g_listen_fd >= 0; }
+
+/* Add a line to the chunk for the current read; costs nothing without
+   clients. */
+void serve_line(const char *line, size_t len) {
+  if (g_nclients > 0)
+    g_pending = chunk_append(g_pending, line, len);
+}
+
+/* Hand the current chunk to every client and write what they'll take. */
+void serve_flush(void) {
+  Chunk *chunk = g_pending;
+  g_pending = NULL;
+  if (!chunk)
+    return;
+
+  chunk->refs = 1; /* held across the loop so it can't be freed early */
+  for (int i = 0; i < g_nclients; i++) {
+    if (!g_clients[i].catching_up)
+      client_push(&g_clients[i], chunk);
+    client_send(&g_clients[i]);
+  }
+  chunk_release(chunk);
+  reap_clients();
+}
+
+/* Fill pfds with the listening socket and clients; returns the count. */
+int serve_pollfds(struct pollfd *pfds) {
+  if (g_listen_fd < 0)
+    return 0;
+  pfds[0].fd = g_listen_fd;
+  pfds[0].events = POLLIN;
+  pfds[0].revents = 0;
+  for (int i = 0; i < g_nclients; i++) {
+    /* POLLIN only to notice the peer hanging up */
+    pfds[i + 1].fd = g_clients[i].fd;
+    pfds[i + 1].events = POLLIN;
+    if (g_clients[i].qlen > 0)
+      pfds[i + 1].events |= POLLOUT;
+    pfds[i + 1].revents = 0;
+  }
+  return g_nclients + 1;
+}
+
+void serve_handle(const struct pollfd *pfds, int n) {
+  if (n == 0)
+    return;
+  for (int i = 1; i < n; i++) {
+    Client *c = &g_clients[i - 1];
+    if (!pfds[i].revents || c->fd != pfds[i].fd)
+      continue;
+    if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+      char sink[512];
+      ssize_t r = recv(c->fd, sink, sizeof(sink), MSG_DONTWAIT);
+      if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR))
+        c->dead = true;
+    }
+    if (pfds[i].revents & POLLOUT)
+      client_send(c);
+  }
+  reap_clients();
+  if (pfds[0].revents & POLLIN)
+    accept_clients();
+}
+
+/*
+ * At exit, give clients up to SERVE_LINGER_MS to take what's queued (plus
+ * a final drop marker), then disconnect everyone.
+ */
+void serve_close(void) {
+  if (g_listen_fd < 0)
+    return;
+  serve_flush();
+  for (int i = 0; i < g_nclients; i++)
+    client_mark_dropped(&g_clients[i]);
+
+  uint64_t deadline = now_ns() + SERVE_LINGER_MS * NS_PER_MS;
+  for (;;) {
+    struct pollfd pfds[SERVE_MAX_CLIENTS];
+    int n = 0;
+    for (int i = 0; i < g_nclients; i++) {
+      client_send(&g_clients[i]);
+      if (g_clients[i].qlen > 0 && !g_clients[i].dead)
+        pfds[n++] = (struct pollfd){.fd = g_clients[i].fd, .events = POLLOUT};
+    }
+    uint64_t now = now_ns();
+    if (n == 0 || now >= deadline)
+      break;
+    poll(pfds, (nfds_t)n, (int)((deadline - now) / NS_PER_MS) + 1);
+  }
+
+  for (int i = 0; i < g_nclients; i++)
+    client_free(&g_clients[i]);
+  g_nclients = 0;
+  close(g_listen_fd);
+  g_listen_fd = -1;
+  unlink(g_path);
+  free(g_path);
+  g_path = NULL;
+}
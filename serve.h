@@ -0,0 +1,28 @@
+/*
+ * serve.h - Fan-out of the raw stream over a Unix socket
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "history.h"
+
+#define SERVE_MAX_CLIENTS 64
+#define SERVE_MAX_FDS (SERVE_MAX_CLIENTS + 1)
+
+bool serve_open(const char *path, bool backlog);
+void serve_set_history(History *h);
+bool serve_active(void);
+void serve_line(const char *line, size_t len);
+void serve_flush(void);
+int serve_pollfds(struct pollfd *pfds);
+void serve_handle(const struct pollfd *pfds, int n);
+void serve_close(void);
+
+#endif /* SERVE_H */
@@ -0,0 +1,809 @@
+/*
+ * sidx.c - Trigram search index sidecar for output files
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * While an output file streams, its lines are grouped into blocks of about
+ * SIDX_BLOCK_SIZE bytes (always cut at a line boundary).  A background
+ * thread records, for every byte trigram, the list of blocks containing it.
+ * At close the lists are written to FILE.sidx as varint-delta postings
+ * behind a sorted directory, so a search for a literal can binary-search
+ * the directory, intersect a few postings and read only candidate blocks.
+ *
+ * The sidecar also records which data file it describes, as it was when
+ * the index was written: device, inode, modification time and size.  If
+ * any of them has changed the file has been rewritten or appended to
+ * since, and a search falls back to scanning the whole file.
+ *
+ * Other programs may append to the same file between sash's writes (as
+ * with -W).  The caller then passes the offset each write really landed
+ * at, and the bytes in between are recorded as a gap: a block ends where
+ * foreign bytes begin, and a search scans every gap along with the
+ * candidate blocks.
+ *
+ * Sidecar layout (all integers little-endian):
+ *
+ *   "SASHIDX3"
+ *   u32 block_size  u32 nblocks  u32 ntrigrams  u32 ngaps
+ *   u64 start       u64 end          byte range of the data file indexed
+ *   u64 dev  u64 ino  u64 mtime_ns  u64 size     the data file at close
+ *   { u64 start, u64 end } [nblocks]   byte range of each block
+ *   { u64 start, u64 end } [ngaps]     unindexed bytes between blocks
+ *   { u32 trigram, u32 count, u64 offset, u32 length } [ntrigrams]
+ *   posting bytes
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sidx.h"
+
+#define SIDX_MAGIC "SASHIDX3"
+#define SIDX_HEADER_SIZE 72
+#define SIDX_DIRENT_SIZE 20
+#define SIDX_MAX_PENDING 64 /* blocks queued for the indexer thread */
+#define TRIGRAM_SPACE (1u << 24)
+
+/* ── Writer ──────────────────────────────────────────────────────── */
+
+typedef struct Block {
+  struct Block *next;
+  uint32_t id;
+  size_t len;
+  size_t cap;
+  char data[];
+} Block;
+
+typedef struct {
+  uint32_t key; /* trigram + 1, 0 = empty slot */
+  uint32_t count;
+  uint32_t last;
+  uint32_t len;
+  uint32_t cap;
+  uint8_t *data;
+} Posting;
+
+struct SidxWriter {
+  char *path;
+  char *data_path;
+  uint64_t start;
+  uint64_t offset;
+
+  /* main thread */
+  Block *cur;
+  uint64_t *extents; /* start and end of each block */
+  uint32_t nblocks;
+  size_t extents_cap;
+  uint64_t *gaps; /* start and end of each run of foreign bytes */
+  uint32_t ngaps;
+  size_t gaps_cap;
+  bool lost; /* the file shrank under us: write no index */
+
+  /* queue shared with the indexer */
+  pthread_t thread;
+  pthread_mutex_t mu;
+  pthread_cond_t cv_work;
+  pthread_cond_t cv_space;
+  Block *head;
+  Block *tail;
+  int pending;
+  bool done;
+
+  /* indexer thread */
+  Posting *table;
+  size_t table_cap;
+  size_t table_count;
+  uint8_t *seen; /* TRIGRAM_SPACE bits, cleared after each block */
+  uint32_t *tris;
+  size_t tris_cap;
+};
+
+static void *xrealloc(void *p, size_t n) {
+  p = realloc(p, n);
+  if (!p) {
+    perror("sash: realloc");
+    exit(1);
+  }
+  return p;
+}
+
+static Posting *table_slot(SidxWriter *w, uint32_t key) {
+  size_t mask = w->table_cap - 1;
+  size_t i = (key * 2654435761u) & mask;
+  while (w->table[i].key && w->table[i].key != key)
+    i = (i + 1) & mask;
+  return &w->table[i];
+}
+
+static void table_grow(SidxWriter *w) {
+  Posting *old = w->table;
+  size_t old_cap = w->table_cap;
+  w->table_cap = old_cap ? old_cap * 2 : 4096;
+  w->table = calloc(w->table_cap, sizeof(Posting));
+  if (!w->table) {
+    perror("sash: calloc");
+    exit(1);
+  }
+  for (size_t i = 0; i < old_cap; i++) {
+    if (old[i].key)
+      *table_slot(w, old[i].key) = old[i];
+  }
+  free(old);
+}
+
+static void posting_add(SidxWriter *w, uint32_t tri, uint32_t block) {
+  if ((w->table_count + 1) * 4 > w->table_cap * 3)
+    table_grow(w);
+  Posting *p = table_slot(w, tri + 1);
+  if (!p->key) {
+    p->key = tri + 1;
+    w->table_count++;
+  }
+
+  if (p->len + 5 > p->cap) {
+    p->cap = p->cap ? p->cap * 2 : 8;
+    p->data = xrealloc(p->data, p->cap);
+  }
+  uint32_t delta = p->count ? block - p->last : block;
+  while (delta >= 0x80) {
+    p->data[p->len++] = (uint8_t)(delta | 0x80);
+    delta >>= 7;
+  }
+  p->data[p->len++] = (uint8_t)delta;
+  p->last = block;
+  p->count++;
+}
+
+static void index_block(SidxWriter *w, const Block *b) {
+  size_t ntris = 0;
+  const unsigned char *s = (const unsigned char *)b->data;
+  for (size_t i = 0; i + 2 < b->len; i++) {
+    uint32_t tri = (uint32_t)s[i] << 16 | (uint32_t)s[i + 1] << 8 | s[i + 2];
+    uint8_t bit = (uint8_t)(1u << (tri & 7));
+    if (w->seen[tri >> 3] & bit)
+      continue;
+    w->seen[tri >> 3] |= bit;
+    if (ntris == w->tris_cap) {
+      w->tris_cap = w->tris_cap ? w->tris_cap * 2 : 4096;
+      w->tris = xrealloc(w->tris, w->tris_cap * sizeof(uint32_t));
+    }
+    w->tris[ntris++] = tri;
+  }
+  for (size_t i = 0; i < ntris; i++) {
+    posting_add(w, w->tris[i], b->id);
+    w->seen[w->tris[i] >> 3] = 0;
+  }
+}
+
+static void *indexer_main(void *arg) {
+  SidxWriter *w = arg;
+  pthread_mutex_lock(&w->mu);
+  for (;;) {
+    while (!w->head && !w->done)
+      pthread_cond_wait(&w->cv_work, &w->mu);
+    Block *b = w->head;
+    if (!b)
+      break;
+    w->head = b->next;
+    if (!w->head)
+      w->tail = NULL;
+    w->pending--;
+    pthread_cond_signal(&w->cv_space);
+    pthread_mutex_unlock(&w->mu);
+
+    index_block(w, b);
+    free(b);
+
+    pthread_mutex_lock(&w->mu);
+  }
+  pthread_mutex_unlock(&w->mu);
+  return NULL;
+}
+
+/*
+ * Start indexing a data file whose next byte will land at start_offset.
+ * Returns NULL (with a message) if the indexer can't be started; the data
+ * file is unaffected either way.
+ */
+SidxWriter *sidx_open(const char *data_path, uint64_t start_offset) {
+  SidxWriter *w = calloc(1, sizeof(*w));
+  if (!w) {
+    perror("sash: calloc");
+    exit(1);
+  }
+  size_t n = strlen(data_path);
+  w->path = malloc(n + sizeof(SIDX_SUFFIX));
+  w->data_path = strdup(data_path);
+  w->seen = calloc(TRIGRAM_SPACE / 8, 1);
+  if (!w->path || !w->data_path || !w->seen) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  memcpy(w->path, data_path, n);
+  memcpy(w->path + n, SIDX_SUFFIX, sizeof(SIDX_SUFFIX));
+  w->start = start_offset;
+  w->offset = start_offset;
+
+  pthread_mutex_init(&w->mu, NULL);
+  pthread_cond_init(&w->cv_work, NULL);
+  pthread_cond_init(&w->cv_space, NULL);
+  int err = pthread_create(&w->thread, NULL, indexer_main, w);
+  if (err) {
+    fprintf(stderr, "sash: cannot start indexer for '%s': %s\n", data_path,
+            strerror(err));
+    free(w->seen);
+    free(w->data_path);
+    free(w->path);
+    free(w);
+    return NULL;
+  }
+  return w;
+}
+
+static void seal_block(SidxWriter *w) {
+  Block *b = w->cur;
+  w->cur = NULL;
+  if (!b)
+    return;
+
+  pthread_mutex_lock(&w->mu);
+  while (w->pending >= SIDX_MAX_PENDING)
+    pthread_cond_wait(&w->cv_space, &w->mu);
+  b->next = NULL;
+  if (w->tail)
+    w->tail->next = b;
+  else
+    w->head = b;
+  w->tail = b;
+  w->pending++;
+  pthread_cond_signal(&w->cv_work);
+  pthread_mutex_unlock(&w->mu);
+}
+
+/* Record a line that has just been written to the data file. */
+void sidx_append(SidxWriter *w, const char *line, size_t len) {
+  if (w->lost)
+    return;
+  if (w->cur && w->cur->len + len > w->cur->cap)
+    seal_block(w);
+
+  if (!w->cur) {
+    size_t cap = len > SIDX_BLOCK_SIZE ? len : SIDX_BLOCK_SIZE;
+    w->cur = malloc(sizeof(Block) + cap);
+    if (!w->cur) {
+      perror("sash: malloc");
+      exit(1);
+    }
+    w->cur->id = w->nblocks;
+    w->cur->len = 0;
+    w->cur->cap = cap;
+    if (w->nblocks == w->extents_cap) {
+      w->extents_cap = w->extents_cap ? w->extents_cap * 2 : 1024;
+      w->extents =
+          xrealloc(w->extents, w->extents_cap * 2 * sizeof(uint64_t));
+    }
+    w->extents[2 * w->nblocks++] = w->offset;
+  }
+
+  memcpy(w->cur->data + w->cur->len, line, len);
+  w->cur->len += len;
+  w->offset += len;
+  w->extents[2 * w->nblocks - 1] = w->offset;
+  if (w->cur->len >= SIDX_BLOCK_SIZE)
+    seal_block(w);
+}
+
+/*
+ * Record lines that have just been written at byte `at` of the data file,
+ * which other writers may have appended to since the last call.
+ */
+void sidx_append_at(SidxWriter *w, uint64_t at, const char *line,
+                    size_t len) {
+  if (at < w->offset) {
+    w->lost = true;
+  } else if (at > w->offset && !w->lost) {
+    /* someone else's bytes: end the block and skip over them */
+    seal_block(w);
+    if (w->ngaps == w->gaps_cap) {
+      w->gaps_cap = w->gaps_cap ? w->gaps_cap * 2 : 16;
+      w->gaps = xrealloc(w->gaps, w->gaps_cap * 2 * sizeof(uint64_t));
+    }
+    w->gaps[2 * w->ngaps] = w->offset;
+    w->gaps[2 * w->ngaps++ + 1] = at;
+    w->offset = at;
+  }
+  sidx_append(w, line, len);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+  for (int i = 0; i < 8; i++)
+    p[i] = (uint8_t)(v >> (8 * i));
+}
+
+/* Identity of the data file, so a search can tell it's still the same. */
+typedef struct {
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t mtime_ns;
+  uint64_t size;
+} Fingerprint;
+
+static Fingerprint fingerprint(const struct stat *sb) {
+#ifdef __APPLE__
+  uint64_t mtime_ns = (uint64_t)sb->st_mtimespec.tv_sec * 1000000000ULL +
+                      (uint64_t)sb->st_mtimespec.tv_nsec;
+#else
+  uint64_t mtime_ns = (uint64_t)sb->st_mtim.tv_sec * 1000000000ULL +
+                      (uint64_t)sb->st_mtim.tv_nsec;
+#endif
+  return (Fingerprint){(uint64_t)sb->st_dev, (uint64_t)sb->st_ino, mtime_ns,
+                       (uint64_t)sb->st_size};
+}
+
+static int cmp_posting(const void *a, const void *b) {
+  uint32_t x = ((const Posting *)a)->key;
+  uint32_t y = ((const Posting *)b)->key;
+  return (x > y) - (x < y);
+}
+
+static int write_index(SidxWriter *w, FILE *f) {
+  /* compact the table in place and sort by trigram */
+  size_t n = 0;
+  for (size_t i = 0; i < w->table_cap; i++) {
+    if (!w->table[i].key)
+      continue;
+    Posting p = w->table[i];
+    memset(&w->table[i], 0, sizeof(Posting));
+    w->table[n++] = p;
+  }
+  qsort(w->table, n, sizeof(Posting), cmp_posting);
+
+  /* the data file has been written out by now (the caller flushes it) */
+  struct stat sb;
+  if (stat(w->data_path, &sb) != 0)
+    return -1;
+  Fingerprint fp = fingerprint(&sb);
+
+  uint8_t hdr[SIDX_HEADER_SIZE];
+  memcpy(hdr, SIDX_MAGIC, 8);
+  put_u32(hdr + 8, SIDX_BLOCK_SIZE);
+  put_u32(hdr + 12, w->nblocks);
+  put_u32(hdr + 16, (uint32_t)n);
+  put_u32(hdr + 20, w->ngaps);
+  put_u64(hdr + 24, w->start);
+  put_u64(hdr + 32, w->offset);
+  put_u64(hdr + 40, fp.dev);
+  put_u64(hdr + 48, fp.ino);
+  put_u64(hdr + 56, fp.mtime_ns);
+  put_u64(hdr + 64, fp.size);
+  fwrite(hdr, 1, sizeof(hdr), f);
+
+  for (uint32_t i = 0; i < 2 * w->nblocks; i++) {
+    uint8_t b[8];
+    put_u64(b, w->extents[i]);
+    fwrite(b, 1, 8, f);
+  }
+  for (uint32_t i = 0; i < 2 * w->ngaps; i++) {
+    uint8_t b[8];
+    put_u64(b, w->gaps[i]);
+    fwrite(b, 1, 8, f);
+  }
+
+  uint64_t off = SIDX_HEADER_SIZE + (uint64_t)(w->nblocks + w->ngaps) * 16 +
+                 (uint64_t)n * SIDX_DIRENT_SIZE;
+  for (size_t i = 0; i < n; i++) {
+    uint8_t e[SIDX_DIRENT_SIZE];
+    put_u32(e, w->table[i].key - 1);
+    put_u32(e + 4, w->table[i].count);
+    put_u64(e + 8, off);
+    put_u32(e + 16, w->table[i].len);
+    fwrite(e, 1, sizeof(e), f);
+    off += w->table[i].len;
+  }
+
+  for (size_t i = 0; i < n; i++)
+    fwrite(w->table[i].data, 1, w->table[i].len, f);
+
+  return ferror(f) ? -1 : 0;
+}
+
+/*
+ * Finish indexing and write the sidecar (via a temporary file, so readers
+ * never see a partial index).  If the file was truncated while indexing,
+ * no sidecar is left at all.  Frees the writer.  Returns 0 on success.
+ */
+int sidx_close(SidxWriter *w) {
+  seal_block(w);
+  pthread_mutex_lock(&w->mu);
+  w->done = true;
+  pthread_cond_signal(&w->cv_work);
+  pthread_mutex_unlock(&w->mu);
+  pthread_join(w->thread, NULL);
+
+  size_t n = strlen(w->path);
+  char *tmp = malloc(n + 5);
+  if (!tmp) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  memcpy(tmp, w->path, n);
+  memcpy(tmp + n, ".tmp", 5);
+
+  int rc = -1;
+  FILE *f = NULL;
+  if (w->lost) {
+    unlink(w->path); /* an index of the old contents would mislead */
+    rc = 0;
+  } else if ((f = fopen(tmp, "wb")) != NULL) {
+    rc = write_index(w, f);
+    if (fclose(f) != 0)
+      rc = -1;
+    if (rc == 0 && rename(tmp, w->path) != 0)
+      rc = -1;
+  }
+  if (rc != 0) {
+    fprintf(stderr, "sash: cannot write index '%s': %s\n", w->path,
+            strerror(errno));
+    unlink(tmp);
+  }
+  free(tmp);
+
+  for (size_t i = 0; i < w->table_cap; i++)
+    free(w->table[i].data);
+  free(w->table);
+  free(w->tris);
+  free(w->seen);
+  free(w->extents);
+  free(w->gaps);
+  free(w->path);
+  free(w->data_path);
+  pthread_mutex_destroy(&w->mu);
+  pthread_cond_destroy(&w->cv_work);
+  pthread_cond_destroy(&w->cv_space);
+  free(w);
+  return rc;
+}
+
+/* ── Search ──────────────────────────────────────────────────────── */
+
+typedef struct {
+  int fd;
+  uint32_t nblocks;
+  uint32_t ntris;
+  uint32_t ngaps;
+  uint64_t start;
+  uint64_t end;
+  SidxStats *st;
+} Index;
+
+static uint32_t get_u32(const uint8_t *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+  return (uint64_t)get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+static bool read_at(Index *ix, int fd, void *buf, size_t len, uint64_t off) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = pread(fd, (char *)buf + done, len - done, (off_t)(off + done));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    done += (size_t)n;
+  }
+  ix->st->bytes_read += len;
+  return true;
+}
+
+static bool index_load(Index *ix, const char *data_path,
+                       const struct stat *data) {
+  size_t n = strlen(data_path);
+  char *path = malloc(n + sizeof(SIDX_SUFFIX));
+  if (!path)
+    return false;
+  memcpy(path, data_path, n);
+  memcpy(path + n, SIDX_SUFFIX, sizeof(SIDX_SUFFIX));
+  ix->fd = open(path, O_RDONLY | O_CLOEXEC);
+  free(path);
+  if (ix->fd < 0)
+    return false;
+
+  uint8_t hdr[SIDX_HEADER_SIZE];
+  if (!read_at(ix, ix->fd, hdr, sizeof(hdr), 0) ||
+      memcmp(hdr, SIDX_MAGIC, 8) != 0)
+    goto stale;
+  ix->nblocks = get_u32(hdr + 12);
+  ix->ntris = get_u32(hdr + 16);
+  ix->ngaps = get_u32(hdr + 20);
+  ix->start = get_u64(hdr + 24);
+  ix->end = get_u64(hdr + 32);
+  Fingerprint fp = fingerprint(data);
+  /* rewritten, replaced or appended to since the index was written */
+  if (get_u64(hdr + 40) != fp.dev || get_u64(hdr + 48) != fp.ino ||
+      get_u64(hdr + 56) != fp.mtime_ns || get_u64(hdr + 64) != fp.size)
+    goto stale;
+  if (ix->start > ix->end || ix->end > fp.size)
+    goto stale;
+  return true;
+
+stale:
+  close(ix->fd);
+  ix->fd = -1;
+  return false;
+}
+
+/* Binary-search the directory.  Returns false if the trigram is absent. */
+static bool index_lookup(Index *ix, uint32_t tri, uint32_t *count,
+                         uint64_t *off, uint32_t *len) {
+  uint64_t dir =
+      SIDX_HEADER_SIZE + (uint64_t)(ix->nblocks + ix->ngaps) * 16;
+  uint32_t lo = 0, hi = ix->ntris;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    uint8_t e[SIDX_DIRENT_SIZE];
+    if (!read_at(ix, ix->fd, e, sizeof(e), dir + (uint64_t)mid * sizeof(e)))
+      return false;
+    uint32_t key = get_u32(e);
+    if (key == tri) {
+      *count = get_u32(e + 4);
+      *off = get_u64(e + 8);
+      *len = get_u32(e + 16);
+      return true;
+    }
+    if (key < tri)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return false;
+}
+
+/* Decode a posting list; returns the number of block ids written. */
+static uint32_t decode_posting(const uint8_t *p, uint32_t len, uint32_t *out) {
+  uint32_t n = 0, prev = 0, v = 0;
+  int shift = 0;
+  for (uint32_t i = 0; i < len; i++) {
+    v |= (uint32_t)(p[i] & 0x7f) << shift;
+    shift += 7;
+    if (!(p[i] & 0x80)) {
+      prev = n ? prev + v : v;
+      out[n++] = prev;
+      v = 0;
+      shift = 0;
+    }
+  }
+  return n;
+}
+
+/*
+ * Candidate blocks for a literal of 3+ bytes: the intersection of the
+ * postings of all its trigrams, smallest list first.  Returns the count,
+ * with the ids in *out (caller frees).
+ */
+static uint32_t candidates(Index *ix, const char *pat, size_t plen,
+                           uint32_t **out) {
+  *out = NULL;
+  size_t ntri = plen - 2;
+  uint32_t *counts = malloc(ntri * sizeof(uint32_t));
+  uint64_t *offs = malloc(ntri * sizeof(uint64_t));
+  uint32_t *lens = malloc(ntri * sizeof(uint32_t));
+  if (!counts || !offs || !lens) {
+    perror("sash: malloc");
+    exit(1);
+  }
+
+  uint32_t n = 0;
+  size_t best = 0;
+  const unsigned char *s = (const unsigned char *)pat;
+  for (size_t i = 0; i < ntri; i++) {
+    uint32_t tri = (uint32_t)s[i] << 16 | (uint32_t)s[i + 1] << 8 | s[i + 2];
+    if (!index_lookup(ix, tri, &counts[i], &offs[i], &lens[i]))
+      goto done; /* a trigram that never occurs: no candidates */
+    if (counts[i] < counts[best])
+      best = i;
+  }
+
+  uint32_t *list = malloc(((size_t)counts[best] + 1) * sizeof(uint32_t));
+  uint8_t *raw = malloc((size_t)lens[best] + 1);
+  if (!list || !raw) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  if (!read_at(ix, ix->fd, raw, lens[best], offs[best])) {
+    free(raw);
+    free(list);
+    goto done;
+  }
+  n = decode_posting(raw, lens[best], list);
+  free(raw);
+
+  for (size_t i = 0; i < ntri && n > 0; i++) {
+    if (i == best || (lens[i] == lens[best] && offs[i] == offs[best]))
+      continue;
+    uint32_t *other = malloc(((size_t)counts[i] + 1) * sizeof(uint32_t));
+    raw = malloc((size_t)lens[i] + 1);
+    if (!other || !raw) {
+      perror("sash: malloc");
+      exit(1);
+    }
+    uint32_t m = 0;
+    if (read_at(ix, ix->fd, raw, lens[i], offs[i]))
+      m = decode_posting(raw, lens[i], other);
+    free(raw);
+
+    uint32_t k = 0;
+    for (uint32_t a = 0, b = 0; a < n && b < m;) {
+      if (list[a] == other[b]) {
+        list[k++] = list[a];
+        a++;
+        b++;
+      } else if (list[a] < other[b]) {
+        a++;
+      } else {
+        b++;
+      }
+    }
+    n = k;
+    free(other);
+  }
+  *out = list;
+
+done:
+  free(counts);
+  free(offs);
+  free(lens);
+  return n;
+}
+
+/* Print the lines of [from, to) that contain the pattern. */
+static void scan_range(Index *ix, int fd, uint64_t from, uint64_t to,
+                       const char *pat, size_t plen, FILE *out) {
+  size_t cap = 1 << 20;
+  char *buf = malloc(cap);
+  if (!buf) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  size_t carry = 0;
+  uint64_t pos = from;
+
+  while (pos < to || carry > 0) {
+    size_t want = cap - carry;
+    if (want > to - pos)
+      want = (size_t)(to - pos);
+    if (want > 0 && !read_at(ix, fd, buf + carry, want, pos))
+      break;
+    pos += want;
+    size_t len = carry + want;
+    bool last = pos >= to;
+
+    size_t start = 0;
+    for (;;) {
+      char *nl = memchr(buf + start, '\n', len - start);
+      size_t end;
+      if (nl)
+        end = (size_t)(nl - buf) + 1;
+      else if (last && start < len)
+        end = len;
+      else
+        break;
+      if (plen == 0 || memmem(buf + start, end - start, pat, plen)) {
+        fwrite(buf + start, 1, end - start, out);
+        ix->st->matches++;
+      }
+      start = end;
+    }
+
+    carry = len - start;
+    if (last)
+      break;
+    if (carry == cap) {
+      cap *= 2;
+      char *grown = realloc(buf, cap);
+      if (!grown) {
+        perror("sash: realloc");
+        exit(1);
+      }
+      buf = grown;
+    } else if (start > 0) {
+      memmove(buf, buf + start, carry);
+    }
+  }
+  free(buf);
+}
+
+/*
+ * Scan the gaps from number `gap` on that start before `before`, in file
+ * order.  Returns the first gap left unscanned.
+ */
+static uint32_t scan_gaps(Index *ix, int fd, uint32_t gap, uint64_t before,
+                          const char *pat, size_t plen, FILE *out) {
+  uint64_t at = SIDX_HEADER_SIZE + (uint64_t)ix->nblocks * 16;
+  for (; gap < ix->ngaps; gap++) {
+    uint8_t raw[16];
+    if (!read_at(ix, ix->fd, raw, 16, at + (uint64_t)gap * 16))
+      return ix->ngaps;
+    if (get_u64(raw) >= before)
+      break;
+    scan_range(ix, fd, get_u64(raw), get_u64(raw + 8), pat, plen, out);
+  }
+  return gap;
+}
+
+/*
+ * Print every line of data_path containing the literal pattern.  With an
+ * up-to-date sidecar only candidate blocks (plus any unindexed head of
+ * the file, from before an append, and other writers' bytes in between)
+ * are read; otherwise the whole file is scanned.
+ * Returns 0 if a line matched, 1 if none did, 2 on error (grep's codes).
+ */
+int sidx_grep(const char *data_path, const char *pattern, FILE *out,
+              SidxStats *st) {
+  memset(st, 0, sizeof(*st));
+  int fd = open(data_path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    fprintf(stderr, "sash: %s: %s\n", data_path, strerror(errno));
+    return 2;
+  }
+  struct stat sb;
+  if (fstat(fd, &sb) != 0) {
+    fprintf(stderr, "sash: %s: %s\n", data_path, strerror(errno));
+    close(fd);
+    return 2;
+  }
+  st->file_bytes = (uint64_t)sb.st_size;
+
+  size_t plen = strlen(pattern);
+  Index ix = {.fd = -1, .st = st};
+  if (plen < 3 || !index_load(&ix, data_path, &sb)) {
+    scan_range(&ix, fd, 0, st->file_bytes, pattern, plen, out);
+  } else {
+    st->blocks = ix.nblocks;
+    uint32_t *ids;
+    uint32_t n = candidates(&ix, pattern, plen, &ids);
+
+    scan_range(&ix, fd, 0, ix.start, pattern, plen, out);
+    uint32_t gap = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t b = ids[i];
+      if (b >= ix.nblocks)
+        continue;
+      uint8_t raw[16];
+      if (!read_at(&ix, ix.fd, raw, 16, SIDX_HEADER_SIZE + (uint64_t)b * 16))
+        break;
+      uint64_t lo = get_u64(raw);
+      gap = scan_gaps(&ix, fd, gap, lo, pattern, plen, out);
+      st->blocks_read++;
+      scan_range(&ix, fd, lo, get_u64(raw + 8), pattern, plen, out);
+    }
+    scan_gaps(&ix, fd, gap, UINT64_MAX, pattern, plen, out);
+    scan_range(&ix, fd, ix.end, st->file_bytes, pattern, plen, out);
+    free(ids);
+  }
+
+  if (ix.fd >= 0)
+    close(ix.fd);
+  close(fd);
+  return st->matches > 0 ? 0 : 1;
+}
@@ -0,0 +1,36 @@
+/*
+ * sidx.h - Trigram search index sidecar for output files
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef SIDX_H
+#define SIDX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SIDX_SUFFIX ".sidx"
+#define SIDX_BLOCK_SIZE 65536
+
+typedef struct SidxWriter SidxWriter;
+
+typedef struct {
+  uint64_t file_bytes;   /* size of the searched file */
+  uint64_t bytes_read;   /* data + index bytes actually read */
+  uint32_t blocks;       /* indexed blocks in the file */
+  uint32_t blocks_read;  /* candidate blocks scanned */
+  uint64_t matches;
+} SidxStats;
+
+SidxWriter *sidx_open(const char *data_path, uint64_t start_offset);
+void sidx_append(SidxWriter *w, const char *line, size_t len);
+void sidx_append_at(SidxWriter *w, uint64_t at, const char *line,
+                    size_t len);
+int sidx_close(SidxWriter *w);
+
+int sidx_grep(const char *data_path, const char *pattern, FILE *out,
+              SidxStats *st);
+
+#endif /* SIDX_H */
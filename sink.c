@@ -0,0 +1,572 @@
+/*
+ * sink.c - Output files
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Files opened with -W may be shared with other writers (several jobs
+ * appending to one log), so they bypass stdio: whole lines are batched up
+ * to APPEND_BATCH bytes and each batch goes out in a single write() on the
+ * O_APPEND fd.  Every write then lands at the end of the file in one
+ * piece, and lines from different writers never interleave.  The offset
+ * each write landed at goes to the file's search index, which skips over
+ * the other writers' lines in between.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jsonl.h"
+#include "sash.h"
+#include "sink.h"
+#include "timer.h"
+
+/* While a limited file is dropping lines, a marker summarising the drops
+   is written at most this often (and before the next line that passes). */
+#define DROP_REPORT_NS (1 * NS_PER_SEC)
+
+/* Largest write() for -W files: a page, which local filesystems append
+   in one piece.  Longer lines are split into lines of this size. */
+#define APPEND_BATCH 4096
+
+static Sink *g_sinks = NULL;
+static int g_nsinks = 0;
+
+/* limits for files added from now on (0 = unlimited) */
+static double g_byte_rate = 0;
+static double g_line_rate = 0;
+static Timer g_drop_timer;
+static bool g_drop_timer_ready = false;
+
+/* JSONL records: the "stream" value (escaped once) and the record for the
+   line being written, built on first use and shared by every JSONL file */
+static char *g_stream_json = NULL;
+static char *g_record = NULL;
+static size_t g_record_cap = 0;
+static size_t g_record_len = 0;
+
+/* --file-plugin stages waiting for the next output file */
+static Pipeline *g_next_plugins = NULL;
+
+/* While a batch is written, sink_write() is called once per line in
+   order: g_batch_pos is the line's index in each file's slices. */
+static bool g_in_batch = false;
+static size_t g_batch_pos = 0;
+
+/* fds of the files a replaced sash process had open, in -w/-W order */
+static int *g_inherited = NULL;
+static int g_ninherited = 0;
+static int g_next_inherited = 0;
+
+static void report_drops(void *arg);
+
+/* Rate limits apply to the output files named after them. */
+void sink_set_limits(double bytes_per_sec, double lines_per_sec) {
+  g_byte_rate = bytes_per_sec;
+  g_line_rate = lines_per_sec;
+  if (!g_drop_timer_ready && (g_byte_rate > 0 || g_line_rate > 0)) {
+    timer_init(&g_drop_timer, report_drops, NULL, 100 * NS_PER_MS);
+    g_drop_timer_ready = true;
+  }
+}
+
+/* Remove FILE.sidx: the file no longer matches what it indexed. */
+static void remove_index(const char *path) {
+  size_t n = strlen(path);
+  char *idx = malloc(n + sizeof(SIDX_SUFFIX));
+  if (!idx) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  memcpy(idx, path, n);
+  memcpy(idx + n, SIDX_SUFFIX, sizeof(SIDX_SUFFIX));
+  remove(idx);
+  free(idx);
+}
+
+void sink_add(const char *path, const char *mode) {
+  g_sinks = realloc(g_sinks, (size_t)(g_nsinks + 1) * sizeof(Sink));
+  if (!g_sinks) {
+    perror("sash: realloc");
+    exit(1);
+  }
+  Sink *s = &g_sinks[g_nsinks];
+  memset(s, 0, sizeof(*s));
+  s->path = strdup(path);
+  if (!s->path) {
+    perror("sash: strdup");
+    exit(1);
+  }
+  s->plugins = g_next_plugins;
+  g_next_plugins = NULL;
+  uint64_t now = now_ns();
+  bucket_init(&s->byte_limit, g_byte_rate, now);
+  bucket_init(&s->line_limit, g_line_rate, now);
+  if (g_next_inherited < g_ninherited) {
+    /* carry on where the replaced process was; "w" doesn't truncate here */
+    int fd = g_inherited[g_next_inherited++];
+    s->fp = fd >= 0 ? fdopen(fd, mode) : NULL;
+    if (!s->fp && fd < 0)
+      errno = EBADF;
+  } else {
+    s->fp = fopen(path, mode);
+    if (s->fp && mode[0] == 'w')
+      remove_index(path); /* rewritten from scratch; --index-search redoes it */
+  }
+  if (!s->fp) {
+    fprintf(stderr, "sash: cannot open '%s': %s\n", path, strerror(errno));
+    /* non-fatal: keep the slot, skip during writes */
+  } else if (mode[0] == 'a') {
+    setvbuf(s->fp, NULL, _IONBF, 0); /* writes go through the batch */
+    s->atomic = true;
+    s->batch = malloc(APPEND_BATCH);
+    if (!s->batch) {
+      perror("sash: malloc");
+      exit(1);
+    }
+  }
+  g_nsinks++;
+}
+
+void sink_add_jsonl(const char *path) {
+  sink_add(path, "w");
+  g_sinks[g_nsinks - 1].jsonl = true;
+}
+
+/* Where lines come from: "stdin", "command" or "file:PATH". */
+void sink_set_source(const char *stream) {
+  size_t n = strlen(stream);
+  free(g_stream_json);
+  g_stream_json = malloc(JSON_ESCAPE_MAX(n) + 1);
+  if (!g_stream_json) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  g_stream_json[json_escape(g_stream_json, stream, n)] = '\0';
+}
+
+/* Build a search index alongside every open output file. */
+void sink_enable_index(void) {
+  for (int i = 0; i < g_nsinks; i++) {
+    Sink *s = &g_sinks[i];
+    if (!s->fp || s->index)
+      continue;
+    /* appended files are indexed from their current end */
+    struct stat sb;
+    uint64_t start = 0;
+    if (fstat(fileno(s->fp), &sb) == 0)
+      start = (uint64_t)sb.st_size;
+    s->index = sidx_open(s->path, start);
+  }
+}
+
+int sink_count(void) { return g_nsinks; }
+
+/* Load a plugin stage for the output file named next. */
+bool sink_add_plugin(const char *spec) {
+  if (!g_next_plugins) {
+    g_next_plugins = calloc(1, sizeof(Pipeline));
+    if (!g_next_plugins) {
+      perror("sash: calloc");
+      exit(1);
+    }
+  }
+  return pipeline_load(g_next_plugins, spec);
+}
+
+bool sink_has_plugins(void) {
+  for (int i = 0; i < g_nsinks; i++)
+    if (g_sinks[i].plugins)
+      return true;
+  return false;
+}
+
+/*
+ * The next n calls to sink_write() are these lines: run each file's
+ * plugins over them now, in one batch.
+ */
+void sink_begin_batch(const sash_line *lines, size_t n) {
+  for (int i = 0; i < g_nsinks; i++) {
+    Sink *s = &g_sinks[i];
+    if (!s->plugins || !s->fp)
+      continue;
+    if (n > s->slices_cap) {
+      s->slices_cap = n * 2;
+      s->slices = realloc(s->slices, s->slices_cap * sizeof(sash_line));
+      if (!s->slices) {
+        perror("sash: realloc");
+        exit(1);
+      }
+    }
+    memcpy(s->slices, lines, n * sizeof(sash_line));
+    pipeline_run(s->plugins, s->slices, n);
+  }
+  g_in_batch = true;
+  g_batch_pos = 0;
+}
+
+void sink_end_batch(void) {
+  for (int i = 0; i < g_nsinks; i++)
+    if (g_sinks[i].plugins)
+      pipeline_reset(g_sinks[i].plugins);
+  g_in_batch = false;
+}
+
+static void sink_fail(Sink *s) {
+  fprintf(stderr, "sash: write error on '%s': %s\n", s->path, strerror(errno));
+  fclose(s->fp);
+  s->fp = NULL;
+  if (s->index) {
+    /* the file no longer matches what was indexed: drop the sidecar */
+    sidx_close(s->index);
+    s->index = NULL;
+    remove_index(s->path);
+  }
+}
+
+/* One write() for an atomic file; a short one would split a line. */
+static bool write_once(Sink *s, const char *buf, size_t len) {
+  ssize_t n;
+  while ((n = write(fileno(s->fp), buf, len)) < 0 && errno == EINTR)
+    ;
+  if (n < 0)
+    return false;
+  if ((size_t)n < len) {
+    errno = ENOSPC;
+    return false;
+  }
+  if (s->index) {
+    /* where it landed: other writers' lines may have come in between */
+    off_t end = lseek(fileno(s->fp), 0, SEEK_CUR);
+    if (end >= (off_t)len)
+      sidx_append_at(s->index, (uint64_t)end - len, buf, len);
+    else
+      sidx_append(s->index, buf, len);
+  }
+  return true;
+}
+
+static bool batch_flush(Sink *s) {
+  if (s->batch_len == 0)
+    return true;
+  size_t len = s->batch_len;
+  s->batch_len = 0;
+  return write_once(s, s->batch, len);
+}
+
+/*
+ * Add a line to the batch, writing the batch out first if the line doesn't
+ * fit.  A line without a newline (the end of the stream) gets one, so the
+ * next writer's line doesn't run on from it.  A line longer than a batch
+ * is written as several lines of at most APPEND_BATCH bytes, split on a
+ * UTF-8 character boundary.
+ */
+static bool batch_put(Sink *s, const char *buf, size_t len) {
+  bool newline = len > 0 && buf[len - 1] == '\n';
+  if (newline)
+    len--;
+
+  if (len + 1 <= APPEND_BATCH) {
+    if (s->batch_len + len + 1 > APPEND_BATCH && !batch_flush(s))
+      return false;
+    memcpy(s->batch + s->batch_len, buf, len);
+    s->batch_len += len;
+    s->batch[s->batch_len++] = '\n';
+    return true;
+  }
+
+  if (!batch_flush(s))
+    return false;
+  while (len > 0) {
+    size_t n = len < APPEND_BATCH - 1 ? len : APPEND_BATCH - 1;
+    if (n < len) {
+      size_t k = n;
+      while (k > n - 4 && ((unsigned char)buf[k] & 0xc0) == 0x80)
+        k--;
+      if (((unsigned char)buf[k] & 0xc0) != 0x80)
+        n = k;
+    }
+    memcpy(s->batch, buf, n);
+    s->batch[n] = '\n';
+    if (!write_once(s, s->batch, n + 1))
+      return false;
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool sink_put(Sink *s, const char *buf, size_t len) {
+  bool ok;
+  if (s->atomic) {
+    ok = batch_put(s, buf, len);
+  } else {
+    ok = fwrite(buf, 1, len, s->fp) == len;
+    if (ok && s->index)
+      sidx_append(s->index, buf, len);
+  }
+  if (!ok)
+    sink_fail(s);
+  return ok;
+}
+
+static void sink_flush(Sink *s) {
+  if (s->atomic) {
+    if (!batch_flush(s))
+      sink_fail(s);
+  } else {
+    fflush(s->fp);
+  }
+}
+
+/* Format n with thousands separators ("12,345"). */
+static void format_count(char *out, size_t cap, uint64_t n) {
+  char digits[32];
+  int nd = snprintf(digits, sizeof(digits), "%llu", (unsigned long long)n);
+  size_t o = 0;
+  for (int i = 0; i < nd && o + 2 < cap; i++) {
+    if (i > 0 && (nd - i) % 3 == 0)
+      out[o++] = ',';
+    out[o++] = digits[i];
+  }
+  out[o] = '\0';
+}
+
+static void write_drop_marker(Sink *s) {
+  char count[48], line[96];
+  int n;
+  if (s->jsonl) {
+    n = snprintf(line, sizeof(line), "{\"dropped\":%llu}\n",
+                 (unsigned long long)s->unreported);
+  } else {
+    format_count(count, sizeof(count), s->unreported);
+    n = snprintf(line, sizeof(line), "\xe2\x80\xa6 %s line%s dropped\n", count,
+                 s->unreported == 1 ? "" : "s");
+  }
+  s->unreported = 0;
+  if (n > 0)
+    sink_put(s, line, (size_t)n);
+}
+
+static void report_drops(void *arg) {
+  (void)arg;
+  for (int i = 0; i < g_nsinks; i++) {
+    Sink *s = &g_sinks[i];
+    if (s->fp && s->unreported > 0)
+      write_drop_marker(s);
+  }
+}
+
+/* Whether a rate-limited file has budget for this line right now. */
+static bool sink_admit(Sink *s, size_t len, uint64_t *now) {
+  if (s->line_limit.rate <= 0 && s->byte_limit.rate <= 0)
+    return true;
+  if (!*now)
+    *now = now_ns();
+  if (!bucket_take(&s->line_limit, 1, *now))
+    return false;
+  if (!bucket_take(&s->byte_limit, (double)len, *now)) {
+    s->line_limit.tokens += 1; /* refund: the line isn't written */
+    return false;
+  }
+  return true;
+}
+
+/* Append n in decimal, zero-padded to at least width digits. */
+static size_t put_uint(char *out, uint64_t n, int width) {
+  char tmp[24];
+  int k = 0;
+  do {
+    tmp[k++] = (char)('0' + n % 10);
+    n /= 10;
+  } while (n > 0 || k < width);
+  for (int i = 0; i < k; i++)
+    out[i] = tmp[k - 1 - i];
+  return (size_t)k;
+}
+
+static size_t put_str(char *out, const char *s, size_t n) {
+  memcpy(out, s, n);
+  return n;
+}
+
+/*
+ * The JSONL record for a line: sequence number, arrival time (Unix seconds
+ * to the microsecond), stream and text without the trailing newline.
+ * Assembled by hand: snprintf would cost more than escaping the text.
+ */
+static void build_record(const char *buf, size_t len) {
+  if (len > 0 && buf[len - 1] == '\n')
+    len--;
+  const char *stream = g_stream_json ? g_stream_json : "stdin";
+  size_t stream_len = strlen(stream);
+  size_t need = 96 + stream_len + JSON_ESCAPE_MAX(len);
+  if (need > g_record_cap) {
+    g_record_cap = need * 2;
+    g_record = realloc(g_record, g_record_cap);
+    if (!g_record) {
+      perror("sash: realloc");
+      exit(1);
+    }
+  }
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  char *p = g_record;
+  size_t o = put_str(p, "{\"seq\":", 7);
+  o += put_uint(p + o, g_total_lines, 1);
+  o += put_str(p + o, ",\"ts\":", 6);
+  o += put_uint(p + o, (uint64_t)ts.tv_sec, 1);
+  p[o++] = '.';
+  o += put_uint(p + o, (uint64_t)ts.tv_nsec / 1000, 6);
+  o += put_str(p + o, ",\"stream\":\"", 11);
+  o += put_str(p + o, stream, stream_len);
+  o += put_str(p + o, "\",\"text\":\"", 10);
+  o += json_escape(p + o, buf, len);
+  o += put_str(p + o, "\"}\n", 3);
+  g_record_len = o;
+}
+
+void sink_write(const char *buf, size_t len, bool flush) {
+  uint64_t now = 0;
+  bool have_record = false;
+  size_t pos = g_batch_pos++;
+  for (int i = 0; i < g_nsinks; i++) {
+    Sink *s = &g_sinks[i];
+    if (!s->fp)
+      continue;
+
+    const char *out = buf;
+    size_t out_len = len;
+    if (s->plugins && g_in_batch) {
+      const sash_line *l = &s->slices[pos];
+      if (l->flags & SASH_LINE_DROP)
+        continue;
+      out = l->ptr;
+      out_len = l->len;
+    }
+    if (s->jsonl) {
+      if (out != buf) {
+        build_record(out, out_len); /* this file's own version */
+        have_record = false;
+      } else if (!have_record) {
+        build_record(buf, len);
+        have_record = true;
+      }
+      out = g_record;
+      out_len = g_record_len;
+    }
+
+    if (!sink_admit(s, out_len, &now)) {
+      s->dropped_lines++;
+      s->dropped_bytes += out_len;
+      g_stats.dropped_lines++;
+      if (s->unreported++ == 0 && !timer_armed(&g_drop_timer))
+        timer_arm(&g_drop_timer, now + DROP_REPORT_NS);
+      continue;
+    }
+
+    if (s->unreported > 0)
+      write_drop_marker(s);
+    if (!s->fp || !sink_put(s, out, out_len))
+      continue;
+    if (flush)
+      sink_flush(s);
+  }
+}
+
+void sink_flush_all(void) {
+  for (int i = 0; i < g_nsinks; i++) {
+    if (g_sinks[i].fp)
+      sink_flush(&g_sinks[i]);
+  }
+}
+
+/*
+ * Before a re-exec: write everything out, finish the indexes and store
+ * each file's fd (-1 once closed) in fds, which holds sink_count().
+ * sink_enable_index() restarts the indexes if the exec fails.
+ */
+void sink_prepare_upgrade(int *fds) {
+  for (int i = 0; i < g_nsinks; i++) {
+    Sink *s = &g_sinks[i];
+    if (s->fp && s->unreported > 0)
+      write_drop_marker(s);
+    if (s->fp)
+      sink_flush(s);
+    if (s->index) {
+      sidx_close(s->index);
+      s->index = NULL;
+    }
+    fds[i] = s->fp ? fileno(s->fp) : -1;
+  }
+}
+
+/* In the new process: the files sink_add() adopts instead of opening. */
+void sink_inherit(const int *fds, int n) {
+  g_inherited = malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+  if (!g_inherited) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  memcpy(g_inherited, fds, (size_t)n * sizeof(int));
+  g_ninherited = n;
+  g_next_inherited = 0;
+}
+
+void sink_print_stats(FILE *out) {
+  for (int i = 0; i < g_nsinks; i++) {
+    Sink *s = &g_sinks[i];
+    if (s->dropped_lines > 0)
+      fprintf(out, "sash: %s: %llu lines (%llu bytes) dropped by rate limit\n",
+              s->path, (unsigned long long)s->dropped_lines,
+              (unsigned long long)s->dropped_bytes);
+  }
+}
+
+void sink_close_all(void) {
+  for (int i = 0; i < g_nsinks; i++) {
+    Sink *s = &g_sinks[i];
+    if (s->fp && s->unreported > 0)
+      write_drop_marker(s);
+    if (s->fp)
+      sink_flush(s);
+    if (s->fp)
+      fclose(s->fp);
+    free(s->batch);
+    if (s->index)
+      sidx_close(s->index);
+    if (s->plugins) {
+      pipeline_free(s->plugins);
+      free(s->plugins);
+    }
+    free(s->slices);
+    free(s->path);
+  }
+  if (g_next_plugins) {
+    pipeline_free(g_next_plugins);
+    free(g_next_plugins);
+    g_next_plugins = NULL;
+  }
+  free(g_sinks);
+  g_sinks = NULL;
+  g_nsinks = 0;
+  free(g_record);
+  g_record = NULL;
+  g_record_cap = 0;
+  free(g_stream_json);
+  g_stream_json = NULL;
+  free(g_inherited);
+  g_inherited = NULL;
+  g_ninherited = g_next_inherited = 0;
+}
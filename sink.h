@@ -0,0 +1,54 @@
+/*
+ * sink.h - Output files
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef SINK_H
+#define SINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "plugin.h"
+#include "ratelimit.h"
+#include "sidx.h"
+
+typedef struct {
+  char *path;
+  FILE *fp; /* NULL once closed after an error */
+  bool jsonl;  /* one JSON object per line instead of the raw text */
+  bool atomic; /* -W: whole lines per write(), batched in `batch` */
+  char *batch;
+  size_t batch_len;
+  SidxWriter *index;
+  Pipeline *plugins; /* --file-plugin stages, or NULL */
+  sash_line *slices; /* the batch being written, as they left it */
+  size_t slices_cap;
+  TokenBucket byte_limit;
+  TokenBucket line_limit;
+  uint64_t dropped_lines;
+  uint64_t dropped_bytes;
+  uint64_t unreported; /* drops not yet covered by a marker line */
+} Sink;
+
+void sink_set_limits(double bytes_per_sec, double lines_per_sec);
+void sink_add(const char *path, const char *mode);
+void sink_add_jsonl(const char *path);
+void sink_set_source(const char *stream);
+void sink_enable_index(void);
+bool sink_add_plugin(const char *spec);
+bool sink_has_plugins(void);
+void sink_begin_batch(const sash_line *lines, size_t n);
+void sink_end_batch(void);
+int sink_count(void);
+void sink_prepare_upgrade(int *fds);
+void sink_inherit(const int *fds, int n);
+void sink_write(const char *buf, size_t len, bool flush);
+void sink_flush_all(void);
+void sink_print_stats(FILE *out);
+void sink_close_all(void);
+
+#endif /* SINK_H */
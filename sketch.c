@@ -0,0 +1,135 @@
+/*
+ * sketch.c - Fixed-size streaming sketches (DDSketch, HyperLogLog)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * DDSketch keeps a count per logarithmic bucket: bucket i holds values in
+ * (gamma^(i-1), gamma^i] with gamma = (1+a)/(1-a), so any quantile is
+ * reported within a relative error a of a value actually seen.  Sketches
+ * merge by adding counts, which is how windows over time are built.
+ *
+ * HyperLogLog hashes each item and keeps, per register, the longest run
+ * of leading zeros seen; the harmonic mean of 2^register estimates the
+ * number of distinct items.  Both use fixed memory and O(1) work per add.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include "sketch.h"
+
+/* ── DDSketch ────────────────────────────────────────────────────── */
+
+static double g_log_gamma = 0;
+
+static double log_gamma(void) {
+  if (g_log_gamma == 0)
+    g_log_gamma = log((1 + DDS_ALPHA) / (1 - DDS_ALPHA));
+  return g_log_gamma;
+}
+
+void dds_clear(DDSketch *s) { memset(s, 0, sizeof(*s)); }
+
+void dds_add(DDSketch *s, double v) {
+  if (s->n == 0 || v > s->max)
+    s->max = v;
+  s->n++;
+  if (!(v > 0)) {
+    s->zero++;
+    return;
+  }
+  int i = (int)ceil(log(v) / log_gamma()) + DDS_OFFSET;
+  if (i < 0)
+    i = 0;
+  else if (i >= DDS_BUCKETS)
+    i = DDS_BUCKETS - 1;
+  s->counts[i]++;
+}
+
+void dds_merge(DDSketch *into, const DDSketch *from) {
+  if (from->n == 0)
+    return;
+  if (into->n == 0 || from->max > into->max)
+    into->max = from->max;
+  into->n += from->n;
+  into->zero += from->zero;
+  for (int i = 0; i < DDS_BUCKETS; i++)
+    into->counts[i] += from->counts[i];
+}
+
+/* Estimate of the q-quantile (0..1); the maximum is exact. */
+double dds_quantile(const DDSketch *s, double q) {
+  if (s->n == 0)
+    return 0;
+  if (q >= 1)
+    return s->max;
+  uint64_t rank = (uint64_t)(q * (double)(s->n - 1));
+  uint64_t seen = s->zero;
+  if (rank < seen)
+    return 0;
+  for (int i = 0; i < DDS_BUCKETS; i++) {
+    seen += s->counts[i];
+    if (rank < seen) {
+      /* the bucket's midpoint is within a of anything in it */
+      double v = 2 * exp((i - DDS_OFFSET) * log_gamma()) /
+                 (1 + (1 + DDS_ALPHA) / (1 - DDS_ALPHA));
+      return v < s->max ? v : s->max;
+    }
+  }
+  return s->max;
+}
+
+/* ── HyperLogLog ─────────────────────────────────────────────────── */
+
+/* FNV-1a, then a 64-bit finaliser to spread the bits. */
+static uint64_t hash64(const void *data, size_t len) {
+  const unsigned char *p = data;
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= 0x100000001b3ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+void hll_clear(HyperLogLog *h) { memset(h, 0, sizeof(*h)); }
+
+void hll_add(HyperLogLog *h, const void *data, size_t len) {
+  uint64_t x = hash64(data, len);
+  uint32_t idx = (uint32_t)(x >> (64 - HLL_P));
+  uint64_t rest = x << HLL_P;
+  uint8_t rank = 1;
+  while (rank <= 64 - HLL_P && !(rest & (1ULL << 63))) {
+    rank++;
+    rest <<= 1;
+  }
+  if (rank > h->reg[idx])
+    h->reg[idx] = rank;
+}
+
+double hll_estimate(const HyperLogLog *h) {
+  double m = HLL_M;
+  double sum = 0;
+  unsigned zeros = 0;
+  for (unsigned i = 0; i < HLL_M; i++) {
+    sum += ldexp(1.0, -h->reg[i]);
+    if (h->reg[i] == 0)
+      zeros++;
+  }
+  double est = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+  /* small cardinalities: linear counting is far more accurate */
+  if (est <= 2.5 * m && zeros > 0)
+    est = m * log(m / zeros);
+  return est;
+}
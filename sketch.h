@@ -0,0 +1,42 @@
+/*
+ * sketch.h - Fixed-size streaming sketches (DDSketch, HyperLogLog)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* 1% relative error; buckets cover about 1e-6 .. 6e11 */
+#define DDS_ALPHA 0.01
+#define DDS_BUCKETS 2048
+#define DDS_OFFSET 700
+
+typedef struct {
+  uint64_t counts[DDS_BUCKETS];
+  uint64_t zero; /* values <= 0 */
+  uint64_t n;
+  double max;
+} DDSketch;
+
+void dds_clear(DDSketch *s);
+void dds_add(DDSketch *s, double v);
+void dds_merge(DDSketch *into, const DDSketch *from);
+double dds_quantile(const DDSketch *s, double q);
+
+/* 2^14 one-byte registers: about 0.8% standard error */
+#define HLL_P 14
+#define HLL_M (1u << HLL_P)
+
+typedef struct {
+  uint8_t reg[HLL_M];
+} HyperLogLog;
+
+void hll_clear(HyperLogLog *h);
+void hll_add(HyperLogLog *h, const void *data, size_t len);
+double hll_estimate(const HyperLogLog *h);
+
+#endif /* SKETCH_H */
@@ -0,0 +1,76 @@
+/*
+ * snapshot.c - Plain-text window snapshots
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * A snapshot is a few "key: value" header lines, a blank line, then the
+ * lines the window shows, sanitised by the display code.  It is written
+ * to PATH.tmp and renamed over PATH, so a reader always sees a whole one.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "display.h"
+#include "snapshot.h"
+
+/* Returns false (after reporting why) if the snapshot couldn't be made. */
+bool snapshot_write(const char *path, const SnapshotInfo *info) {
+  size_t n = strlen(path);
+  char *tmp = malloc(n + sizeof(".tmp"));
+  if (!tmp) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  memcpy(tmp, path, n);
+  memcpy(tmp + n, ".tmp", sizeof(".tmp"));
+
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  FILE *fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+  if (!fp) {
+    fprintf(stderr, "sash: cannot write snapshot '%s': %s\n", tmp,
+            strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    free(tmp);
+    return false;
+  }
+
+  char when[32] = "";
+  time_t t = time(NULL);
+  struct tm tm;
+  if (gmtime_r(&t, &tm))
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", &tm);
+
+  fprintf(fp, "updated: %s\n", when);
+  fprintf(fp, "lines: %zu\n", info->lines);
+  fprintf(fp, "rate: %.1f lines/s\n", info->rate);
+  if (info->command)
+    fprintf(fp, "command: %s\n", info->command);
+  fputc('\n', fp);
+  display_write_plain(fp, SNAPSHOT_COLS);
+
+  bool ok = !ferror(fp);
+  if (fclose(fp) != 0)
+    ok = false;
+  if (ok && rename(tmp, path) == -1)
+    ok = false;
+  if (!ok) {
+    fprintf(stderr, "sash: cannot write snapshot '%s': %s\n", path,
+            strerror(errno));
+    unlink(tmp);
+  }
+  free(tmp);
+  return ok;
+}
@@ -0,0 +1,23 @@
+/*
+ * snapshot.h - Plain-text window snapshots
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SNAPSHOT_COLS 1024 /* lines are cut here, like the window's width */
+
+typedef struct {
+  size_t lines;        /* lines seen so far */
+  double rate;         /* lines per second since the previous snapshot */
+  const char *command; /* "running, pid 123", "exited 0"; NULL = pipe */
+} SnapshotInfo;
+
+bool snapshot_write(const char *path, const SnapshotInfo *info);
+
+#endif /* SNAPSHOT_H */
@@ -0,0 +1,404 @@
+/*
+ * stall.c - What a quiet command is blocked on, from /proc
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * A sample walks the process tree under the command: one pass over
+ * /proc/N/stat finds every process's parent, then the command's
+ * descendants are visited depth first.  For each of them we keep its
+ * state, the kernel function it sleeps in (wchan), the system call it is
+ * in (/proc/N/syscall, named through <sys/syscall.h>) and its CPU time;
+ * two samples give the CPU used in between, which tells a process
+ * spinning from one that is blocked.
+ *
+ * Only the caller's idle timer takes samples, so the cost, a few reads
+ * per process on the machine, is paid while the command is quiet and
+ * never per line.  Without /proc (not Linux) a sample finds nothing.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "stall.h"
+
+/* The calls a process is usually found waiting in. */
+static const struct {
+  long nr;
+  const char *name;
+} syscall_names[] = {
+#ifdef SYS_read
+    {SYS_read, "read"},
+#endif
+#ifdef SYS_write
+    {SYS_write, "write"},
+#endif
+#ifdef SYS_readv
+    {SYS_readv, "readv"},
+#endif
+#ifdef SYS_writev
+    {SYS_writev, "writev"},
+#endif
+#ifdef SYS_pread64
+    {SYS_pread64, "pread64"},
+#endif
+#ifdef SYS_pwrite64
+    {SYS_pwrite64, "pwrite64"},
+#endif
+#ifdef SYS_open
+    {SYS_open, "open"},
+#endif
+#ifdef SYS_openat
+    {SYS_openat, "openat"},
+#endif
+#ifdef SYS_close
+    {SYS_close, "close"},
+#endif
+#ifdef SYS_poll
+    {SYS_poll, "poll"},
+#endif
+#ifdef SYS_ppoll
+    {SYS_ppoll, "ppoll"},
+#endif
+#ifdef SYS_select
+    {SYS_select, "select"},
+#endif
+#ifdef SYS_pselect6
+    {SYS_pselect6, "pselect6"},
+#endif
+#ifdef SYS_epoll_wait
+    {SYS_epoll_wait, "epoll_wait"},
+#endif
+#ifdef SYS_epoll_pwait
+    {SYS_epoll_pwait, "epoll_pwait"},
+#endif
+#ifdef SYS_wait4
+    {SYS_wait4, "wait4"},
+#endif
+#ifdef SYS_waitid
+    {SYS_waitid, "waitid"},
+#endif
+#ifdef SYS_futex
+    {SYS_futex, "futex"},
+#endif
+#ifdef SYS_nanosleep
+    {SYS_nanosleep, "nanosleep"},
+#endif
+#ifdef SYS_clock_nanosleep
+    {SYS_clock_nanosleep, "clock_nanosleep"},
+#endif
+#ifdef SYS_pause
+    {SYS_pause, "pause"},
+#endif
+#ifdef SYS_rt_sigsuspend
+    {SYS_rt_sigsuspend, "rt_sigsuspend"},
+#endif
+#ifdef SYS_rt_sigtimedwait
+    {SYS_rt_sigtimedwait, "rt_sigtimedwait"},
+#endif
+#ifdef SYS_accept
+    {SYS_accept, "accept"},
+#endif
+#ifdef SYS_accept4
+    {SYS_accept4, "accept4"},
+#endif
+#ifdef SYS_connect
+    {SYS_connect, "connect"},
+#endif
+#ifdef SYS_recvfrom
+    {SYS_recvfrom, "recvfrom"},
+#endif
+#ifdef SYS_recvmsg
+    {SYS_recvmsg, "recvmsg"},
+#endif
+#ifdef SYS_sendto
+    {SYS_sendto, "sendto"},
+#endif
+#ifdef SYS_sendmsg
+    {SYS_sendmsg, "sendmsg"},
+#endif
+#ifdef SYS_flock
+    {SYS_flock, "flock"},
+#endif
+#ifdef SYS_fcntl
+    {SYS_fcntl, "fcntl"},
+#endif
+#ifdef SYS_ioctl
+    {SYS_ioctl, "ioctl"},
+#endif
+#ifdef SYS_fsync
+    {SYS_fsync, "fsync"},
+#endif
+#ifdef SYS_fdatasync
+    {SYS_fdatasync, "fdatasync"},
+#endif
+#ifdef SYS_io_getevents
+    {SYS_io_getevents, "io_getevents"},
+#endif
+#ifdef SYS_io_uring_enter
+    {SYS_io_uring_enter, "io_uring_enter"},
+#endif
+};
+
+/* Read a small /proc file into buf; false if it can't be read. */
+static bool read_proc(const char *dir, int pid, const char *name, char *buf,
+                      size_t cap) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%d/%s", dir, pid, name);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  ssize_t n = read(fd, buf, cap - 1);
+  close(fd);
+  if (n < 0)
+    return false;
+  buf[n] = '\0';
+  return true;
+}
+
+/* Parse /proc/N/stat.  The command name is in parentheses and may itself
+   contain spaces and parentheses, so the fields start after the last ')'. */
+static bool parse_stat(const char *buf, StallProc *p) {
+  const char *open = strchr(buf, '(');
+  const char *close = strrchr(buf, ')');
+  if (!open || !close || close < open)
+    return false;
+  size_t n = (size_t)(close - open - 1);
+  if (n >= sizeof(p->comm))
+    n = sizeof(p->comm) - 1;
+  memcpy(p->comm, open + 1, n);
+  p->comm[n] = '\0';
+  p->pid = atoi(buf);
+
+  /* state ppid pgrp session tty_nr tpgid flags minflt cminflt majflt
+     cmajflt utime stime */
+  unsigned long long utime, stime;
+  if (sscanf(close + 1,
+             " %c %d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+             &p->state, &p->ppid, &utime, &stime) != 4)
+    return false;
+  long hz = sysconf(_SC_CLK_TCK);
+  uint64_t tick = 1000000000ULL / (uint64_t)(hz > 0 ? hz : 100);
+  p->cpu_ns = (utime + stime) * tick;
+  return true;
+}
+
+static void parse_syscall(const char *buf, char *out, size_t cap) {
+  if (strncmp(buf, "running", 7) == 0) {
+    snprintf(out, cap, "running");
+    return;
+  }
+  char *end;
+  long nr = strtol(buf, &end, 10);
+  if (end == buf) {
+    snprintf(out, cap, "?");
+    return;
+  }
+  if (nr < 0) {
+    snprintf(out, cap, "-"); /* blocked, but not in a system call */
+    return;
+  }
+  for (size_t i = 0; i < sizeof(syscall_names) / sizeof(syscall_names[0]);
+       i++) {
+    if (syscall_names[i].nr == nr) {
+      snprintf(out, cap, "%s", syscall_names[i].name);
+      return;
+    }
+  }
+  snprintf(out, cap, "#%ld", nr);
+}
+
+/* Fill in what only the chosen processes need: wchan and syscall. */
+static void read_details(const char *dir, StallProc *p) {
+  char buf[256];
+  if (!read_proc(dir, p->pid, "wchan", buf, sizeof(buf)))
+    snprintf(p->wchan, sizeof(p->wchan), "?");
+  else if (buf[0] == '\0' || strcmp(buf, "0") == 0)
+    snprintf(p->wchan, sizeof(p->wchan), "-");
+  else
+    snprintf(p->wchan, sizeof(p->wchan), "%.*s", (int)sizeof(p->wchan) - 1,
+             buf);
+
+  if (!read_proc(dir, p->pid, "syscall", buf, sizeof(buf)))
+    snprintf(p->syscall, sizeof(p->syscall), "?"); /* not ours to see */
+  else
+    parse_syscall(buf, p->syscall, sizeof(p->syscall));
+}
+
+static int by_pid(const void *a, const void *b) {
+  const StallProc *x = a, *y = b;
+  return (x->pid > y->pid) - (x->pid < y->pid);
+}
+
+/* Every process's stat, sorted by pid; NULL if /proc can't be read. */
+static StallProc *scan(const char *dir, int *count) {
+  DIR *d = opendir(dir);
+  if (!d)
+    return NULL;
+  StallProc *all = NULL;
+  int n = 0, cap = 0;
+  struct dirent *e;
+  while ((e = readdir(d)) != NULL) {
+    if (!isdigit((unsigned char)e->d_name[0]))
+      continue;
+    char buf[512];
+    StallProc p = {0};
+    if (!read_proc(dir, atoi(e->d_name), "stat", buf, sizeof(buf)) ||
+        !parse_stat(buf, &p))
+      continue; /* gone since readdir() */
+    if (n == cap) {
+      cap = cap ? cap * 2 : 256;
+      StallProc *grown = realloc(all, (size_t)cap * sizeof(StallProc));
+      if (!grown) {
+        perror("sash: realloc");
+        exit(1);
+      }
+      all = grown;
+    }
+    all[n++] = p;
+  }
+  closedir(d);
+  if (n > 0)
+    qsort(all, (size_t)n, sizeof(StallProc), by_pid);
+  *count = n;
+  return all;
+}
+
+/* Append pid and its descendants, depth first, children in pid order. */
+static void walk(Stall *s, const StallProc *all, int n, int i, int depth) {
+  if (s->nprocs == STALL_MAX_PROCS)
+    return;
+  StallProc *p = &s->procs[s->nprocs++];
+  *p = all[i];
+  p->depth = depth;
+  for (int j = 0; j < n; j++)
+    if (all[j].ppid == all[i].pid && all[j].pid != all[i].pid)
+      walk(s, all, n, j, depth + 1);
+}
+
+void stall_init(Stall *s, const char *proc_dir) {
+  memset(s, 0, sizeof(*s));
+  s->proc_dir = proc_dir ? proc_dir : "/proc";
+}
+
+/*
+ * Sample root and its descendants.  CPU use is measured against the
+ * previous sample, if there was one.  Returns the number of processes
+ * found (0 if root is gone or there is no /proc).
+ */
+int stall_sample(Stall *s, int root, uint64_t now) {
+  int nprev = s->nprocs;
+  int prev_pid[STALL_MAX_PROCS];
+  uint64_t prev_cpu[STALL_MAX_PROCS];
+  for (int i = 0; i < nprev; i++) {
+    prev_pid[i] = s->procs[i].pid;
+    prev_cpu[i] = s->procs[i].cpu_ns;
+  }
+  s->interval = nprev > 0 ? now - s->sampled_at : 0;
+  s->sampled_at = now;
+  s->nprocs = 0;
+
+  int n = 0;
+  StallProc *all = scan(s->proc_dir, &n);
+  int i;
+  for (i = 0; i < n && all[i].pid != root; i++)
+    ;
+  if (i < n)
+    walk(s, all, n, i, 0);
+  free(all);
+
+  for (int k = 0; k < s->nprocs; k++) {
+    StallProc *p = &s->procs[k];
+    read_details(s->proc_dir, p);
+    p->seen_before = 0;
+    for (int j = 0; j < nprev; j++) {
+      if (prev_pid[j] == p->pid && prev_cpu[j] <= p->cpu_ns) {
+        p->prev_cpu_ns = prev_cpu[j];
+        p->seen_before = 1;
+        break;
+      }
+    }
+  }
+  return s->nprocs;
+}
+
+/* Drop the last sample: the next one starts a new measurement. */
+void stall_forget(Stall *s) {
+  s->nprocs = 0;
+  s->interval = 0;
+}
+
+/* CPU use since the previous sample, in percent of one CPU; -1 if not
+   known. */
+static int cpu_percent(const Stall *s, const StallProc *p) {
+  if (!p->seen_before || s->interval == 0)
+    return -1;
+  return (int)((p->cpu_ns - p->prev_cpu_ns) * 100 / s->interval);
+}
+
+/* One process as a line, indented by its depth in the tree. */
+size_t stall_format(const Stall *s, int i, char *out, size_t cap) {
+  const StallProc *p = &s->procs[i];
+  int pct = cpu_percent(s, p);
+  char cpu[32] = "";
+  if (pct >= 0)
+    snprintf(cpu, sizeof(cpu), " (%d%%)", pct);
+  int n = snprintf(out, cap, "%*s%d %s: state %c, wchan %s, syscall %s, "
+                   "cpu %.2fs%s",
+                   p->depth * 2, "", p->pid, p->comm, p->state, p->wchan,
+                   p->syscall, (double)p->cpu_ns / 1e9, cpu);
+  return n < 0 ? 0 : (size_t)n < cap ? (size_t)n : cap - 1;
+}
+
+/*
+ * A short line for the status area.  It names the process most likely to
+ * be holding things up: the busiest one if any is using CPU, otherwise the
+ * last of the deepest (the one the others are most likely waiting on).
+ */
+size_t stall_summary(const Stall *s, uint64_t quiet_ns, char *out,
+                     size_t cap) {
+  if (s->nprocs == 0) {
+    out[0] = '\0';
+    return 0;
+  }
+  int pick = -1, best = 0;
+  for (int i = 0; i < s->nprocs; i++) {
+    int pct = cpu_percent(s, &s->procs[i]);
+    if (pct > best) {
+      best = pct;
+      pick = i;
+    }
+  }
+  if (pick < 0) {
+    pick = 0;
+    for (int i = 1; i < s->nprocs; i++)
+      if (s->procs[i].depth >= s->procs[pick].depth)
+        pick = i;
+  }
+
+  const StallProc *p = &s->procs[pick];
+  unsigned long long secs = (unsigned long long)(quiet_ns / 1000000000ULL);
+  char what[80];
+  if (best > 0)
+    snprintf(what, sizeof(what), "%d%% cpu", best);
+  else if (strcmp(p->syscall, "?") != 0 && strcmp(p->syscall, "-") != 0 &&
+           strcmp(p->syscall, "running") != 0)
+    snprintf(what, sizeof(what), "in %s", p->syscall);
+  else
+    snprintf(what, sizeof(what), "state %c, %s", p->state, p->wchan);
+  int n = snprintf(out, cap, "quiet %llus: %s %d %s", secs, p->comm, p->pid,
+                   what);
+  return n < 0 ? 0 : (size_t)n < cap ? (size_t)n : cap - 1;
+}
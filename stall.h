@@ -0,0 +1,43 @@
+/*
+ * stall.h - What a quiet command is blocked on, from /proc
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef STALL_H
+#define STALL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STALL_MAX_PROCS 64
+
+typedef struct {
+  int pid;
+  int ppid;
+  int depth; /* 0 for the command itself */
+  char state; /* R, S, D, T, Z ... */
+  char comm[32];
+  char wchan[48];   /* kernel function it sleeps in, "-" if running */
+  char syscall[24]; /* system call it is in, "running", or "?" */
+  uint64_t cpu_ns;  /* user + system, since it started */
+  uint64_t prev_cpu_ns;
+  int seen_before; /* in the previous sample, so prev_cpu_ns is valid */
+} StallProc;
+
+typedef struct {
+  const char *proc_dir; /* "/proc", or a fake tree in tests */
+  StallProc procs[STALL_MAX_PROCS];
+  int nprocs;
+  uint64_t sampled_at;
+  uint64_t interval; /* since the previous sample, 0 if none */
+} Stall;
+
+void stall_init(Stall *s, const char *proc_dir);
+int stall_sample(Stall *s, int root, uint64_t now);
+void stall_forget(Stall *s);
+size_t stall_format(const Stall *s, int i, char *out, size_t cap);
+size_t stall_summary(const Stall *s, uint64_t quiet_ns, char *out,
+                     size_t cap);
+
+#endif /* STALL_H */
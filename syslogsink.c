@@ -0,0 +1,349 @@
+/*
+ * syslogsink.c - Batched output to the local syslog socket
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * --syslog sends every line to the syslog daemon's datagram socket
+ * (/dev/log) as "<PRI>Mmm dd hh:mm:ss TAG[PID]: line", the traditional
+ * local (RFC 3164) form that syslog(3) itself uses and every local daemon
+ * accepts.  The header only changes once a second, so it is formatted
+ * once per second and copied in front of each line.
+ *
+ * Lines are queued and sent with one sendmmsg() per batch when the
+ * main loop finishes a drain.  The socket is non-blocking: if the daemon
+ * falls behind, the rest of the queue waits for the socket to become
+ * writable (syslogsink_pollfd) while input keeps flowing.  Past
+ * SYSLOG_MAX_QUEUED messages lines are dropped, and a "… N lines dropped"
+ * message is logged once there is room again.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "syslogsink.h"
+
+#define SYSLOG_BATCH 64          /* datagrams per sendmmsg() */
+#define SYSLOG_MAX_LINE 8000     /* longer lines are cut */
+#define SYSLOG_MAX_QUEUED 4096   /* messages held while the daemon is behind */
+#define SYSLOG_MAX_BYTES (4u << 20)
+
+static const struct {
+  const char *name;
+  int code;
+} facilities[] = {
+    {"kern", LOG_KERN},         {"user", LOG_USER},     {"mail", LOG_MAIL},
+    {"daemon", LOG_DAEMON},     {"auth", LOG_AUTH},     {"syslog", LOG_SYSLOG},
+    {"lpr", LOG_LPR},           {"news", LOG_NEWS},     {"uucp", LOG_UUCP},
+    {"cron", LOG_CRON},         {"authpriv", LOG_AUTHPRIV},
+    {"local0", LOG_LOCAL0},     {"local1", LOG_LOCAL1}, {"local2", LOG_LOCAL2},
+    {"local3", LOG_LOCAL3},     {"local4", LOG_LOCAL4}, {"local5", LOG_LOCAL5},
+    {"local6", LOG_LOCAL6},     {"local7", LOG_LOCAL7},
+};
+
+static int g_fd = -1;
+static struct sockaddr_un g_addr;
+static char g_tag[64];
+static int g_pri;
+static int g_pid;
+
+/* the header, reformatted when the second changes */
+static time_t g_hdr_time = (time_t)-1;
+static char g_hdr[128];
+static size_t g_hdr_len;
+
+/* queued messages: g_buf holds them back to back */
+static char *g_buf = NULL;
+static size_t g_buf_len, g_buf_cap;
+static uint32_t g_off[SYSLOG_MAX_QUEUED];
+static uint32_t g_len[SYSLOG_MAX_QUEUED];
+static int g_head, g_count; /* messages [g_head, g_count) are unsent */
+
+static unsigned long long g_sent, g_dropped, g_unreported;
+static bool g_failed; /* socket error already reported */
+
+static bool connect_socket(void) {
+  if (g_fd >= 0)
+    close(g_fd);
+  g_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+  if (g_fd < 0)
+    return false;
+  fcntl(g_fd, F_SETFD, FD_CLOEXEC);
+  fcntl(g_fd, F_SETFL, O_NONBLOCK);
+  if (connect(g_fd, (struct sockaddr *)&g_addr, sizeof(g_addr)) == -1) {
+    int err = errno;
+    close(g_fd);
+    g_fd = -1;
+    errno = err;
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Parse "TAG[,FACILITY]" and connect to the daemon's socket.  Returns
+ * false (after reporting why) on a bad spec or if nothing listens there.
+ */
+bool syslogsink_open(const char *spec, const char *path) {
+  const char *comma = strchr(spec, ',');
+  size_t tag_len = comma ? (size_t)(comma - spec) : strlen(spec);
+  if (tag_len == 0 || tag_len >= sizeof(g_tag)) {
+    fprintf(stderr, "sash: invalid syslog tag: '%s'\n", spec);
+    return false;
+  }
+  memcpy(g_tag, spec, tag_len);
+  g_tag[tag_len] = '\0';
+
+  int facility = LOG_USER;
+  if (comma) {
+    size_t i;
+    for (i = 0; i < sizeof(facilities) / sizeof(facilities[0]); i++) {
+      if (strcmp(comma + 1, facilities[i].name) == 0)
+        break;
+    }
+    if (i == sizeof(facilities) / sizeof(facilities[0])) {
+      fprintf(stderr, "sash: unknown syslog facility: '%s'\n", comma + 1);
+      return false;
+    }
+    facility = facilities[i].code;
+  }
+  g_pri = facility | LOG_INFO;
+  g_pid = (int)getpid();
+
+  if (strlen(path) >= sizeof(g_addr.sun_path)) {
+    fprintf(stderr, "sash: syslog socket path too long: '%s'\n", path);
+    return false;
+  }
+  memset(&g_addr, 0, sizeof(g_addr));
+  g_addr.sun_family = AF_UNIX;
+  strcpy(g_addr.sun_path, path);
+  if (!connect_socket()) {
+    fprintf(stderr, "sash: %s: %s\n", path, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool syslogsink_active(void) { return g_fd >= 0 || g_count > g_head; }
+
+/* Log lines under this pid (the command's) rather than sash's own. */
+void syslogsink_set_pid(int pid) {
+  g_pid = pid;
+  g_hdr_time = (time_t)-1;
+}
+
+static void format_header(time_t now) {
+  struct tm tm;
+  char stamp[32];
+  localtime_r(&now, &tm);
+  strftime(stamp, sizeof(stamp), "%b %e %H:%M:%S", &tm);
+  int n = snprintf(g_hdr, sizeof(g_hdr), "<%d>%s %s[%d]: ", g_pri, stamp,
+                   g_tag, g_pid);
+  g_hdr_len = n > 0 ? (size_t)n : 0;
+  g_hdr_time = now;
+}
+
+/* Queue one message; false if the queue is full. */
+static bool enqueue(const char *msg, size_t len) {
+  if (g_head > 0 && (g_count == SYSLOG_MAX_QUEUED ||
+                     g_buf_len + g_hdr_len + len > g_buf_cap)) {
+    /* reclaim the space of messages already sent */
+    size_t base = g_off[g_head];
+    memmove(g_buf, g_buf + base, g_buf_len - base);
+    g_buf_len -= base;
+    for (int i = g_head; i < g_count; i++) {
+      g_off[i - g_head] = g_off[i] - (uint32_t)base;
+      g_len[i - g_head] = g_len[i];
+    }
+    g_count -= g_head;
+    g_head = 0;
+  }
+  if (g_count == SYSLOG_MAX_QUEUED ||
+      g_buf_len + g_hdr_len + len > SYSLOG_MAX_BYTES)
+    return false;
+
+  size_t need = g_buf_len + g_hdr_len + len;
+  if (need > g_buf_cap) {
+    size_t cap = g_buf_cap ? g_buf_cap : 65536;
+    while (cap < need)
+      cap *= 2;
+    g_buf = realloc(g_buf, cap);
+    if (!g_buf) {
+      perror("sash: realloc");
+      exit(1);
+    }
+    g_buf_cap = cap;
+  }
+  g_off[g_count] = (uint32_t)g_buf_len;
+  g_len[g_count] = (uint32_t)(g_hdr_len + len);
+  memcpy(g_buf + g_buf_len, g_hdr, g_hdr_len);
+  memcpy(g_buf + g_buf_len + g_hdr_len, msg, len);
+  g_buf_len += g_hdr_len + len;
+  g_count++;
+  return true;
+}
+
+/* Queue the "… N lines dropped" message if lines were dropped since the
+   last one and there's room for it and one more. */
+static void report_dropped(void) {
+  if (g_unreported == 0)
+    return;
+  char marker[64];
+  int n = snprintf(marker, sizeof(marker), "\xe2\x80\xa6 %llu line%s dropped",
+                   g_unreported, g_unreported == 1 ? "" : "s");
+  if (n > 0 && g_count - g_head < SYSLOG_MAX_QUEUED - 1 &&
+      enqueue(marker, (size_t)n))
+    g_unreported = 0;
+}
+
+void syslogsink_line(const char *line, size_t len) {
+  if (g_fd < 0)
+    return;
+  time_t now = time(NULL);
+  if (now != g_hdr_time)
+    format_header(now);
+  while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+    len--;
+  if (len > SYSLOG_MAX_LINE)
+    len = SYSLOG_MAX_LINE;
+
+  report_dropped();
+  if (g_unreported > 0 || !enqueue(line, len)) {
+    g_dropped++;
+    g_unreported++;
+  }
+}
+
+/* Send as many datagrams as take up to n; -1 with errno on error. */
+static int send_batch(int first, int n) {
+#ifdef __linux__
+  struct mmsghdr msgs[SYSLOG_BATCH];
+  struct iovec iov[SYSLOG_BATCH];
+  memset(msgs, 0, sizeof(msgs[0]) * (size_t)n);
+  for (int i = 0; i < n; i++) {
+    iov[i].iov_base = g_buf + g_off[first + i];
+    iov[i].iov_len = g_len[first + i];
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  return sendmmsg(g_fd, msgs, (unsigned)n, 0);
+#else
+  int sent = 0;
+  for (; sent < n; sent++) {
+    if (send(g_fd, g_buf + g_off[first + sent], g_len[first + sent], 0) < 0)
+      return sent > 0 ? sent : -1;
+  }
+  return sent;
+#endif
+}
+
+/* Send what's queued until it's all gone or the socket is full. */
+void syslogsink_flush(void) {
+  bool reconnected = false;
+  while (g_head < g_count) {
+    int n = g_count - g_head;
+    if (n > SYSLOG_BATCH)
+      n = SYSLOG_BATCH;
+    int sent = send_batch(g_head, n);
+    if (sent < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+        break; /* wait for POLLOUT */
+      if (errno == EMSGSIZE) {
+        g_head++; /* the daemon won't take it however long we wait */
+        g_dropped++;
+        continue;
+      }
+      /* the daemon went away (e.g. restarted): try once to reconnect */
+      if (!reconnected && connect_socket()) {
+        reconnected = true;
+        continue;
+      }
+      if (!g_failed) {
+        fprintf(stderr, "sash: syslog: %s\n", strerror(errno));
+        g_failed = true;
+      }
+      g_dropped += (unsigned long long)(g_count - g_head);
+      g_head = g_count;
+      break;
+    }
+    g_head += sent;
+    g_sent += (unsigned long long)sent;
+    if (sent < n)
+      break;
+  }
+  if (g_head == g_count) {
+    g_head = g_count = 0;
+    g_buf_len = 0;
+  }
+}
+
+/* The socket to poll for POLLOUT while messages wait, otherwise -1. */
+int syslogsink_pollfd(void) { return g_head < g_count ? g_fd : -1; }
+
+void syslogsink_print_stats(FILE *out) {
+  fprintf(out, "sash: syslog: %llu lines sent", g_sent);
+  if (g_dropped > 0)
+    fprintf(out, ", %llu dropped", g_dropped);
+  fputc('\n', out);
+}
+
+/*
+ * Before an upgrade: give the daemon a second to take what's queued, as
+ * at close.  Returns how many lines the new process should report as
+ * dropped: those still queued and those dropped without a message yet.
+ * The queue is kept in case the exec fails.
+ */
+unsigned long long syslogsink_drain(void) {
+  if (g_fd < 0)
+    return 0;
+  struct timeval tv = {1, 0};
+  setsockopt(g_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  fcntl(g_fd, F_SETFL, 0);
+  syslogsink_flush();
+  if (g_fd >= 0)
+    fcntl(g_fd, F_SETFL, O_NONBLOCK);
+  return g_unreported + (unsigned long long)(g_count - g_head);
+}
+
+/* After an upgrade: lines the old process couldn't send, reported in
+   front of the next one and in --stats. */
+void syslogsink_add_dropped(unsigned long long n) {
+  g_dropped += n;
+  g_unreported += n;
+}
+
+/* Give the daemon a second to take what's left, including a last drop
+   message, then close. */
+void syslogsink_close(void) {
+  if (g_fd < 0)
+    return;
+  struct timeval tv = {1, 0};
+  setsockopt(g_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  fcntl(g_fd, F_SETFL, 0);
+  syslogsink_flush();
+  report_dropped();
+  syslogsink_flush();
+  g_unreported = 0;
+  g_dropped += (unsigned long long)(g_count - g_head);
+  g_head = g_count = 0;
+  close(g_fd);
+  g_fd = -1;
+  free(g_buf);
+  g_buf = NULL;
+  g_buf_cap = g_buf_len = 0;
+}
@@ -0,0 +1,27 @@
+/*
+ * syslogsink.h - Batched output to the local syslog socket
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef SYSLOGSINK_H
+#define SYSLOGSINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define SYSLOG_DEFAULT_PATH "/dev/log"
+
+bool syslogsink_open(const char *spec, const char *path);
+bool syslogsink_active(void);
+void syslogsink_set_pid(int pid);
+void syslogsink_line(const char *line, size_t len);
+void syslogsink_flush(void);
+unsigned long long syslogsink_drain(void);
+void syslogsink_add_dropped(unsigned long long n);
+int syslogsink_pollfd(void);
+void syslogsink_print_stats(FILE *out);
+void syslogsink_close(void);
+
+#endif /* SYSLOGSINK_H */
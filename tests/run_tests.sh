@@ -184,6 +184,722 @@ assert_exit "-a flag accepted" 0 sh -c 'echo hello | "$1" -a' _ "$SASH"
 # 27. -A flag accepted
 assert_exit "-A flag accepted" 0 sh -c 'echo hello | "$1" -A' _ "$SASH"
 
+# 28. --stats reports counts on stderr
+out="$(printf 'a\nb\n' | "$SASH" --stats 2>&1 >/dev/null)"
+case "$out" in
+*"2 lines, 4 bytes"*) pass "--stats reports lines and bytes" ;;
+*) fail "--stats reports lines and bytes (got '$out')" ;;
+esac
+
+# 29. Idle command costs no wakeups beyond its output
+out="$("$SASH" --stats 'sleep 1; echo x' 2>&1 >/dev/null)"
+wakeups="$(printf '%s' "$out" | sed -n 's/.* \([0-9]*\) wakeups.*/\1/p')"
+if [ -n "$wakeups" ] && [ "$wakeups" -le 3 ]; then
+    pass "idle command: no periodic wakeups"
+else
+    fail "idle command: no periodic wakeups (got '$out')"
+fi
+
+# 30. Buffered output files are flushed without waiting for exit
+f="$TEST_TMPDIR/interval.txt"
+"$SASH" -w "$f" 'echo early; sleep 3' >/dev/null &
+pid=$!
+sleep 2
+assert_file_content "flush interval: file written while running" "$f" "early"
+wait "$pid"
+
+# 31. --index-search writes a sidecar and --grep finds lines through it
+f="$TEST_TMPDIR/indexed.log"
+{ seq 1 50000; echo "rare_marker_42"; seq 1 50000; } |
+    "$SASH" --index-search -w "$f" >/dev/null
+if [ -f "$f.sidx" ]; then
+    pass "--index-search writes sidecar"
+else
+    fail "--index-search writes sidecar"
+fi
+out="$("$SASH" --grep "$f" rare_marker)"
+assert_eq "--grep finds indexed line" "rare_marker_42" "$out"
+assert_exit "--grep exits 1 without match" 1 "$SASH" --grep "$f" no_such_text
+
+# 32. --max-lines-per-sec limits only the files named after it
+f1="$TEST_TMPDIR/full.txt"
+f2="$TEST_TMPDIR/limited.txt"
+count="$(seq 1 1000 | "$SASH" -w "$f1" --max-lines-per-sec 10 -w "$f2" |
+    wc -l | tr -d ' ')"
+assert_eq "rate limit: stdout complete" "1000" "$count"
+assert_eq "rate limit: unlimited file complete" "1000" \
+    "$(wc -l <"$f1" | tr -d ' ')"
+assert_eq "rate limit: limited file keeps the budget" \
+    "$(seq 1 10; printf '\342\200\246 990 lines dropped')" "$(cat "$f2")"
+
+# 33. --max-rate accepts unit suffixes and rejects garbage
+assert_exit "--max-rate 10MB/s accepted" 0 sh -c \
+    'echo x | "$1" --max-rate 10MB/s -w /dev/null' _ "$SASH"
+assert_exit "--max-rate garbage rejected" 1 "$SASH" --max-rate 10XB
+
+# 34. --serve streams to socket clients, with --serve-backlog replaying
+#     the window contents to late joiners
+if command -v python3 >/dev/null 2>&1; then
+    sock="$TEST_TMPDIR/serve.sock"
+    "$SASH" --serve "$sock" --serve-backlog \
+        'echo before; sleep 1; echo after' >/dev/null &
+    pid=$!
+    out="$(python3 - "$sock" <<'PY'
+import socket, sys, time
+s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+for _ in range(100):
+    try:
+        s.connect(sys.argv[1])
+        break
+    except OSError:
+        time.sleep(0.05)
+time.sleep(0.5)
+data = b""
+while True:
+    b = s.recv(4096)
+    if not b:
+        break
+    data += b
+sys.stdout.write(data.decode())
+PY
+)"
+    wait "$pid"
+    assert_eq "--serve: backlog then live lines" "$(printf 'before\nafter')" \
+        "$out"
+    if [ ! -e "$sock" ]; then
+        pass "--serve: socket removed at exit"
+    else
+        fail "--serve: socket removed at exit"
+    fi
+fi
+
+# 35. --fail-on stops the command's process group and exits 3
+f="$TEST_TMPDIR/failon.txt"
+start=$SECONDS
+rc=0
+err="$("$SASH" --fail-on 'FATAL|No space left' -w "$f" \
+    'echo ok; echo "FATAL: disk"; sleep 30 & wait; echo never' 2>&1 >/dev/null)" ||
+    rc=$?
+assert_eq "--fail-on: exit code" "3" "$rc"
+if [ $((SECONDS - start)) -lt 10 ]; then
+    pass "--fail-on: command stopped early"
+else
+    fail "--fail-on: command stopped early"
+fi
+assert_file_content "--fail-on: output kept up to the match" "$f" \
+    "$(printf 'ok\nFATAL: disk')"
+case "$err" in
+*"matched line 2: FATAL: disk"*) pass "--fail-on: matching line reported" ;;
+*) fail "--fail-on: matching line reported (got '$err')" ;;
+esac
+
+# 36. --fail-on without a match keeps the command's status
+assert_exit "--fail-on: no match keeps exit code" 0 "$SASH" --fail-on FATAL \
+    'echo fine'
+assert_exit "--fail-on: invalid regex rejected" 1 "$SASH" --fail-on 'a(' true
+
+# 37. --ready returns once the service is ready and keeps logging
+f="$TEST_TMPDIR/ready.txt"
+rc=0
+pid="$("$SASH" --ready 'listening' -w "$f" \
+    'echo starting; echo listening; sleep 1; echo later; sleep 30')" || rc=$?
+assert_eq "--ready: exit 0 when ready" "0" "$rc"
+assert_file_content "--ready: output up to ready line" "$f" \
+    "$(printf 'starting\nlistening')"
+sleep 2
+kill "$pid" 2>/dev/null
+sleep 0.5
+assert_file_content "--ready: output teed in background" "$f" \
+    "$(printf 'starting\nlistening\nlater')"
+
+# 38. --ready-timeout and early exit report failure
+assert_exit "--ready-timeout: exit 124" 124 "$SASH" --ready never \
+    --ready-timeout 0.5 'sleep 30'
+assert_exit "--ready: command exit status when not ready" 5 "$SASH" \
+    --ready never 'exit 5'
+
+# 39. --cpu-budget parses percentages and keeps every line
+f="$TEST_TMPDIR/budget.txt"
+seq 1 20000 | "$SASH" --cpu-budget 5% --stats -w "$f" >/dev/null \
+    2>"$TEST_TMPDIR/budget.err"
+assert_eq "--cpu-budget: all lines written" "20000" "$(wc -l < "$f" | tr -d ' ')"
+if grep -q "cpu budget 5%" "$TEST_TMPDIR/budget.err"; then
+    pass "--cpu-budget: reported in --stats"
+else
+    fail "--cpu-budget: reported in --stats (got '$(cat \
+        "$TEST_TMPDIR/budget.err")')"
+fi
+assert_exit "--cpu-budget: invalid value" 1 "$SASH" --cpu-budget 5x true
+assert_exit "--cpu-budget: zero rejected" 1 "$SASH" --cpu-budget 0 true
+
+# 40. --jsonl writes one escaped JSON object per line
+f="$TEST_TMPDIR/out.jsonl"
+printf 'plain\nsay "hi"\tnow\n\377bad\n' | "$SASH" --jsonl "$f" >/dev/null
+assert_eq "--jsonl: one record per line" "3" "$(wc -l < "$f" | tr -d ' ')"
+assert_eq "--jsonl: escaped text" \
+    '"stream":"stdin","text":"say \"hi\"\tnow"}' \
+    "$(sed -n 2p "$f" | sed 's/.*\("stream"\)/\1/')"
+assert_eq "--jsonl: invalid UTF-8 replaced" '"text":"\ufffdbad"}' \
+    "$(sed -n 3p "$f" | sed 's/.*\("text"\)/\1/')"
+assert_eq "--jsonl: sequence numbers" "1 2 3" \
+    "$(sed 's/^{"seq":\([0-9]*\),.*/\1/' "$f" | tr '\n' ' ' | sed 's/ $//')"
+"$SASH" --jsonl "$f" 'echo hi' >/dev/null
+assert_eq "--jsonl: command stream" '"stream":"command","text":"hi"}' \
+    "$(sed 's/.*\("stream"\)/\1/' "$f")"
+if command -v python3 >/dev/null 2>&1; then
+    printf 'a\001b\n\303\n' | "$SASH" --jsonl "$f" >/dev/null
+    if python3 -c 'import json,sys; [json.loads(l) for l in open(sys.argv[1])]' \
+        "$f" 2>/dev/null; then
+        pass "--jsonl: records parse as JSON"
+    else
+        fail "--jsonl: records parse as JSON (got '$(cat "$f")')"
+    fi
+fi
+
+# 41. --stat-field / --distinct-field summaries at exit
+result="$(for i in $(seq 1 100); do echo "id=$i user=u$((i % 7)) ms=$i"; done |
+    "$SASH" --stat-field ms --distinct-field user 2>&1 >/dev/null)"
+# quantiles are approximate (within 1%); the count and max are exact
+assert_eq "--stat-field: exit summary" "sash: ms: 100 values, max 100" \
+    "$(echo "$result" | sed -n 1p | sed 's/, p50.*, max/, max/')"
+assert_eq "--distinct-field: exit summary" \
+    "sash: user: ~7 distinct values on 100 lines" \
+    "$(echo "$result" | sed -n 2p)"
+assert_exit "--stat-window: invalid value" 1 "$SASH" --stat-window 0 true
+
+# 42. input already waiting is drained in one wakeup
+seq 1 300000 > "$TEST_TMPDIR/burst.txt"
+wakeups="$("$SASH" --stats < "$TEST_TMPDIR/burst.txt" 2>&1 >/dev/null |
+    sed -n 's/.* \([0-9]*\) wakeups.*/\1/p')"
+if [ -n "$wakeups" ] && [ "$wakeups" -le 3 ]; then
+    pass "drain: whole burst read per wakeup"
+else
+    fail "drain: whole burst read per wakeup (got $wakeups wakeups)"
+fi
+if command -v script >/dev/null 2>&1 &&
+    script -qc true /dev/null >/dev/null 2>&1; then
+    frames="$(script -qc "$SASH --stats < $TEST_TMPDIR/burst.txt" /dev/null |
+        sed -n 's/.* \([0-9]*\) frames.*/\1/p')"
+    if [ -n "$frames" ] && [ "$frames" -le 2 ]; then
+        pass "drain: one frame per burst"
+    else
+        fail "drain: one frame per burst (got $frames frames)"
+    fi
+fi
+
+# 43. --snapshot-file holds a header and the window's lines
+f="$TEST_TMPDIR/snap.txt"
+"$SASH" -n 2 --snapshot-file "$f" \
+    'printf "one\n\033[31mtwo\033[0m\nthree\n"; exit 4' >/dev/null || true
+assert_eq "--snapshot-file: window lines, escapes removed" \
+    "$(printf 'two\nthree')" "$(sed '1,/^$/d' "$f")"
+assert_eq "--snapshot-file: line count" "lines: 3" "$(grep '^lines:' "$f")"
+assert_eq "--snapshot-file: command status" "command: exited 4" \
+    "$(grep '^command:' "$f")"
+if [ ! -e "$f.tmp" ]; then
+    pass "--snapshot-file: temp file renamed away"
+else
+    fail "--snapshot-file: temp file renamed away"
+fi
+printf 'a\nb\n' | "$SASH" --snapshot-file "$f" >/dev/null
+if ! grep -q '^command:' "$f"; then
+    pass "--snapshot-file: no command line in pipe mode"
+else
+    fail "--snapshot-file: no command line in pipe mode (got '$(cat "$f")')"
+fi
+
+# 44. -W appends whole lines, so concurrent writers never interleave
+f="$TEST_TMPDIR/shared.log"
+pad="$(printf '%0200d' 0)"
+for w in 1 2 3 4; do
+    seq 1 5000 | sed "s/^/writer$w $pad /" | "$SASH" -W "$f" >/dev/null &
+done
+wait
+assert_eq "-W shared: every line written" "20000" \
+    "$(wc -l < "$f" | tr -d ' ')"
+assert_eq "-W shared: no torn lines" "0" \
+    "$(grep -cvE "^writer[1-4] $pad [0-9]+\$" "$f" || true)"
+
+# 45. -W splits oversized lines and terminates the last line
+f="$TEST_TMPDIR/long.log"
+{ printf '%05000d\n' 0; printf 'tail'; } | "$SASH" -W "$f" >/dev/null
+assert_eq "-W long line: split into lines of at most 4096 bytes" \
+    "4096 906 5" "$(awk '{ printf "%s ", length($0) + 1 }' "$f" | sed 's/ $//')"
+
+# 46. --progress-fd gives the command a side channel kept out of the logs
+f="$TEST_TMPDIR/progress.log"
+"$SASH" --progress-fd 3 -w "$f" \
+    'echo "1/2 [build] a" >&3; echo out; echo "fd=$SASH_PROGRESS_FD"' >/dev/null
+assert_file_content "--progress-fd: progress not in output" "$f" \
+    "$(printf 'out\nfd=3')"
+"$SASH" --progress-fd 5 -w "$f" 'echo "x" >&5 && echo ok' >/dev/null
+assert_file_content "--progress-fd: other fd numbers" "$f" "ok"
+assert_exit "--progress-fd: stdio fds rejected" 1 "$SASH" --progress-fd 2 true
+assert_exit "--progress-fd: needs a command" 1 "$SASH" --progress-fd 3 \
+    </dev/null
+
+# 47. --follow-dir follows a tree of files within a small fd limit
+d="$TEST_TMPDIR/follow"
+f="$TEST_TMPDIR/follow.log"
+mkdir -p "$d/a/b"
+for i in $(seq 1 300); do echo "old" > "$d/a/b/f$i.log"; done
+echo "old" > "$d/a/skip.txt"
+echo "old" > "$d/a/probe.log"
+(
+    ulimit -n 64
+    exec "$SASH" --stats -f --glob '*.log' --follow-dir "$d" -W "$f" \
+        >/dev/null 2>"$TEST_TMPDIR/follow.err"
+) &
+pid=$!
+# the watches are in place once a line appended to a followed file shows up
+for _ in $(seq 1 100); do
+    echo "probe" >> "$d/a/probe.log"
+    grep -q '^probe' "$f" 2>/dev/null && break
+    sleep 0.1
+done
+for r in 1 2; do
+    for i in $(seq 1 300); do echo "r$r f$i" >> "$d/a/b/f$i.log"; done
+done
+echo "skipped" >> "$d/a/skip.txt"
+mkdir -p "$d/new/deep"
+echo "fresh" > "$d/new/deep/n.log"
+for _ in $(seq 1 100); do
+    [ "$(grep -c '^r[12] f\|^fresh' "$f" || true)" = 601 ] && break
+    sleep 0.1
+done
+kill -INT "$pid"
+wait "$pid" || true
+assert_eq "--follow-dir: every appended line" "600" \
+    "$(grep -c '^r[12] f' "$f" || true)"
+assert_eq "--follow-dir: existing contents skipped" "0" \
+    "$(grep -c '^old' "$f" || true)"
+assert_eq "--follow-dir: --glob filters names" "0" \
+    "$(grep -c skipped "$f" || true)"
+assert_eq "--follow-dir: new file in a new directory" "fresh" \
+    "$(grep fresh "$f" || true)"
+if grep -q "limit 32)" "$TEST_TMPDIR/follow.err"; then
+    pass "--follow-dir: fds bounded by the limit"
+else
+    fail "--follow-dir: fds bounded by the limit (got '$(cat \
+        "$TEST_TMPDIR/follow.err")')"
+fi
+assert_exit "--follow-dir: not with a command" 1 "$SASH" --follow-dir "$d" true
+
+# 48. --reader-threads reads -r files concurrently without losing lines
+a="$TEST_TMPDIR/in_a.txt"
+b="$TEST_TMPDIR/in_b.txt"
+f="$TEST_TMPDIR/threads.log"
+seq 1 50000 | sed 's/^/a /' > "$a"
+seq 1 50000 | sed 's/^/b /' > "$b"
+"$SASH" --reader-threads 2 -w "$f" -r "$a" "$b" >/dev/null
+assert_eq "--reader-threads: every line once" \
+    "$(cat "$a" "$b" | sort | md5sum)" "$(sort "$f" | md5sum)"
+assert_eq "--reader-threads: order kept within each file" \
+    "$(cat "$a")" "$(grep '^a ' "$f")"
+assert_exit "--reader-threads: needs -r" 1 "$SASH" --reader-threads 2 true
+
+# 49. --profile writes collapsed stacks of sash's own functions
+case "$(uname -s)-$(uname -m)" in
+Linux-x86_64 | Linux-aarch64)
+    f="$TEST_TMPDIR/profile.txt"
+    seq 1 2000000 | "$SASH" --profile "$f" -w /dev/null >/dev/null
+    assert_eq "--profile: every line is STACK COUNT" "0" \
+        "$(grep -cvE '^[^ ]+ [0-9]+$' "$f" || true)"
+    if grep -q ';main;.*drain_input' "$f"; then
+        pass "--profile: stacks run from main to the read path"
+    else
+        fail "--profile: stacks run from main to the read path (got '$(head \
+            -5 "$f")')"
+    fi
+    ;;
+esac
+
+# 50. --cast records the window as asciicast v2
+f="$TEST_TMPDIR/win.cast"
+"$SASH" -n 2 --cast "$f" 'echo one; echo two; echo three' >/dev/null
+assert_eq "--cast: header sized to the window" \
+    '"width": 80, "height": 2' \
+    "$(head -1 "$f" | sed 's/.*\("width"[^,]*, "height": [0-9]*\).*/\1/')"
+if tail -1 "$f" | grep -q 'two.*three'; then
+    pass "--cast: last frame shows the window"
+else
+    fail "--cast: last frame shows the window (got '$(tail -1 "$f")')"
+fi
+if command -v python3 >/dev/null 2>&1; then
+    if python3 -c 'import json,sys; [json.loads(l) for l in open(sys.argv[1])]' \
+        "$f" 2>/dev/null; then
+        pass "--cast: events parse as JSON"
+    else
+        fail "--cast: events parse as JSON (got '$(cat "$f")')"
+    fi
+fi
+"$SASH" -n 3 --cast "$f" --cast-diff \
+    'echo a; sleep 0.3; echo b; sleep 0.3' >/dev/null
+assert_eq "--cast-diff: only the changed row" '[2;1H' \
+    "$(tail -1 "$f" | grep -o '\[[0-9];1H' | tr -d '\n')"
+
+# 51. --syslog sends each line to the daemon's datagram socket
+if command -v python3 >/dev/null 2>&1; then
+    sock="$TEST_TMPDIR/log.sock"
+    out="$(python3 - "$sock" "$SASH" <<'PY'
+import socket, subprocess, sys
+s = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+s.bind(sys.argv[1])
+p = subprocess.Popen([sys.argv[2], "--syslog", "job,daemon",
+                      "--syslog-socket", sys.argv[1], "seq 1 500"],
+                     stdout=subprocess.DEVNULL)
+s.settimeout(0.5)
+msgs = []
+while True:
+    try:
+        msgs.append(s.recv(4096).decode())
+    except socket.timeout:
+        if p.poll() is not None:
+            break
+print(len(msgs), msgs[0][:4], msgs[-1].split("]: ")[1])
+PY
+)"
+    # daemon (3) * 8 + info (6) = 30
+    assert_eq "--syslog: every line, with priority" "500 <30> 500" "$out"
+fi
+assert_exit "--syslog: missing socket" 1 "$SASH" --syslog job \
+    --syslog-socket "$TEST_TMPDIR/no.sock" true
+
+# 52. --history keeps the last N lines; SIGUSR1 writes them out
+f="$TEST_TMPDIR/history.txt"
+"$SASH" --stats --history 100K --history-file "$f" \
+    'seq 1 300000; sleep 5' >/dev/null 2>"$TEST_TMPDIR/history.err" &
+pid=$!
+sleep 1
+kill -USR1 "$pid"
+for _ in $(seq 1 20); do
+    [ -f "$f" ] && break
+    sleep 0.1
+done
+kill -INT "$pid"
+wait "$pid" || true
+assert_eq "--history: dump ends at the last line" "300000" \
+    "$(tail -1 "$f" 2>/dev/null || true)"
+n=$(wc -l < "$f" 2>/dev/null || echo 0)
+if [ "$n" -ge 100000 ] && [ "$n" -lt 110000 ]; then
+    pass "--history: keeps about N lines"
+else
+    fail "--history: keeps about N lines (got $n)"
+fi
+assert_eq "--history: dump is contiguous" "1" \
+    "$(awk 'NR > 1 && $1 != prev + 1 { bad = 1 } { prev = $1 }
+        END { print bad ? 0 : 1 }' "$f" 2>/dev/null || true)"
+if grep -q "history: .* lines in .* blocks" "$TEST_TMPDIR/history.err"; then
+    pass "--history: --stats reports the compression"
+else
+    fail "--history: --stats reports the compression (got '$(cat \
+        "$TEST_TMPDIR/history.err")')"
+fi
+if command -v python3 >/dev/null 2>&1; then
+    sock="$TEST_TMPDIR/history.sock"
+    "$SASH" --history 1M --serve "$sock" --serve-backlog \
+        'seq 1 200000; sleep 5' >/dev/null &
+    pid=$!
+    sleep 1
+    out="$(python3 - "$sock" <<'PY'
+import socket, sys
+s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+s.connect(sys.argv[1])
+s.settimeout(1)
+data = b""
+try:
+    while not data.endswith(b"\n200000\n"):
+        chunk = s.recv(1 << 16)
+        if not chunk:
+            break
+        data += chunk
+except socket.timeout:
+    pass
+lines = data.split()
+print(len(lines), lines[0].decode() if lines else "")
+PY
+)"
+    kill -INT "$pid"
+    wait "$pid" || true
+    assert_eq "--history: whole history as the serve backlog" "200000 1" \
+        "$out"
+fi
+assert_exit "--history-file: needs --history" 1 "$SASH" --history-file "$f" \
+    true
+
+# 53. --minimap adds a density strip under the window
+f="$TEST_TMPDIR/minimap.cast"
+"$SASH" -n 2 --minimap --cast "$f" \
+    'seq 1 99; echo "ERROR boom"' >/dev/null
+assert_eq "--minimap: a row of its own" '"height": 3' \
+    "$(head -1 "$f" | grep -o '"height": [0-9]*')"
+assert_eq "--minimap: clean cells across the row but the last" "79" \
+    "$(tail -1 "$f" | grep -o '▁' | wc -l | tr -d ' ')"
+"$SASH" -n 2 --minimap --minimap-error 'boom' --minimap-warn 'nothing' \
+    --cast "$f" 'seq 1 99; echo "ERROR here"' >/dev/null
+assert_eq "--minimap-error: replaces the default" "0" \
+    "$(tail -1 "$f" | grep -c '█' || true)"
+assert_exit "--minimap-error: invalid pattern" 1 "$SASH" --minimap \
+    --minimap-error 'a(' true
+
+# 54. SIGUSR2 re-execs sash without losing or repeating lines
+bin="$TEST_TMPDIR/sash-upgrade"
+f="$TEST_TMPDIR/upgrade.log"
+marker="$TEST_TMPDIR/upgrade.marker"
+cp "$SASH" "$bin"
+"$bin" --stats -w "$f" -W "$f.append" \
+    'seq 1 3000; printf "par"; sleep 1; printf "tial\n"; seq 3001 6000;
+     sleep 1; seq 6001 9000; exit 7' \
+    >/dev/null 2>"$TEST_TMPDIR/upgrade.err" &
+pid=$!
+sleep 0.5
+# the "new version": a wrapper that leaves a mark, then runs sash
+real="$(cd "$(dirname "$SASH")" && pwd)/$(basename "$SASH")"
+rm -f "$bin"
+printf '#!/bin/sh\necho upgraded >> "%s"\nexec "%s" "$@"\n' \
+    "$marker" "$real" > "$bin"
+chmod +x "$bin"
+kill -USR2 "$pid"
+sleep 1
+kill -USR2 "$pid" # now running as $real: a second hand-over
+rc=0
+wait "$pid" || rc=$?
+assert_eq "upgrade: re-exec'd the new binary" "1" \
+    "$(wc -l < "$marker" 2>/dev/null | tr -d ' ' || true)"
+assert_eq "upgrade: every line once, in order" \
+    "$( (seq 1 3000; echo partial; seq 3001 9000) | md5sum)" \
+    "$(md5sum < "$f")"
+assert_eq "upgrade: appended file too" "$(md5sum < "$f")" \
+    "$(md5sum < "$f.append")"
+assert_eq "upgrade: command's exit status kept" "7" "$rc"
+if grep -q "^sash: 9001 lines" "$TEST_TMPDIR/upgrade.err"; then
+    pass "upgrade: counters carried over"
+else
+    fail "upgrade: counters carried over (got '$(cat \
+        "$TEST_TMPDIR/upgrade.err")')"
+fi
+
+# 55. --plugin and --file-plugin transform lines in-process
+plugin="$(dirname "$SASH")/redact.so"
+if [ -f "$plugin" ]; then
+  f="$TEST_TMPDIR/plugin.log"
+  "$SASH" --plugin "$plugin:password=" -w "$f" \
+      'echo "login user=bob password=hunter2 ok"; echo plain' >/dev/null
+  assert_eq "--plugin: value masked in the file" \
+      "login user=bob password=*** ok|plain" "$(paste -sd'|' "$f")"
+  "$SASH" --file-plugin "$plugin:token=" -w "$f.masked" -w "$f.raw" \
+      'echo "token=abc"' >/dev/null
+  assert_eq "--file-plugin: only the next file" "token=***|token=abc" \
+      "$(cat "$f.masked" "$f.raw" | paste -sd'|')"
+  "$SASH" --file-plugin "$plugin:token=" --jsonl "$f.jsonl" \
+      'echo "token=abc"' >/dev/null
+  assert_eq "--file-plugin: jsonl record rebuilt" "1" \
+      "$(grep -c '"token=\*\*\*"' "$f.jsonl" || true)"
+  assert_exit "--plugin: missing keys" 1 "$SASH" --plugin "$plugin" true
+fi
+assert_exit "--plugin: bad path" 1 "$SASH" --plugin /nonexistent.so true
+
+# 56. --stall-after reports what a quiet command is blocked on
+if [ -r /proc/self/stat ]; then
+  f="$TEST_TMPDIR/stall.log"
+  # the report comes at 2.5s and the next would be due at 5s, so "after"
+  # at 3.8s is more than a second from either
+  "$SASH" --stall-after 1.5 -w "$f" 'echo before; sleep 3.8; echo after' \
+      >/dev/null 2>"$TEST_TMPDIR/stall.err"
+  assert_eq "--stall-after: report in the file" "1" \
+      "$(grep -c '^sash: stall: no output for' "$f" || true)"
+  assert_eq "--stall-after: the sleeping child" "1" \
+      "$(grep -c 'sleep: state S' "$f" || true)"
+  assert_eq "--stall-after: output kept in order" "before|after" \
+      "$(grep -v '^sash: stall' "$f" | paste -sd'|')"
+  assert_eq "--stall-after: report on stderr without a tty" "1" \
+      "$(grep -c 'no output for' "$TEST_TMPDIR/stall.err" || true)"
+fi
+assert_exit "--stall-after: needs a command" 1 \
+    sh -c "echo x | '$SASH' --stall-after 1"
+assert_exit "--stall-after: invalid threshold" 1 "$SASH" --stall-after 0 true
+
+# 57. rewriting an indexed file without --index-search drops its index
+f="$TEST_TMPDIR/reindex.log"
+"$SASH" --index-search -w "$f" 'seq 1 1000' >/dev/null
+"$SASH" -w "$f" 'seq 1 1000; for i in $(seq 1 111); do echo zulu123; done' \
+    >/dev/null
+assert_eq "-w: old index removed" "no" \
+    "$([ -e "$f.sidx" ] && echo yes || echo no)"
+assert_eq "--grep: rewritten file searched in full" "111" \
+    "$("$SASH" --grep "$f" zulu123 | wc -l | tr -d ' ')"
+
+# 58. a --ready timeout kills a command that ignores TERM, and a command
+#     exiting 124 isn't taken for a timeout
+rc=0
+err="$("$SASH" --ready never --ready-timeout 0.5 \
+    'trap "" TERM; while :; do sleep 0.1; done; : sash_t58' 2>&1)" || rc=$?
+assert_eq "--ready-timeout: reported as a timeout" \
+    "124 sash: not ready after 0.5 seconds" "$rc $err"
+gone=no
+for _ in $(seq 1 80); do
+  if ! pgrep -f sash_t58 >/dev/null; then
+    gone=yes
+    break
+  fi
+  sleep 0.1
+done
+assert_eq "--ready-timeout: KILL after the grace period" "yes" "$gone"
+pkill -KILL -f sash_t58 || true
+rc=0
+err="$("$SASH" --ready never 'exit 124' 2>&1)" || rc=$?
+assert_eq "--ready: command exiting 124 is not a timeout" \
+    "124 sash: command exited before it was ready" "$rc $err"
+
+# 59. a history backlog is sent a block at a time, in order with live lines
+if command -v python3 >/dev/null 2>&1 && [ -r /proc/self/status ]; then
+    sock="$TEST_TMPDIR/backlog.sock"
+    "$SASH" --history 2M --serve "$sock" --serve-backlog \
+        'seq 1 1000000; sleep 2; seq 1000001 1000010; sleep 5' >/dev/null &
+    pid=$!
+    sleep 1
+    out="$(python3 - "$sock" "$pid" <<'PY'
+import socket, sys, time
+def connect():
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.connect(sys.argv[1])
+    return s
+idle = [connect() for _ in range(20)]
+s = connect()
+time.sleep(2)
+with open("/proc/%s/status" % sys.argv[2]) as f:
+    rss = [int(l.split()[1]) for l in f if l.startswith("VmRSS:")][0]
+s.settimeout(2)
+data = b""
+try:
+    while not data.endswith(b"\n1000010\n"):
+        chunk = s.recv(1 << 16)
+        if not chunk:
+            break
+        data += chunk
+except socket.timeout:
+    pass
+lines = data.split()
+ok = lines == [str(i).encode() for i in range(1, 1000011)]
+print("small" if rss < 64 * 1024 else "rss %d kB" % rss, ok)
+PY
+)"
+    kill -INT "$pid"
+    wait "$pid" || true
+    assert_eq "--serve-backlog: idle clients don't hold the history" \
+        "small True" "$out"
+fi
+
+# 60. an upgrade keeps a --fail-on match and its pending KILL
+f="$TEST_TMPDIR/upgrade-fail.log"
+"$SASH" --fail-on BOOM -w "$f" \
+    'trap "" TERM; echo ok; echo BOOM; while :; do sleep 0.1; done; : sash_t60' \
+    >/dev/null 2>"$TEST_TMPDIR/upgrade-fail.err" &
+pid=$!
+sleep 1
+kill -USR2 "$pid"
+( sleep 15; kill -KILL "$pid" 2>/dev/null ) &
+guard=$!
+rc=0
+wait "$pid" || rc=$?
+kill "$guard" 2>/dev/null || true
+pkill -KILL -f 'sash_t6[0]' || true
+assert_eq "upgrade: --fail-on status and KILL kept" "3" "$rc"
+if grep -q "^sash: --fail-on matched line 2: BOOM" \
+    "$TEST_TMPDIR/upgrade-fail.err"; then
+    pass "upgrade: --fail-on line reported"
+else
+    fail "upgrade: --fail-on line reported (got '$(cat \
+        "$TEST_TMPDIR/upgrade-fail.err")')"
+fi
+
+# 61. a client that fell behind is told how many lines it missed, up to
+#     the last ones dropped before sash exits
+if command -v python3 >/dev/null 2>&1; then
+    sock="$TEST_TMPDIR/slow.sock"
+    "$SASH" --serve "$sock" 'sleep 1; seq 1 500000' >/dev/null &
+    pid=$!
+    out="$(python3 - "$sock" <<'PY'
+import re, socket, sys, time
+s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+for _ in range(100):
+    try:
+        s.connect(sys.argv[1])
+        break
+    except OSError:
+        time.sleep(0.05)
+time.sleep(1.5)
+data = b""
+while True:
+    b = s.recv(1 << 16)
+    if not b:
+        break
+    data += b
+seen = dropped = 0
+for line in data.decode().splitlines():
+    m = re.match(r"\u2026 (\d+) lines dropped$", line)
+    if m:
+        dropped += int(m.group(1))
+    else:
+        seen += 1
+print("dropped" if dropped else "none dropped", seen + dropped)
+PY
+)"
+    wait "$pid" || true
+    assert_eq "--serve: every dropped line accounted for" "dropped 500000" \
+        "$out"
+fi
+
+# 62. a command that ignores TERM is killed after sash is terminated
+"$SASH" 'trap "" TERM; echo up; while :; do sleep 0.1; done; : sash_t62' \
+    >/dev/null 2>&1 &
+pid=$!
+sleep 0.5
+kill -TERM "$pid"
+( sleep 15; kill -KILL "$pid" 2>/dev/null ) &
+guard=$!
+rc=0
+wait "$pid" || rc=$?
+kill "$guard" 2>/dev/null || true
+pkill -KILL -f 'sash_t6[2]' || true
+assert_eq "SIGTERM: command ignoring TERM killed, sash exits 143" "143" "$rc"
+
+# 63. --follow-dir follows a name that another file is renamed over
+d="$TEST_TMPDIR/rotate"
+f="$TEST_TMPDIR/rotate.log"
+mkdir -p "$d"
+echo "old" > "$d/app.log"
+"$SASH" -f --glob '*.log' --follow-dir "$d" -W "$f" >/dev/null 2>&1 &
+pid=$!
+for _ in $(seq 1 100); do
+    echo "one" >> "$d/app.log"
+    grep -q '^one' "$f" 2>/dev/null && break
+    sleep 0.1
+done
+echo "two" > "$d/app.tmp"
+mv "$d/app.tmp" "$d/app.log"
+echo "three" >> "$d/app.log"
+for _ in $(seq 1 100); do
+    grep -q '^three' "$f" 2>/dev/null && break
+    sleep 0.1
+done
+kill -INT "$pid"
+wait "$pid" || true
+assert_eq "--follow-dir: new file renamed over a followed name" "two|three" \
+    "$(grep -v '^one' "$f" | paste -sd'|')"
+
+# 64. lines another program appends to an indexed -W file are found
+f="$TEST_TMPDIR/shared.log"
+: > "$f"
+"$SASH" --index-search -W "$f" "for i in 1 2 3; do seq 1 3000; sleep 0.3; \
+    echo other_writer_\$i >> '$f'; sleep 0.3; done; echo last" >/dev/null
+got="$("$SASH" --grep "$f" other_writer_ | paste -sd'|')"
+assert_eq "-W index: other writers' lines found" \
+    "other_writer_1|other_writer_2|other_writer_3" "$got"
+assert_eq "-W index: own lines found" "last" \
+    "$("$SASH" --grep "$f" last)"
+assert_eq "-W index: nothing lost" "9004" "$(wc -l <"$f" | tr -d ' ')"
+
 echo ""
 echo "=== Results: $PASS/$TOTAL passed, $FAIL failed ==="
 
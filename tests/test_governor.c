@@ -0,0 +1,129 @@
+/*
+ * test_governor.c - Unit tests for the CPU budget governor
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+
+#include "../governor.c"
+#include "../governor.h"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_true(const char *desc, int cond) {
+  if (cond) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    fail_count++;
+  }
+}
+
+#define MS 1000000ULL
+
+static uint64_t g_cpu, g_now;
+
+/* Advance 250 ms of wall time at the given CPU usage and sample. */
+static bool tick(Governor *g, double usage) {
+  g_now += 250 * MS;
+  g_cpu += (uint64_t)(usage * 250 * MS);
+  return governor_sample(g, g_cpu, g_now);
+}
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== governor unit tests ===\n\n");
+
+  /* -- Under budget: stays at full fidelity -- */
+  {
+    Governor g;
+    g_cpu = g_now = 0;
+    governor_init(&g, 0.05, g_cpu, g_now);
+    bool changed = false;
+    for (int i = 0; i < 20; i++)
+      changed |= tick(&g, 0.03);
+    assert_true("under budget: level 0", g.level == 0 && !changed);
+  }
+
+  /* -- Over budget: one step per decision, capped -- */
+  {
+    Governor g;
+    g_cpu = g_now = 0;
+    governor_init(&g, 0.05, g_cpu, g_now);
+    assert_true("over budget: first sample steps up", tick(&g, 0.5));
+    assert_true("over budget: level 1", g.level == 1);
+    for (int i = 0; i < 20; i++)
+      tick(&g, 0.5);
+    assert_true("over budget: capped at max", g.level == GOV_MAX_LEVEL);
+    assert_true("over budget: peak recorded", g.peak == GOV_MAX_LEVEL);
+  }
+
+  /* -- Settles at the first level that fits -- */
+  {
+    Governor g;
+    g_cpu = g_now = 0;
+    governor_init(&g, 0.05, g_cpu, g_now);
+    static const double cost[] = {0.4, 0.1, 0.04, 0.01};
+    for (int i = 0; i < 40; i++)
+      tick(&g, cost[g.level]);
+    assert_true("settles: level 2", g.level == 2);
+  }
+
+  /* -- Recovery needs a whole calm window per step -- */
+  {
+    Governor g;
+    g_cpu = g_now = 0;
+    governor_init(&g, 0.05, g_cpu, g_now);
+    for (int i = 0; i < GOV_MAX_LEVEL; i++)
+      tick(&g, 0.5);
+    int top = g.level;
+    for (int i = 0; i < GOV_SAMPLES - 1; i++)
+      tick(&g, 0.0);
+    assert_true("recovery: not after a partial window", g.level == top);
+    tick(&g, 0.0);
+    assert_true("recovery: one step after a calm window", g.level == top - 1);
+    for (int i = 0; i < 4 * GOV_SAMPLES; i++)
+      tick(&g, 0.0);
+    assert_true("recovery: back to full fidelity", g.level == 0);
+  }
+
+  /* -- Between half and full budget: hold the level -- */
+  {
+    Governor g;
+    g_cpu = g_now = 0;
+    governor_init(&g, 0.05, g_cpu, g_now);
+    tick(&g, 0.5);
+    for (int i = 0; i < 20; i++)
+      tick(&g, 0.04);
+    assert_true("hysteresis: level held", g.level == 1);
+  }
+
+  /* -- Parsing -- */
+  {
+    double f = 0;
+    assert_true("parse: 5%", parse_percent("5%", &f) && f == 0.05);
+    assert_true("parse: bare number", parse_percent("50", &f) && f == 0.5);
+    assert_true("parse: fraction of percent",
+                parse_percent("2.5%", &f) && f == 0.025);
+    assert_true("parse: zero rejected", !parse_percent("0", &f));
+    assert_true("parse: junk rejected", !parse_percent("5x", &f));
+    assert_true("parse: empty rejected", !parse_percent("", &f));
+  }
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
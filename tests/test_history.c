@@ -0,0 +1,196 @@
+/*
+ * test_history.c - Unit tests for the compressed line history
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../history.c"
+#include "../history.h"
+#include "../lz.c"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_eq_u64(const char *desc, unsigned long long expected,
+                          unsigned long long actual) {
+  if (expected == actual) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    printf("    expected: %llu, got: %llu\n", expected, actual);
+    fail_count++;
+  }
+}
+
+static void assert_true(const char *desc, int cond) {
+  if (cond) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    fail_count++;
+  }
+}
+
+static size_t make_line(char *buf, size_t cap, uint64_t i) {
+  return (size_t)snprintf(buf, cap,
+                          "2024-05-01 12:00:%02llu INFO line %llu ok\n",
+                          (unsigned long long)(i % 60),
+                          (unsigned long long)i);
+}
+
+/* Checks that lines arrive in order, numbered from `next`. */
+typedef struct {
+  uint64_t next;
+  uint64_t seen;
+  bool ok;
+  uint64_t stop_after;
+} Check;
+
+static bool check_line(const char *line, size_t len, void *ctx) {
+  Check *c = ctx;
+  char want[128];
+  size_t n = make_line(want, sizeof(want), c->next);
+  if (len != n || memcmp(line, want, n) != 0)
+    c->ok = false;
+  c->next++;
+  c->seen++;
+  return c->seen != c->stop_after;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== history unit tests ===\n\n");
+
+  char line[128];
+
+  /* -- Small history stays in the hot block -- */
+  {
+    History *h = history_new(1000);
+    for (uint64_t i = 0; i < 10; i++)
+      history_push(h, line, make_line(line, sizeof(line), i));
+    Check c = {.ok = true};
+    history_each(h, 0, check_line, &c);
+    assert_eq_u64("hot: all lines", 10, c.seen);
+    assert_true("hot: in order", c.ok);
+    HistoryStats st;
+    history_stats(h, &st);
+    assert_eq_u64("hot: nothing sealed", 0, st.blocks);
+    history_free(h);
+  }
+
+  /* -- Deep history: sealed blocks, eviction, compression -- */
+  {
+    const uint64_t keep = 200000, total = 500000;
+    History *h = history_new(keep);
+    for (uint64_t i = 0; i < total; i++)
+      history_push(h, line, make_line(line, sizeof(line), i));
+    HistoryStats st;
+    history_stats(h, &st);
+    assert_true("deep: keeps at least N lines", st.lines >= keep);
+    /* one sealed block past N, plus the hot block */
+    assert_true("deep: keeps at most N plus two blocks",
+                st.lines < keep + 2 * HISTORY_BLOCK_SIZE / 30);
+    assert_eq_u64("deep: evicted + kept = pushed", total,
+                  st.evicted + st.lines);
+    assert_true("deep: stored in a quarter of the text",
+                st.stored_bytes * 4 < st.raw_bytes);
+
+    Check c = {.next = st.evicted, .ok = true};
+    assert_true("deep: walk succeeds", history_each(h, 0, check_line, &c));
+    assert_eq_u64("deep: walk sees every line", st.lines, c.seen);
+    assert_true("deep: lines intact and in order", c.ok);
+
+    /* start in the middle of a sealed block */
+    uint64_t from = st.lines - 12345;
+    Check m = {.next = st.evicted + from, .ok = true};
+    history_each(h, from, check_line, &m);
+    assert_eq_u64("from: sees the tail", 12345, m.seen);
+    assert_true("from: starts at the right line", m.ok);
+
+    Check s = {.next = st.evicted, .ok = true, .stop_after = 5};
+    assert_true("stop: reported", !history_each(h, 0, check_line, &s));
+    assert_eq_u64("stop: callback ends the walk", 5, s.seen);
+
+    /* a block at a time, starting inside the first */
+    Check b = {.next = st.evicted + 7, .ok = true};
+    uint64_t at = 7, steps = 0;
+    size_t n;
+    while ((n = history_each_block(h, at, check_line, &b)) > 0) {
+      at += n;
+      steps++;
+    }
+    assert_eq_u64("block: walk sees every line", st.lines - 7, b.seen);
+    assert_true("block: lines intact and in order", b.ok);
+    assert_eq_u64("block: one step per block and the hot one",
+                  st.blocks + 1, steps);
+    assert_eq_u64("block: nothing past the end", 0,
+                  history_each_block(h, st.lines, check_line, &b));
+    history_free(h);
+  }
+
+  /* -- Lines longer than a block, unterminated lines -- */
+  {
+    History *h = history_new(10);
+    size_t big = HISTORY_BLOCK_SIZE * 2;
+    char *buf = malloc(big);
+    memset(buf, 'z', big);
+    history_push(h, "a", 1);
+    history_push(h, buf, big);
+    history_push(h, "b\n", 2);
+    FILE *out = tmpfile();
+    history_each(h, 0, write_line, out);
+    long n = ftell(out);
+    assert_eq_u64("long: bytes with newlines added", 2 + big + 1 + 2,
+                  (unsigned long long)n);
+    fclose(out);
+    free(buf);
+    history_free(h);
+  }
+
+  /* -- Dump to a file -- */
+  {
+    char path[256];
+    snprintf(path, sizeof(path), "/tmp/sash_test_history_%d",
+             (int)getpid());
+    History *h = history_new(100000);
+    for (uint64_t i = 0; i < 50000; i++)
+      history_push(h, line, make_line(line, sizeof(line), i));
+    assert_true("write: succeeds", history_write(h, path));
+    FILE *f = fopen(path, "r");
+    uint64_t lines = 0;
+    bool ok = true;
+    char got[128];
+    while (f && fgets(got, sizeof(got), f)) {
+      make_line(line, sizeof(line), lines++);
+      if (strcmp(got, line) != 0)
+        ok = false;
+    }
+    if (f)
+      fclose(f);
+    assert_eq_u64("write: every line", 50000, lines);
+    assert_true("write: content matches", ok);
+    unlink(path);
+    history_free(h);
+  }
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
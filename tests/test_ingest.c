@@ -0,0 +1,195 @@
+/*
+ * test_ingest.c - Unit tests for the threaded reader ring
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* a small ring so producers keep running into a full one */
+#define INGEST_RING_SLOTS 8
+#include "../ingest.c"
+#include "../ingest.h"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_eq_u64(const char *desc, unsigned long long expected,
+                          unsigned long long actual) {
+  if (expected == actual) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    printf("    expected: %llu, got: %llu\n", expected, actual);
+    fail_count++;
+  }
+}
+
+static void assert_true(const char *desc, int cond) {
+  if (cond) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    fail_count++;
+  }
+}
+
+/* ── Ring under contention ───────────────────────────────────────── */
+
+#define PRODUCERS 4
+#define PER_PRODUCER 20000
+
+static void *producer(void *arg) {
+  int id = (int)(intptr_t)arg;
+  for (uint32_t i = 0; i < PER_PRODUCER; i++) {
+    IngestBatch *b = malloc(sizeof(*b));
+    *b = (IngestBatch){.source = id, .nlines = i};
+    while (!ring_push(b))
+      sched_yield();
+  }
+  return NULL;
+}
+
+static void test_ring(void) {
+  ring_init();
+  pthread_t t[PRODUCERS];
+  for (int i = 0; i < PRODUCERS; i++)
+    pthread_create(&t[i], NULL, producer, (void *)(intptr_t)i);
+
+  uint32_t next[PRODUCERS] = {0};
+  unsigned long long total = 0, out_of_order = 0;
+  while (total < PRODUCERS * PER_PRODUCER) {
+    IngestBatch *b = ring_pop();
+    if (!b) {
+      sched_yield();
+      continue;
+    }
+    if (b->nlines != next[b->source])
+      out_of_order++;
+    next[b->source] = b->nlines + 1;
+    total++;
+    free(b);
+  }
+  for (int i = 0; i < PRODUCERS; i++)
+    pthread_join(t[i], NULL);
+
+  assert_eq_u64("ring: every batch popped", PRODUCERS * PER_PRODUCER, total);
+  assert_eq_u64("ring: per-producer order kept", 0, out_of_order);
+  assert_true("ring: empty afterwards", ring_pop() == NULL);
+}
+
+/* ── Readers end to end ──────────────────────────────────────────── */
+
+#define NFILES 6
+#define LINES_PER_FILE 30000
+
+typedef struct {
+  unsigned long long lines[NFILES];
+  unsigned long long bad[NFILES];
+  unsigned long long long_lines;
+  unsigned long long tails;
+} Seen;
+
+static void on_batch(const IngestBatch *b, void *ctx) {
+  Seen *seen = ctx;
+  uint32_t start = 0;
+  for (uint32_t i = 0; i < b->nlines; i++) {
+    const char *line = b->data + start;
+    size_t len = b->ends[i] - start;
+    start = b->ends[i];
+    if (len > 100000) {
+      seen->long_lines++;
+      continue;
+    }
+    if (len >= 4 && memcmp(line, "tail", 4) == 0) {
+      seen->tails += line[len - 1] != '\n';
+      continue;
+    }
+    char expect[64];
+    int n = snprintf(expect, sizeof(expect), "%d line %llu\n", b->source,
+                     seen->lines[b->source]);
+    if ((size_t)n != len || memcmp(line, expect, len) != 0)
+      seen->bad[b->source]++;
+    seen->lines[b->source]++;
+  }
+}
+
+static void test_readers(int nthreads) {
+  char path[NFILES][64];
+  int fds[NFILES];
+  char *big = malloc(200001);
+  memset(big, 'x', 200000);
+  big[200000] = '\n';
+  for (int f = 0; f < NFILES; f++) {
+    snprintf(path[f], sizeof(path[f]), "/tmp/sash_test_ingest_%d_%d",
+             (int)getpid(), f);
+    FILE *fp = fopen(path[f], "w");
+    for (int i = 0; i < LINES_PER_FILE; i++) {
+      fprintf(fp, "%d line %d\n", f, i);
+      if (f == 0 && i == LINES_PER_FILE / 2)
+        fwrite(big, 1, 200001, fp); /* longer than one read */
+    }
+    fputs("tail", fp); /* unterminated */
+    fclose(fp);
+    fds[f] = open(path[f], O_RDONLY);
+  }
+  free(big);
+
+  Seen seen;
+  memset(&seen, 0, sizeof(seen));
+  bool ok = ingest_start(fds, NFILES, nthreads);
+  while (ok) {
+    struct pollfd pfd = {.fd = ingest_fd(), .events = POLLIN};
+    poll(&pfd, 1, 1000);
+    ok = ingest_drain(on_batch, &seen, 1000000);
+  }
+  ingest_stop();
+
+  char desc[96];
+  unsigned long long lines = 0, bad = 0;
+  for (int f = 0; f < NFILES; f++) {
+    lines += seen.lines[f];
+    bad += seen.bad[f];
+    close(fds[f]);
+    unlink(path[f]);
+  }
+  snprintf(desc, sizeof(desc), "%d threads: every line delivered", nthreads);
+  assert_eq_u64(desc, NFILES * LINES_PER_FILE, lines);
+  snprintf(desc, sizeof(desc), "%d threads: in order within each file",
+           nthreads);
+  assert_eq_u64(desc, 0, bad);
+  snprintf(desc, sizeof(desc), "%d threads: long line kept whole", nthreads);
+  assert_eq_u64(desc, 1, seen.long_lines);
+  snprintf(desc, sizeof(desc), "%d threads: unterminated tails", nthreads);
+  assert_eq_u64(desc, NFILES, seen.tails);
+}
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== ingest unit tests ===\n\n");
+
+  test_ring();
+  test_readers(1);
+  test_readers(3);
+  test_readers(NFILES);
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * test_jsonl.c - Unit tests for JSON string escaping
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../jsonl.c"
+#include "../jsonl.h"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_escape(const char *desc, const char *in, size_t len,
+                          const char *expected) {
+  char *out = malloc(JSON_ESCAPE_MAX(len) + 1);
+  size_t n = json_escape(out, in, len);
+  out[n] = '\0';
+  if (n == strlen(expected) && memcmp(out, expected, n) == 0) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    printf("    expected: \"%s\"\n", expected);
+    printf("    got:      \"%s\"\n", out);
+    fail_count++;
+  }
+  free(out);
+}
+
+#define ESC(desc, in, expected)                                                \
+  assert_escape(desc, in, sizeof(in) - 1, expected)
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== jsonl unit tests ===\n\n");
+
+  /* -- Plain text takes the fast path -- */
+  ESC("empty", "", "");
+  ESC("short ascii", "hi", "hi");
+  ESC("long ascii", "the quick brown fox jumps over the lazy dog",
+      "the quick brown fox jumps over the lazy dog");
+
+  /* -- Escapes, at every position within a word -- */
+  ESC("quote", "say \"hi\"", "say \\\"hi\\\"");
+  ESC("backslash", "C:\\path", "C:\\\\path");
+  ESC("short escapes", "a\tb\r\n\b\f", "a\\tb\\r\\n\\b\\f");
+  ESC("control byte", "bell\a!", "bell\\u0007!");
+  ESC("escape byte", "\033[31mred", "\\u001b[31mred");
+  ESC("nul byte", "a\0b", "a\\u0000b");
+  ESC("quote at byte 7", "1234567\"9", "1234567\\\"9");
+  ESC("quote at byte 8", "12345678\"", "12345678\\\"");
+  ESC("del passes through", "a\x7f", "a\x7f");
+
+  /* -- UTF-8 -- */
+  ESC("valid 2-byte", "caf\xc3\xa9", "caf\xc3\xa9");
+  ESC("valid 3-byte", "\xe2\x80\xa6 more", "\xe2\x80\xa6 more");
+  ESC("valid 4-byte", "ok \xf0\x9f\x98\x80!", "ok \xf0\x9f\x98\x80!");
+  ESC("sequence across words", "1234567\xc3\xa9xyz", "1234567\xc3\xa9xyz");
+  ESC("stray continuation", "a\x80z", "a\\ufffdz");
+  ESC("latin-1 byte", "caf\xe9!", "caf\\ufffd!");
+  ESC("truncated at end", "ab\xe2\x80", "ab\\ufffd\\ufffd");
+  ESC("overlong", "\xc0\xaf", "\\ufffd\\ufffd");
+  ESC("surrogate", "\xed\xa0\x80", "\\ufffd\\ufffd\\ufffd");
+  ESC("past U+10FFFF", "\xf4\x90\x80\x80", "\\ufffd\\ufffd\\ufffd\\ufffd");
+
+  /* -- Worst case fits the bound -- */
+  {
+    char in[64];
+    memset(in, 0x01, sizeof(in));
+    char *out = malloc(JSON_ESCAPE_MAX(sizeof(in)));
+    size_t n = json_escape(out, in, sizeof(in));
+    if (n == JSON_ESCAPE_MAX(sizeof(in))) {
+      printf("  PASS: %s\n", "worst case fills the bound exactly");
+      pass_count++;
+    } else {
+      printf("  FAIL: %s\n", "worst case fills the bound exactly");
+      fail_count++;
+    }
+    free(out);
+  }
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
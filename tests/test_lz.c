@@ -0,0 +1,126 @@
+/*
+ * test_lz.c - Unit tests for the LZ77 block codec
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../lz.c"
+#include "../lz.h"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_true(const char *desc, int cond) {
+  if (cond) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    fail_count++;
+  }
+}
+
+/* Compress and decompress; returns the compressed size, or 0 on a
+   mismatch. */
+static size_t round_trip(const char *src, size_t n) {
+  char *comp = malloc(LZ_BOUND(n));
+  char *out = malloc(n + 1);
+  size_t clen = lz_compress(src, n, comp);
+  bool ok = clen <= LZ_BOUND(n) && lz_decompress(comp, clen, out, n) &&
+            memcmp(src, out, n) == 0;
+  free(comp);
+  free(out);
+  return ok ? clen : 0;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== lz unit tests ===\n\n");
+
+  /* -- Edge sizes -- */
+  assert_true("empty input", round_trip("", 0) > 0);
+  assert_true("one byte", round_trip("x", 1) > 0);
+  assert_true("shorter than a match", round_trip("abcabcabcab", 11) > 0);
+  assert_true("long run", round_trip(memset(malloc(100000), 'a', 100000),
+                                     100000) < 1000);
+
+  /* -- Log-like text compresses well -- */
+  {
+    size_t cap = 64 * 1024, n = 0;
+    char *buf = malloc(cap);
+    for (int i = 0; n + 100 < cap; i++)
+      n += (size_t)snprintf(buf + n, cap - n,
+                            "2024-05-01T12:%02d:%02d INFO worker[%d]: "
+                            "request %d done in %d ms\n",
+                            i / 60 % 60, i % 60, i % 8, i, i * 7 % 300);
+    size_t clen = round_trip(buf, n);
+    assert_true("log text round-trips", clen > 0);
+    assert_true("log text shrinks at least 3x", clen > 0 && clen * 3 < n);
+    free(buf);
+  }
+
+  /* -- Random data round-trips within the bound -- */
+  {
+    bool ok = true;
+    srand(1);
+    for (size_t n = 1; n < 70000; n = n * 3 + 7) {
+      char *buf = malloc(n);
+      for (size_t i = 0; i < n; i++)
+        buf[i] = (char)(rand() % 4 == 0 ? 'x' : rand());
+      if (round_trip(buf, n) == 0) {
+        printf("    size %zu\n", n);
+        ok = false;
+      }
+      free(buf);
+    }
+    assert_true("random data round-trips", ok);
+  }
+
+  /* -- Corrupt input is rejected, not overrun -- */
+  {
+    const char *text = "abcdefgh abcdefgh abcdefgh abcdefgh abcdefgh end\n";
+    size_t n = strlen(text);
+    char comp[LZ_BOUND(64)], out[64];
+    size_t clen = lz_compress(text, n, comp);
+    assert_true("wrong length rejected",
+                !lz_decompress(comp, clen, out, n - 1));
+    assert_true("truncated block rejected",
+                !lz_decompress(comp, clen - 3, out, n));
+    bool all_safe = true;
+    srand(2);
+    for (int k = 0; k < 2000; k++) {
+      char bad[LZ_BOUND(64)];
+      memcpy(bad, comp, clen);
+      bad[rand() % clen] = (char)rand();
+      /* must return without touching out past n */
+      char guard[80];
+      memset(guard, 0x5a, sizeof(guard));
+      lz_decompress(bad, clen, guard, n);
+      for (size_t i = n; i < sizeof(guard); i++)
+        if (guard[i] != 0x5a)
+          all_safe = false;
+    }
+    assert_true("mutated blocks stay in bounds", all_safe);
+    char zero_off[] = {0x04, 'a', 0x00, 0x00, 0x00, 'b'};
+    assert_true("zero offset rejected",
+                !lz_decompress(zero_off, sizeof(zero_off), out, 10));
+  }
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
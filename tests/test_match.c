@@ -0,0 +1,115 @@
+/*
+ * test_match.c - Unit tests for the prefiltered line matcher
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../match.c"
+#include "../match.h"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_true(const char *desc, int cond) {
+  if (cond) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    fail_count++;
+  }
+}
+
+/* Check the literals chosen for the prefilter ("" = none). */
+static void check_prefilter(const char *desc, const char *pattern,
+                            const char *expected) {
+  Matcher m;
+  if (!matcher_init(&m, pattern)) {
+    assert_true(desc, 0);
+    return;
+  }
+  char got[256] = "";
+  for (int k = 0; k < m.nliterals; k++) {
+    if (k > 0)
+      strcat(got, ",");
+    strncat(got, m.literals[k], m.literal_lens[k]);
+  }
+  if (strcmp(got, expected) != 0)
+    printf("    expected \"%s\", got \"%s\"\n", expected, got);
+  assert_true(desc, strcmp(got, expected) == 0);
+  matcher_free(&m);
+}
+
+static void check_match(const char *desc, const char *pattern,
+                        const char *line, bool expected) {
+  Matcher m;
+  if (!matcher_init(&m, pattern)) {
+    assert_true(desc, 0);
+    return;
+  }
+  assert_true(desc, matcher_match(&m, line, strlen(line)) == expected);
+  matcher_free(&m);
+}
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== match unit tests ===\n\n");
+
+  /* -- Prefilter extraction -- */
+  check_prefilter("plain literal", "FATAL", "FATAL");
+  check_prefilter("alternatives", "FATAL|No space left on device",
+                  "FATAL,No space left on device");
+  check_prefilter("longest run wins", "err.*timed out", "timed out");
+  check_prefilter("optional char excluded", "colou?r", "colo");
+  check_prefilter("plus keeps one copy", "ab+c", "ab");
+  check_prefilter("escaped punctuation is literal", "1\\.0\\.2", "1.0.2");
+  check_prefilter("class escape breaks run", "id\\w+end", "end");
+  check_prefilter("bracket breaks run", "[Ee]rror: disk", "rror: disk");
+  check_prefilter("group skipped", "(foo|bar)baz", "baz");
+  check_prefilter("character class in bracket", "[[:digit:]]x", "x");
+  check_prefilter("class among other members", "[a[:space:]b]FATAL",
+                  "FATAL");
+  check_prefilter("equivalence class", "[[=e=]]rror", "rror");
+  check_prefilter("collating symbol", "[[.-.]]done", "done");
+  check_prefilter("negated class", "[^[:alnum:]]end", "end");
+  check_prefilter("alternative without literal disables", "FATAL|.*", "");
+  check_prefilter("anchors break runs", "^abc$", "abc");
+
+  /* -- Matching -- */
+  check_match("match literal", "FATAL", "2024 FATAL: boom\n", true);
+  check_match("no match", "FATAL", "all good\n", false);
+  check_match("second alternative", "FATAL|No space",
+              "write: No space left on device\n", true);
+  check_match("regex after prefilter passes", "err.*timed out",
+              "timed out before err\n", false);
+  check_match("regex match", "err.*timed out", "err: request timed out\n",
+              true);
+  check_match("$ anchors before newline", "done$", "all done\n", true);
+  check_match("group alternatives", "(foo|bar)baz", "xbarbaz\n", true);
+  check_match("optional char", "colou?r", "color\n", true);
+  check_match("character class", "[[:digit:]]x", "5x\n", true);
+  check_match("character class mismatch", "[[:digit:]]x", "ax\n", false);
+  check_match("space class", "[[:space:]]FATAL", "log: FATAL\n", true);
+
+  {
+    Matcher m;
+    assert_true("invalid pattern rejected", !matcher_init(&m, "a("));
+  }
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * test_minimap.c - Unit tests for the error-density strip
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../minimap.c"
+#include "../minimap.h"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_eq_u64(const char *desc, unsigned long long expected,
+                          unsigned long long actual) {
+  if (expected == actual) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    printf("    expected: %llu, got: %llu\n", expected, actual);
+    fail_count++;
+  }
+}
+
+static void assert_true(const char *desc, int cond) {
+  if (cond) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    fail_count++;
+  }
+}
+
+static MinimapBucket total(const Minimap *m) {
+  MinimapBucket t = {0, 0, 0};
+  for (size_t i = 0; i < m->nbuckets; i++) {
+    t.lines += m->buckets[i].lines;
+    t.warnings += m->buckets[i].warnings;
+    t.errors += m->buckets[i].errors;
+  }
+  return t;
+}
+
+/* Index of the n-th cell (0-based) in a rendered row without color. */
+static const char *cell(const char *row, int n) { return row + 3 * n; }
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== minimap unit tests ===\n\n");
+
+  static Minimap m;
+  char row[MINIMAP_ROW_MAX(100)];
+
+  /* -- Empty -- */
+  minimap_init(&m);
+  assert_eq_u64("empty: renders nothing", 0,
+                minimap_render(&m, 80, false, row));
+
+  /* -- One bucket per line until full -- */
+  for (int i = 0; i < MINIMAP_BUCKETS; i++)
+    minimap_add(&m, MINIMAP_CLEAN);
+  assert_eq_u64("fill: a bucket per line", MINIMAP_BUCKETS, m.nbuckets);
+  assert_eq_u64("fill: span still 1", 1, m.span);
+
+  /* -- The next line merges pairs -- */
+  minimap_add(&m, MINIMAP_ERROR);
+  assert_eq_u64("merge: half the buckets plus one", MINIMAP_BUCKETS / 2 + 1,
+                m.nbuckets);
+  assert_eq_u64("merge: span doubles", 2, m.span);
+  assert_eq_u64("merge: the error lands last", 1,
+                m.buckets[m.nbuckets - 1].errors);
+
+  /* -- Totals survive many merges -- */
+  minimap_init(&m);
+  for (int i = 0; i < 1000000; i++)
+    minimap_add(&m, i % 100 == 0 ? MINIMAP_ERROR
+                    : i % 10 == 0 ? MINIMAP_WARN
+                                  : MINIMAP_CLEAN);
+  MinimapBucket t = total(&m);
+  assert_eq_u64("long: every line counted", 1000000, t.lines);
+  assert_eq_u64("long: every error counted", 10000, t.errors);
+  assert_eq_u64("long: every warning counted", 90000, t.warnings);
+  assert_true("long: buckets bounded", m.nbuckets <= MINIMAP_BUCKETS &&
+                                           m.nbuckets > MINIMAP_BUCKETS / 2);
+  assert_true("long: span a power of two", (m.span & (m.span - 1)) == 0);
+
+  /* -- Rendering: width, placement and density -- */
+  minimap_init(&m);
+  for (int i = 0; i < 10000; i++) /* errors only in the last tenth */
+    minimap_add(&m, i >= 9000 ? MINIMAP_ERROR : MINIMAP_CLEAN);
+  size_t n = minimap_render(&m, 20, false, row);
+  assert_eq_u64("render: three bytes a cell", 60, n);
+  assert_true("render: clean start is the lowest bar",
+              memcmp(cell(row, 0), "\xe2\x96\x81", 3) == 0);
+  assert_true("render: all-error end is a full-height bar",
+              memcmp(cell(row, 19), "\xe2\x96\x88", 3) == 0);
+  n = minimap_render(&m, 20, true, row);
+  assert_true("render: errors in red", strstr(row, "\033[31m") != NULL);
+  assert_true("render: reset at the end",
+              n >= 4 && memcmp(row + n - 4, "\033[0m", 4) == 0);
+
+  /* -- A short run stretches across the row -- */
+  minimap_init(&m);
+  minimap_add(&m, MINIMAP_CLEAN);
+  minimap_add(&m, MINIMAP_WARN);
+  n = minimap_render(&m, 10, true, row);
+  assert_true("short: first half clean, second warning",
+              strstr(row, "\033[90m") < strstr(row, "\033[33m"));
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
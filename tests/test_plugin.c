@@ -0,0 +1,208 @@
+/*
+ * test_plugin.c - Unit tests for the line plugin pipeline
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../plugin.c"
+#include "../plugin.h"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_eq_u64(const char *desc, unsigned long long expected,
+                          unsigned long long actual) {
+  if (expected == actual) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    printf("    expected: %llu, got: %llu\n", expected, actual);
+    fail_count++;
+  }
+}
+
+static void assert_true(const char *desc, int cond) {
+  if (cond) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    fail_count++;
+  }
+}
+
+static bool line_is(const sash_line *l, const char *s) {
+  return l->len == strlen(s) && memcmp(l->ptr, s, l->len) == 0;
+}
+
+/* ── Built-in stages ─────────────────────────────────────────────── */
+
+static int g_calls = 0;
+static size_t g_last_n = 0;
+
+/* Drops lines containing ARGS. */
+static void *drop_init(const char *args) { return strdup(args); }
+
+static void drop_process(void *state, sash_line *lines, size_t n,
+                         sash_arena *arena) {
+  (void)arena;
+  g_calls++;
+  g_last_n = n;
+  for (size_t i = 0; i < n; i++)
+    if (memmem(lines[i].ptr, lines[i].len, state, strlen(state)))
+      lines[i].flags |= SASH_LINE_DROP;
+}
+
+static void drop_fini(void *state) { free(state); }
+
+static const sash_plugin drop_plugin = {
+    SASH_PLUGIN_ABI_VERSION, "drop", drop_init, drop_process, drop_fini,
+};
+
+/* Upper-cases kept lines into the arena. */
+static void upper_process(void *state, sash_line *lines, size_t n,
+                          sash_arena *arena) {
+  (void)state;
+  for (size_t i = 0; i < n; i++) {
+    if (lines[i].flags & SASH_LINE_DROP)
+      continue;
+    char *out = arena->alloc(arena, lines[i].len);
+    for (size_t j = 0; j < lines[i].len; j++)
+      out[j] = (char)toupper((unsigned char)lines[i].ptr[j]);
+    lines[i].ptr = out;
+  }
+}
+
+static const sash_plugin upper_plugin = {
+    SASH_PLUGIN_ABI_VERSION, "upper", NULL, upper_process, NULL,
+};
+
+/* Marks lines starting with "E" as errors. */
+static void classify_process(void *state, sash_line *lines, size_t n,
+                             sash_arena *arena) {
+  (void)state;
+  (void)arena;
+  for (size_t i = 0; i < n; i++)
+    if (lines[i].len > 0 && lines[i].ptr[0] == 'E')
+      lines[i].flags |= SASH_LINE_ERROR;
+}
+
+static const sash_plugin classify_plugin = {
+    SASH_PLUGIN_ABI_VERSION, "classify", NULL, classify_process, NULL,
+};
+
+/* Allocates more than a chunk per line. */
+static void big_process(void *state, sash_line *lines, size_t n,
+                        sash_arena *arena) {
+  (void)state;
+  for (size_t i = 0; i < n; i++)
+    memset(arena->alloc(arena, ARENA_CHUNK + 1), 'x', ARENA_CHUNK + 1);
+  (void)lines;
+}
+
+static const sash_plugin big_plugin = {
+    SASH_PLUGIN_ABI_VERSION, "big", NULL, big_process, NULL,
+};
+
+static void *fail_init(const char *args) {
+  (void)args;
+  return NULL;
+}
+
+static const sash_plugin fail_plugin = {
+    SASH_PLUGIN_ABI_VERSION, "fail", fail_init, drop_process, NULL,
+};
+
+static size_t chunk_count(const Pipeline *p) {
+  size_t n = 0;
+  for (const ArenaChunk *c = p->arena.chunks; c; c = c->next)
+    n++;
+  return n;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== plugin unit tests ===\n\n");
+
+  /* -- Stages run in order over the whole batch -- */
+  {
+    Pipeline p = {0};
+    assert_true("add drop", pipeline_add(&p, &drop_plugin, "debug", NULL));
+    assert_true("add upper", pipeline_add(&p, &upper_plugin, NULL, NULL));
+    assert_true("add classify", pipeline_add(&p, &classify_plugin, "", NULL));
+
+    const char *text[] = {"error: disk\n", "debug: noise\n", "ok\n"};
+    sash_line lines[3];
+    for (int i = 0; i < 3; i++)
+      lines[i] = (sash_line){text[i], strlen(text[i]), 0};
+    pipeline_run(&p, lines, 3);
+
+    assert_eq_u64("one call per stage per batch", 1,
+                  (unsigned long long)g_calls);
+    assert_eq_u64("stage sees the whole batch", 3,
+                  (unsigned long long)g_last_n);
+    assert_true("dropped line flagged", lines[1].flags & SASH_LINE_DROP);
+    assert_true("dropped line not rewritten", lines[1].ptr == text[1]);
+    assert_true("kept line rewritten", line_is(&lines[0], "ERROR: DISK\n"));
+    assert_true("rewrite lives in the arena", lines[0].ptr != text[0]);
+    assert_true("original untouched", strcmp(text[0], "error: disk\n") == 0);
+    assert_true("later stage sees rewrite", lines[0].flags & SASH_LINE_ERROR);
+    assert_true("unmatched line not annotated",
+                !(lines[2].flags & SASH_LINE_ERROR));
+
+    pipeline_reset(&p);
+    assert_eq_u64("reset keeps one chunk", 1, chunk_count(&p));
+    assert_eq_u64("reset empties it", 0, p.arena.chunks->used);
+    pipeline_free(&p);
+    assert_eq_u64("free clears stages", 0, (unsigned long long)p.nstages);
+  }
+
+  /* -- Large allocations get their own chunks, freed on reset -- */
+  {
+    Pipeline p = {0};
+    pipeline_add(&p, &big_plugin, NULL, NULL);
+    sash_line lines[4] = {{"a", 1, 0}, {"b", 1, 0}, {"c", 1, 0}, {"d", 1, 0}};
+    pipeline_run(&p, lines, 4);
+    assert_eq_u64("one chunk per oversized alloc", 4, chunk_count(&p));
+    pipeline_reset(&p);
+    assert_eq_u64("reset frees all but one", 1, chunk_count(&p));
+    pipeline_free(&p);
+  }
+
+  /* -- A stage that won't start is refused -- */
+  {
+    Pipeline p = {0};
+    assert_true("failed init refused",
+                !pipeline_add(&p, &fail_plugin, "", NULL));
+    assert_eq_u64("no stage added", 0, (unsigned long long)p.nstages);
+    pipeline_free(&p);
+  }
+
+  /* -- Bad paths are refused -- */
+  {
+    Pipeline p = {0};
+    assert_true("missing .so refused",
+                !pipeline_load(&p, "/nonexistent/plugin.so:x"));
+    assert_eq_u64("no stage loaded", 0, (unsigned long long)p.nstages);
+    pipeline_free(&p);
+  }
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
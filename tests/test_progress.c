@@ -0,0 +1,111 @@
+/*
+ * test_progress.c - Unit tests for progress line parsing
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../progress.c"
+#include "../progress.h"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_str(const char *desc, const char *expected,
+                       const char *actual) {
+  if (strcmp(expected, actual) == 0) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    printf("    expected: \"%s\"\n", expected);
+    printf("    got:      \"%s\"\n", actual);
+    fail_count++;
+  }
+}
+
+/* Feed a line to p and check the status-area form. */
+static void feed(const char *desc, Progress *p, const char *line,
+                 const char *expected) {
+  char out[192];
+  progress_parse(p, line, strlen(line));
+  progress_format(p, out, sizeof(out));
+  assert_str(desc, expected, out);
+}
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== progress unit tests ===\n\n");
+
+  /* -- Each part on its own -- */
+  {
+    Progress p = {0};
+    feed("empty", &p, "\n", "");
+  }
+  {
+    Progress p = {0};
+    feed("done/total", &p, "42/100\n", "42/100 42%");
+  }
+  {
+    Progress p = {0};
+    feed("done only", &p, "17\n", "17");
+  }
+  {
+    Progress p = {0};
+    feed("phase only", &p, "[link]\n", "[link]");
+  }
+  {
+    Progress p = {0};
+    feed("text only", &p, "warming caches\n", "warming caches");
+  }
+
+  /* -- Everything, then updates -- */
+  {
+    Progress p = {0};
+    feed("all parts", &p, "3/12 [compile] building libfoo.a\n",
+         "[compile] 3/12 25% building libfoo.a");
+    feed("counts and phase persist, text replaced", &p, "libbar.a\n",
+         "[compile] 3/12 25% libbar.a");
+    feed("new counts keep the phase", &p, "12/12\n", "[compile] 12/12 100%");
+    feed("new phase", &p, "[test] running\n", "[test] 12/12 100% running");
+  }
+
+  /* -- Edge cases -- */
+  {
+    Progress p = {0};
+    feed("number glued to text is text", &p, "3rd pass\n", "3rd pass");
+    feed("done past total caps at 100%", &p, "15/10\n", "15/10 100%");
+  }
+  {
+    Progress p = {0};
+    feed("zero total shows no percentage", &p, "4/0\n", "4");
+  }
+  {
+    Progress p = {0};
+    feed("control bytes blanked", &p, "[a\tb] x\033y\n", "[a b] x y");
+  }
+  {
+    Progress p = {0};
+    char line[300];
+    memset(line, 'x', sizeof(line) - 1);
+    line[sizeof(line) - 1] = '\0';
+    progress_parse(&p, line, strlen(line));
+    assert_str("long text truncated", "xxxxx", p.text + sizeof(p.text) - 6);
+  }
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * test_ratelimit.c - Unit tests for the token bucket
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+
+#include "../ratelimit.c"
+#include "../ratelimit.h"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_true(const char *desc, int cond) {
+  if (cond) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    fail_count++;
+  }
+}
+
+static void assert_rate(const char *desc, const char *s, double expected) {
+  double rate = -1;
+  bool ok = parse_rate(s, &rate);
+  assert_true(desc, ok && rate == expected);
+}
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== ratelimit unit tests ===\n\n");
+
+  /* -- Unlimited -- */
+  {
+    TokenBucket b;
+    bucket_init(&b, 0, 0);
+    int taken = 0;
+    for (int i = 0; i < 100000; i++)
+      taken += bucket_take(&b, 1000, 0);
+    assert_true("unlimited: everything passes", taken == 100000);
+  }
+
+  /* -- Burst then empty -- */
+  {
+    TokenBucket b;
+    bucket_init(&b, 10, 0);
+    int taken = 0;
+    for (int i = 0; i < 20; i++)
+      taken += bucket_take(&b, 1, 0);
+    assert_true("burst: one second's worth passes", taken == 10);
+    assert_true("empty: next take fails", !bucket_take(&b, 1, 0));
+  }
+
+  /* -- Refill over time -- */
+  {
+    TokenBucket b;
+    bucket_init(&b, 10, 0);
+    for (int i = 0; i < 10; i++)
+      bucket_take(&b, 1, 0);
+    assert_true("refill: 50 ms is not enough",
+                !bucket_take(&b, 1, 50 * NS_PER_MS));
+    assert_true("refill: 100 ms buys one token",
+                bucket_take(&b, 1, 100 * NS_PER_MS));
+    int taken = 0;
+    for (int i = 0; i < 100; i++)
+      taken += bucket_take(&b, 1, 100 * NS_PER_SEC);
+    assert_true("refill: capped at the burst", taken == 10);
+  }
+
+  /* -- Oversized request -- */
+  {
+    TokenBucket b;
+    bucket_init(&b, 100, 0);
+    assert_true("oversized: passes when full", bucket_take(&b, 500, 0));
+    assert_true("oversized: leaves debt", !bucket_take(&b, 1, NS_PER_SEC));
+    assert_true("oversized: debt repaid",
+                bucket_take(&b, 1, 5 * NS_PER_SEC));
+  }
+
+  /* -- parse_rate -- */
+  assert_rate("parse: plain bytes", "1000", 1000);
+  assert_rate("parse: K suffix", "500K", 500 * 1024.0);
+  assert_rate("parse: MB/s", "10MB/s", 10 * 1024.0 * 1024);
+  assert_rate("parse: MiB/s", "2MiB/s", 2 * 1024.0 * 1024);
+  assert_rate("parse: fractional", "1.5k", 1536);
+  {
+    double r;
+    assert_true("parse: rejects garbage", !parse_rate("10MX", &r));
+    assert_true("parse: rejects zero", !parse_rate("0", &r));
+    assert_true("parse: rejects empty", !parse_rate("", &r));
+  }
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
@@ -185,6 +185,7 @@ int main(void) {
     line = ringbuf_get(&rb, 0, &len);
     assert_eq_str("cap 1: replaced", "second", 6, line, len);
     assert_eq_size("cap 1: count is 1", 1, rb.count);
+    assert_eq_size("cap 1: generation counts pushes", 2, rb.generation);
 
     ringbuf_free(&rb);
   }
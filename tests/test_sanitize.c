@@ -37,6 +37,7 @@ int g_win_top = 0;
 bool g_started = false;
 size_t g_total_lines = 0;
 bool g_ansi = false;
+Stats g_stats = {0};
 
 /* Stub ringbuf functions referenced by display.c */
 void ringbuf_init(RingBuf *rb, size_t cap) {
@@ -141,6 +142,17 @@ int main(void) {
 
   test("ANSI: tab still expands", true, "\t", 80, "        \033[0m", 8 + 4);
 
+  /* -- Plain mode (snapshots) -- */
+
+  g_plain = true;
+  test("plain: CSI sequences dropped", false, "\033[31mred\033[0m!", 80,
+       "red!", 4);
+  test("plain: dropped even with ANSI on, no reset", true, "\033[1mbold", 80,
+       "bold", 4);
+  test("plain: control chars still dotted", false, "a\x01\tb", 80,
+       "a.      b", 9);
+  g_plain = false;
+
   printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
          pass_count + fail_count, fail_count);
 
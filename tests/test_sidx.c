@@ -0,0 +1,243 @@
+/*
+ * test_sidx.c - Unit tests for the trigram search index
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../sidx.c"
+#include "../sidx.h"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_eq_u64(const char *desc, unsigned long long expected,
+                          unsigned long long actual) {
+  if (expected == actual) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    printf("    expected: %llu, got: %llu\n", expected, actual);
+    fail_count++;
+  }
+}
+
+static void assert_true(const char *desc, int cond) {
+  if (cond) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    fail_count++;
+  }
+}
+
+static char g_path[256];
+
+/* Write `lines` numbered lines (plus a needle every `every` lines) to the
+   data file, indexing from `prefix` bytes of unindexed content. */
+static void build(const char *prefix, int lines, int every) {
+  FILE *f = fopen(g_path, "w");
+  fputs(prefix, f);
+  SidxWriter *w = sidx_open(g_path, strlen(prefix));
+  char line[128];
+  for (int i = 0; i < lines; i++) {
+    int n;
+    if (every && i % every == every - 1)
+      n = snprintf(line, sizeof(line), "%d needle_%d here\n", i, i);
+    else
+      n = snprintf(line, sizeof(line), "%d the quick brown fox jumps\n", i);
+    fwrite(line, 1, (size_t)n, f);
+    sidx_append(w, line, (size_t)n);
+  }
+  fclose(f);
+  sidx_close(w);
+}
+
+static SidxStats grep(const char *pattern, int *rc, FILE **out) {
+  SidxStats st;
+  *out = tmpfile();
+  *rc = sidx_grep(g_path, pattern, *out, &st);
+  rewind(*out);
+  return st;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== sidx unit tests ===\n\n");
+
+  snprintf(g_path, sizeof(g_path), "/tmp/sash_test_sidx_%d.log", (int)getpid());
+  char idx_path[300];
+  snprintf(idx_path, sizeof(idx_path), "%s%s", g_path, SIDX_SUFFIX);
+
+  /* ~3 MB, one rare needle per 50000 lines */
+  build("", 100000, 50000);
+
+  /* -- Rare literal reads only candidate blocks -- */
+  {
+    int rc;
+    FILE *out;
+    SidxStats st = grep("needle_49999", &rc, &out);
+    char buf[128] = {0};
+    fgets(buf, sizeof(buf), out);
+    fclose(out);
+    assert_eq_u64("rare: exit 0", 0, (unsigned long long)rc);
+    assert_eq_u64("rare: one match", 1, st.matches);
+    assert_true("rare: prints the line",
+                strcmp(buf, "49999 needle_49999 here\n") == 0);
+    assert_eq_u64("rare: one block read", 1, st.blocks_read);
+    assert_true("rare: reads a fraction of the file",
+                st.bytes_read < st.file_bytes / 10);
+  }
+
+  /* -- Common literal finds every line -- */
+  {
+    int rc;
+    FILE *out;
+    SidxStats st = grep("quick brown", &rc, &out);
+    fclose(out);
+    assert_eq_u64("common: all non-needle lines match", 99998, st.matches);
+    assert_eq_u64("common: every block read", st.blocks, st.blocks_read);
+  }
+
+  /* -- Absent trigram: nothing read beyond the index -- */
+  {
+    int rc;
+    FILE *out;
+    SidxStats st = grep("zzzqqq", &rc, &out);
+    fclose(out);
+    assert_eq_u64("absent: exit 1", 1, (unsigned long long)rc);
+    assert_eq_u64("absent: no blocks read", 0, st.blocks_read);
+  }
+
+  /* -- Short pattern falls back to a full scan -- */
+  {
+    int rc;
+    FILE *out;
+    SidxStats st = grep("_9", &rc, &out);
+    fclose(out);
+    assert_eq_u64("short: still finds needle lines", 1, st.matches);
+    assert_eq_u64("short: whole file read", st.file_bytes, st.bytes_read);
+  }
+
+  /* -- Unindexed prefix (append mode) is scanned -- */
+  {
+    build("prefix needle_old\n", 1000, 0);
+    int rc;
+    FILE *out;
+    SidxStats st = grep("needle_", &rc, &out);
+    fclose(out);
+    assert_eq_u64("prefix: found", 1, st.matches);
+    assert_true("prefix: index used", st.blocks > 0);
+  }
+
+  /* -- Appended to after the index was written: full scan -- */
+  {
+    FILE *f = fopen(g_path, "a");
+    fputs("tail needle_new\n", f);
+    fclose(f);
+    int rc;
+    FILE *out;
+    SidxStats st = grep("needle_", &rc, &out);
+    fclose(out);
+    assert_eq_u64("appended: both found", 2, st.matches);
+    assert_eq_u64("appended: index not used", 0, st.blocks);
+  }
+
+  /* -- Another writer's lines between ours are scanned as gaps -- */
+  {
+    FILE *f = fopen(g_path, "w");
+    SidxWriter *w = sidx_open(g_path, 0);
+    char line[128];
+    for (int i = 0; i < 20000; i++) {
+      if (i % 5000 == 10) {
+        fprintf(f, "other needle_%d\n", i);
+        fflush(f);
+      }
+      int n = snprintf(line, sizeof(line), "%d the quick brown fox jumps\n", i);
+      uint64_t at = (uint64_t)ftell(f);
+      fwrite(line, 1, (size_t)n, f);
+      sidx_append_at(w, at, line, (size_t)n);
+    }
+    fclose(f);
+    sidx_close(w);
+    int rc;
+    FILE *out;
+    SidxStats st = grep("needle_", &rc, &out);
+    fclose(out);
+    assert_eq_u64("gaps: every foreign line found", 4, st.matches);
+    assert_true("gaps: index used", st.blocks > 0);
+    assert_eq_u64("gaps: no block read", 0, st.blocks_read);
+    st = grep("19999 the quick", &rc, &out);
+    fclose(out);
+    assert_eq_u64("gaps: own lines still indexed", 1, st.matches);
+  }
+
+  /* -- Truncated under the writer: no index is written -- */
+  {
+    FILE *f = fopen(g_path, "w");
+    SidxWriter *w = sidx_open(g_path, 0);
+    fputs("needle_1 first\n", f);
+    sidx_append_at(w, 0, "needle_1 first\n", 15);
+    fflush(f);
+    ftruncate(fileno(f), 0);
+    rewind(f);
+    fputs("needle_2 again\n", f);
+    sidx_append_at(w, 0, "needle_2 again\n", 15);
+    fclose(f);
+    sidx_close(w);
+    assert_true("truncated: no sidecar", access(idx_path, F_OK) != 0);
+  }
+
+  /* -- Stale index (file rewritten shorter) is ignored -- */
+  {
+    build("", 10000, 0);
+    FILE *f = fopen(g_path, "w");
+    fputs("fresh needle_1 line\n", f);
+    fclose(f);
+    int rc;
+    FILE *out;
+    SidxStats st = grep("needle_1", &rc, &out);
+    fclose(out);
+    assert_eq_u64("stale: found by full scan", 1, st.matches);
+    assert_eq_u64("stale: index not used", 0, st.blocks);
+  }
+
+  /* -- Rewritten longer than before: the old index is still stale -- */
+  {
+    build("", 10000, 0);
+    char saved[320];
+    snprintf(saved, sizeof(saved), "%s.keep", idx_path);
+    rename(idx_path, saved);
+    build("", 20000, 5000); /* needles where the old index has none */
+    rename(saved, idx_path);
+    int rc;
+    FILE *out;
+    SidxStats st = grep("needle_", &rc, &out);
+    fclose(out);
+    assert_eq_u64("longer: all found by full scan", 4, st.matches);
+    assert_eq_u64("longer: index not used", 0, st.blocks);
+  }
+
+  unlink(g_path);
+  unlink(idx_path);
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
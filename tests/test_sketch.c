@@ -0,0 +1,203 @@
+/*
+ * test_sketch.c - Unit tests for the streaming sketches and field stats
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../fields.c"
+#include "../sketch.c"
+#include "../fields.h"
+#include "../sketch.h"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_true(const char *desc, int cond) {
+  if (cond) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    fail_count++;
+  }
+}
+
+/* Within a relative error of expected. */
+static void assert_near(const char *desc, double expected, double actual,
+                        double rel) {
+  bool ok = fabs(actual - expected) <= rel * fabs(expected);
+  if (!ok)
+    printf("    expected ~%g, got %g\n", expected, actual);
+  assert_true(desc, ok);
+}
+
+static void check_field(const char *desc, const char *line, const char *key,
+                        const char *expected) {
+  const char *val;
+  size_t vlen;
+  bool found = field_value(line, strlen(line), key, strlen(key), &val, &vlen);
+  if (!expected) {
+    assert_true(desc, !found);
+    return;
+  }
+  bool ok = found && vlen == strlen(expected) && !memcmp(val, expected, vlen);
+  if (!ok && found)
+    printf("    expected \"%s\", got \"%.*s\"\n", expected, (int)vlen, val);
+  assert_true(desc, ok);
+}
+
+#define SEC 1000000000ULL
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== sketch unit tests ===\n\n");
+
+  /* -- DDSketch quantiles stay within the relative error -- */
+  {
+    DDSketch *s = calloc(1, sizeof(DDSketch));
+    for (int i = 1; i <= 10000; i++)
+      dds_add(s, i);
+    assert_near("dds: p50", 5000, dds_quantile(s, 0.5), 0.02);
+    assert_near("dds: p90", 9000, dds_quantile(s, 0.9), 0.02);
+    assert_near("dds: p99", 9900, dds_quantile(s, 0.99), 0.02);
+    assert_true("dds: max exact", dds_quantile(s, 1) == 10000);
+    assert_true("dds: count", s->n == 10000);
+    free(s);
+  }
+
+  /* -- Small, zero and huge values -- */
+  {
+    DDSketch *s = calloc(1, sizeof(DDSketch));
+    for (int i = 0; i < 50; i++)
+      dds_add(s, 0);
+    for (int i = 0; i < 50; i++)
+      dds_add(s, 0.25);
+    assert_true("dds: zeros below the median", dds_quantile(s, 0.25) == 0);
+    assert_near("dds: fractional values", 0.25, dds_quantile(s, 0.75), 0.02);
+    dds_add(s, 1e15);
+    assert_true("dds: out-of-range max still exact", s->max == 1e15);
+    free(s);
+  }
+
+  /* -- Merge equals adding everything to one sketch -- */
+  {
+    DDSketch *a = calloc(1, sizeof(DDSketch));
+    DDSketch *b = calloc(1, sizeof(DDSketch));
+    for (int i = 1; i <= 1000; i++)
+      dds_add(i <= 500 ? a : b, i);
+    dds_merge(a, b);
+    assert_true("merge: count", a->n == 1000);
+    assert_true("merge: max", a->max == 1000);
+    assert_near("merge: p50", 500, dds_quantile(a, 0.5), 0.02);
+    free(a);
+    free(b);
+  }
+
+  /* -- HyperLogLog -- */
+  {
+    HyperLogLog *h = calloc(1, sizeof(HyperLogLog));
+    char key[32];
+    for (int i = 0; i < 1000; i++) {
+      int n = snprintf(key, sizeof(key), "user%d", i);
+      hll_add(h, key, (size_t)n);
+      hll_add(h, key, (size_t)n); /* duplicates don't count */
+    }
+    assert_near("hll: 1000 distinct", 1000, hll_estimate(h), 0.03);
+    for (int i = 1000; i < 200000; i++) {
+      int n = snprintf(key, sizeof(key), "user%d", i);
+      hll_add(h, key, (size_t)n);
+    }
+    assert_near("hll: 200000 distinct", 200000, hll_estimate(h), 0.03);
+    hll_clear(h);
+    assert_true("hll: empty", hll_estimate(h) == 0);
+    free(h);
+  }
+
+  /* -- Field extraction -- */
+  check_field("kv", "GET / status=200 latency_ms=123 ok", "latency_ms", "123");
+  check_field("kv at end", "latency_ms=7", "latency_ms", "7");
+  check_field("kv with unit", "took dur=12.5ms", "dur", "12.5ms");
+  check_field("json number", "{\"latency_ms\": 42, \"x\": 1}", "latency_ms",
+              "42");
+  check_field("json string", "{\"user\":\"ann b\",\"n\":1}", "user", "ann b");
+  check_field("quoted kv", "user=\"bob\" ok", "user", "bob");
+  check_field("longer name skipped", "p_latency_ms=1 latency_ms=2",
+              "latency_ms", "2");
+  check_field("prefix of longer name skipped", "userid=9 user=x", "user",
+              "x");
+  check_field("absent", "nothing here", "user", NULL);
+  check_field("no value", "user= next", "user", NULL);
+
+  /* -- Windowed field stats -- */
+  {
+    fields_add("ms", false);
+    fields_add("user", true);
+    fields_set_window(60 * SEC);
+    char line[64];
+    for (int i = 1; i <= 100; i++) {
+      int n = snprintf(line, sizeof(line), "ms=%d user=u%d", i, i % 10);
+      fields_line(line, (size_t)n, 100 * SEC);
+    }
+    char status[192];
+    fields_status(status, sizeof(status), 100 * SEC);
+    assert_true("status: quantiles", strstr(status, "ms p50=") == status);
+    assert_true("status: max", strstr(status, "max=100") != NULL);
+    assert_true("status: distinct", strstr(status, "user~10") != NULL);
+
+    /* a minute and a slot later the values have left the window */
+    fields_line("ms=5000", 7, 170 * SEC);
+    fields_status(status, sizeof(status), 170 * SEC);
+    double p50 = 0;
+    const char *p = strstr(status, "p50=");
+    assert_true("window: old values expire",
+                p && sscanf(p, "p50=%lf", &p50) == 1 &&
+                    fabs(p50 - 5000) <= 0.01 * 5000);
+    assert_true("whole run kept", g_fields[0].slots[FIELD_SLOTS].n == 101);
+    fields_free();
+  }
+
+  /* -- Status never runs past a small buffer -- */
+  {
+    fields_add("latency_milliseconds", false); /* no values yet: " -" */
+    fields_add("user", true);
+    char buf[32];
+    for (size_t cap = 1; cap <= 24; cap++) {
+      memset(buf, 'X', sizeof(buf));
+      size_t n = fields_status(buf, cap, 0);
+      size_t untouched = cap;
+      while (untouched < sizeof(buf) && buf[untouched] == 'X')
+        untouched++;
+      if (n >= cap || buf[n] != '\0' || untouched != sizeof(buf) ||
+          strlen(buf) != n) {
+        printf("    cap %zu: returned %zu\n", cap, n);
+        assert_true("status: clamped to a tiny cap", 0);
+        break;
+      }
+      if (cap == 24)
+        assert_true("status: clamped to a tiny cap", 1);
+    }
+    assert_true("status: fits in 12 bytes", fields_status(buf, 12, 0) == 11);
+    assert_true("status: truncated text",
+                strcmp(buf, "latency_mil") == 0);
+    fields_free();
+  }
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
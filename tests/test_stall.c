@@ -0,0 +1,213 @@
+/*
+ * test_stall.c - Unit tests for stall diagnostics, against a fake /proc
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../stall.c"
+#include "../stall.h"
+#include "../timer.h"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_eq_u64(const char *desc, unsigned long long expected,
+                          unsigned long long actual) {
+  if (expected == actual) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    printf("    expected: %llu, got: %llu\n", expected, actual);
+    fail_count++;
+  }
+}
+
+static void assert_str(const char *desc, const char *expected,
+                       const char *actual) {
+  if (strcmp(expected, actual) == 0) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    printf("    expected: \"%s\", got: \"%s\"\n", expected, actual);
+    fail_count++;
+  }
+}
+
+/* ── Fake /proc ──────────────────────────────────────────────────── */
+
+static char g_dir[256];
+
+static void put(int pid, const char *name, const char *content) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%d", g_dir, pid);
+  mkdir(path, 0700);
+  snprintf(path, sizeof(path), "%s/%d/%s", g_dir, pid, name);
+  FILE *f = fopen(path, "w");
+  fputs(content, f);
+  fclose(f);
+}
+
+/* A process with utime + stime of ticks. */
+static void proc(int pid, const char *comm, char state, int ppid, int ticks,
+                 const char *wchan, const char *syscall) {
+  char stat[256];
+  snprintf(stat, sizeof(stat),
+           "%d (%s) %c %d %d %d 0 -1 4194304 100 0 0 0 %d 0 0 0 20 0 1 0\n",
+           pid, comm, state, ppid, pid, pid, ticks);
+  put(pid, "stat", stat);
+  if (wchan)
+    put(pid, "wchan", wchan);
+  if (syscall)
+    put(pid, "syscall", syscall);
+}
+
+static uint64_t ticks_ns(int ticks) {
+  return (uint64_t)ticks * (1000000000ULL / (uint64_t)sysconf(_SC_CLK_TCK));
+}
+
+static void cleanup(void) {
+  char cmd[300];
+  snprintf(cmd, sizeof(cmd), "rm -rf '%s'", g_dir);
+  (void)!system(cmd);
+}
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== stall unit tests ===\n\n");
+
+  snprintf(g_dir, sizeof(g_dir), "/tmp/sash_test_stall_%d", (int)getpid());
+  mkdir(g_dir, 0700);
+
+  char nanosleep_call[64];
+  snprintf(nanosleep_call, sizeof(nanosleep_call), "%ld 0x0 0x7ffd 0x0\n",
+           (long)SYS_nanosleep);
+  char wait4_call[64];
+  snprintf(wait4_call, sizeof(wait4_call), "%ld 0xffffffff 0x0\n",
+           (long)SYS_wait4);
+
+  /* 100 sh -> 101 make -> 103 sleep, 100 -> 102 "my (odd) tool";
+     200 is someone else's */
+  proc(100, "sh", 'S', 1, 5, "do_wait", wait4_call);
+  proc(101, "make", 'S', 100, 10, "do_wait", wait4_call);
+  proc(102, "my (odd) tool", 'R', 100, 50, "0", "running\n");
+  proc(103, "sleep", 'S', 101, 0, "hrtimer_nanosleep", nanosleep_call);
+  proc(104, "zombie", 'Z', 101, 1, "0", NULL); /* syscall unreadable */
+  proc(200, "other", 'S', 1, 0, "ep_poll", "-1 0x0 0x0\n");
+  put(300, "stat", "garbage\n"); /* not a parseable stat */
+
+  Stall s;
+  stall_init(&s, g_dir);
+
+  /* -- The tree under the root, depth first -- */
+  assert_eq_u64("tree: four descendants and the root", 5,
+                (unsigned long long)stall_sample(&s, 100, 1000));
+  assert_eq_u64("tree: root first", 100, (unsigned long long)s.procs[0].pid);
+  assert_eq_u64("tree: then its first child", 101,
+                (unsigned long long)s.procs[1].pid);
+  assert_eq_u64("tree: grandchild before uncle", 103,
+                (unsigned long long)s.procs[2].pid);
+  assert_eq_u64("tree: grandchild depth", 2,
+                (unsigned long long)s.procs[2].depth);
+  assert_eq_u64("tree: sibling last", 102, (unsigned long long)s.procs[4].pid);
+  assert_str("stat: name with parentheses", "my (odd) tool", s.procs[4].comm);
+  assert_eq_u64("stat: state", 'R', (unsigned long long)s.procs[4].state);
+  assert_eq_u64("stat: cpu from ticks", ticks_ns(50), s.procs[4].cpu_ns);
+
+  /* -- wchan and syscall -- */
+  assert_str("wchan: function name", "hrtimer_nanosleep", s.procs[2].wchan);
+  assert_str("wchan: 0 means running", "-", s.procs[4].wchan);
+  assert_str("syscall: named", "nanosleep", s.procs[2].syscall);
+  assert_str("syscall: wait4", "wait4", s.procs[0].syscall);
+  assert_str("syscall: running", "running", s.procs[4].syscall);
+  assert_str("syscall: unreadable", "?", s.procs[3].syscall);
+
+  /* -- No baseline yet: no CPU percentage -- */
+  {
+    char line[256];
+    stall_format(&s, 2, line, sizeof(line));
+    assert_str("format: first sample",
+               "    103 sleep: state S, wchan hrtimer_nanosleep, "
+               "syscall nanosleep, cpu 0.00s",
+               line);
+  }
+
+  /* -- Second sample: CPU used in between -- */
+  {
+    long hz = sysconf(_SC_CLK_TCK);
+    proc(102, "my (odd) tool", 'R', 100, 50 + (int)hz, "0", "running\n");
+    stall_sample(&s, 100, 1000 + NS_PER_SEC);
+    assert_eq_u64("interval measured", NS_PER_SEC, s.interval);
+    char line[256];
+    stall_format(&s, 4, line, sizeof(line));
+    assert_eq_u64("format: busy process at 100%", 1,
+                  strstr(line, "(100%)") != NULL);
+    stall_format(&s, 2, line, sizeof(line));
+    assert_eq_u64("format: idle process at 0%", 1,
+                  strstr(line, "(0%)") != NULL);
+
+    char summary[96];
+    stall_summary(&s, 30 * NS_PER_SEC, summary, sizeof(summary));
+    assert_str("summary: the busy process", "quiet 30s: my (odd) tool 102 "
+               "100% cpu", summary);
+  }
+
+  /* -- Nothing busy: the deepest process and its call -- */
+  {
+    stall_sample(&s, 100, 1000 + 2 * NS_PER_SEC);
+    char summary[96];
+    stall_summary(&s, 5 * NS_PER_SEC, summary, sizeof(summary));
+    assert_str("summary: the deepest process", "quiet 5s: zombie 104 "
+               "state Z, -", summary);
+    stall_sample(&s, 101, 1000 + 3 * NS_PER_SEC);
+    stall_summary(&s, 5 * NS_PER_SEC, summary, sizeof(summary));
+    assert_str("summary: last of the deepest", "quiet 5s: zombie 104 "
+               "state Z, -", summary);
+    stall_sample(&s, 103, 1000 + 4 * NS_PER_SEC);
+    stall_summary(&s, 5 * NS_PER_SEC, summary, sizeof(summary));
+    assert_str("summary: names the call", "quiet 5s: sleep 103 "
+               "in nanosleep", summary);
+  }
+
+  /* -- Forgetting drops the baseline -- */
+  {
+    stall_forget(&s);
+    stall_sample(&s, 100, 1000 + 5 * NS_PER_SEC);
+    assert_eq_u64("forget: no interval", 0, s.interval);
+    assert_eq_u64("forget: not seen before", 0,
+                  (unsigned long long)s.procs[0].seen_before);
+  }
+
+  /* -- Root gone, or no /proc at all -- */
+  assert_eq_u64("missing root", 0,
+                (unsigned long long)stall_sample(&s, 999, 0));
+  {
+    Stall none;
+    stall_init(&none, "/nonexistent/proc");
+    assert_eq_u64("no /proc", 0,
+                  (unsigned long long)stall_sample(&none, 100, 0));
+  }
+
+  cleanup();
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
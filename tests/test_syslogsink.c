@@ -0,0 +1,246 @@
+/*
+ * test_syslogsink.c - Unit tests for the syslog socket sink
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../syslogsink.c"
+#include "../syslogsink.h"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_eq_u64(const char *desc, unsigned long long expected,
+                          unsigned long long actual) {
+  if (expected == actual) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    printf("    expected: %llu, got: %llu\n", expected, actual);
+    fail_count++;
+  }
+}
+
+static void assert_true(const char *desc, int cond) {
+  if (cond) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    fail_count++;
+  }
+}
+
+/* A datagram socket standing in for the syslog daemon. */
+static int daemon_socket(const char *path) {
+  int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  unlink(path);
+  bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  return fd;
+}
+
+/* Receive one message into buf (NUL-terminated); its length or -1. */
+static ssize_t receive(int fd, char *buf, size_t cap) {
+  ssize_t n = recv(fd, buf, cap - 1, 0);
+  if (n >= 0)
+    buf[n] = '\0';
+  return n;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== syslog sink unit tests ===\n\n");
+
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/sash_test_syslog_%d", (int)getpid());
+  int d = daemon_socket(path);
+
+  /* -- Spec parsing -- */
+  assert_true("unknown facility rejected",
+              !syslogsink_open("job,nosuch", path));
+  assert_true("empty tag rejected", !syslogsink_open(",user", path));
+  assert_true("missing socket rejected",
+              !syslogsink_open("job", "/tmp/sash_test_syslog_none"));
+
+  /* -- Record format -- */
+  {
+    assert_true("open with facility", syslogsink_open("build,local3", path));
+    syslogsink_set_pid(4242);
+    syslogsink_line("hello world\n", 12);
+    syslogsink_line("", 0);
+    syslogsink_flush();
+    char buf[256];
+    receive(d, buf, sizeof(buf));
+    /* local3 (19) * 8 + info (6) = 158 */
+    assert_true("priority", strncmp(buf, "<158>", 5) == 0);
+    const char *tag = strstr(buf, " build[4242]: ");
+    assert_true("tag and pid", tag != NULL);
+    assert_true("message without newline",
+                tag && strcmp(tag + 14, "hello world") == 0);
+    assert_true("timestamp shape", strlen(buf) > 20 && buf[8] == ' ' &&
+                                       buf[14] == ':' && buf[17] == ':');
+    ssize_t n = receive(d, buf, sizeof(buf));
+    assert_true("empty line still sent",
+                n > 0 && buf[n - 2] == ':' && buf[n - 1] == ' ');
+    syslogsink_close();
+  }
+
+  /* -- Backpressure: queue while the daemon is behind, never block -- */
+  {
+    syslogsink_open("job", path);
+    char line[64], buf[256];
+    for (int i = 0; i < 3000; i++) {
+      int n = snprintf(line, sizeof(line), "line %d\n", i);
+      syslogsink_line(line, (size_t)n);
+      syslogsink_flush();
+    }
+    assert_true("backlog kept while the socket is full",
+                syslogsink_pollfd() >= 0);
+    assert_eq_u64("nothing dropped yet", 0, g_dropped);
+
+    int got = 0, in_order = 1;
+    for (int rounds = 0; rounds < 1000 && got < 3000; rounds++) {
+      while (receive(d, buf, sizeof(buf)) > 0) {
+        char expect[32];
+        snprintf(expect, sizeof(expect), ": line %d", got);
+        if (!strstr(buf, expect))
+          in_order = 0;
+        got++;
+      }
+      syslogsink_flush();
+    }
+    assert_eq_u64("every line delivered", 3000, (unsigned long long)got);
+    assert_true("delivered in order", in_order);
+    assert_true("backlog drained", syslogsink_pollfd() < 0);
+    syslogsink_close();
+  }
+
+  /* -- Overflow drops lines and reports them once there's room -- */
+  {
+    g_dropped = 0;
+    syslogsink_open("job", path);
+    char line[64], buf[256];
+    for (int i = 0; i < SYSLOG_MAX_QUEUED * 2; i++) {
+      int n = snprintf(line, sizeof(line), "x %d\n", i);
+      syslogsink_line(line, (size_t)n);
+      syslogsink_flush();
+    }
+    assert_true("overflow drops lines", g_dropped > 0);
+    unsigned long long dropped = g_dropped;
+
+    int marker = 0;
+    for (int rounds = 0; rounds < 1000; rounds++) {
+      while (receive(d, buf, sizeof(buf)) > 0)
+        ;
+      syslogsink_flush();
+      if (syslogsink_pollfd() < 0)
+        break;
+    }
+    syslogsink_line("after\n", 6);
+    syslogsink_flush();
+    while (receive(d, buf, sizeof(buf)) > 0) {
+      char expect[64];
+      snprintf(expect, sizeof(expect), "\xe2\x80\xa6 %llu lines dropped",
+               dropped);
+      if (strstr(buf, expect))
+        marker = 1;
+    }
+    assert_true("drop marker sent", marker);
+    syslogsink_close();
+  }
+
+  /* -- Lines dropped just before closing are still reported -- */
+  {
+    g_dropped = 0;
+    syslogsink_open("job", path);
+    char line[64], buf[256];
+    for (int i = 0; i < SYSLOG_MAX_QUEUED * 2; i++) {
+      int n = snprintf(line, sizeof(line), "y %d\n", i);
+      syslogsink_line(line, (size_t)n);
+      syslogsink_flush();
+    }
+    unsigned long long dropped = g_dropped;
+    for (int rounds = 0; rounds < 1000 && syslogsink_pollfd() >= 0;
+         rounds++) {
+      while (receive(d, buf, sizeof(buf)) > 0)
+        ;
+      syslogsink_flush();
+    }
+    syslogsink_close();
+    int marker = 0;
+    char expect[64];
+    snprintf(expect, sizeof(expect), "\xe2\x80\xa6 %llu lines dropped",
+             dropped);
+    while (receive(d, buf, sizeof(buf)) > 0)
+      if (strstr(buf, expect))
+        marker = 1;
+    assert_true("close: drop marker sent", marker);
+    assert_eq_u64("close: nothing more dropped", dropped, g_dropped);
+  }
+
+  /* -- Upgrade: a bounded drain, and the rest reported by the next -- */
+  {
+    g_dropped = 0;
+    syslogsink_open("job", path);
+    char line[64], buf[256];
+    for (int i = 0; i < SYSLOG_MAX_QUEUED * 2; i++) {
+      int n = snprintf(line, sizeof(line), "z %d\n", i);
+      syslogsink_line(line, (size_t)n);
+      syslogsink_flush();
+    }
+    unsigned long long unsent =
+        g_unreported + (unsigned long long)(g_count - g_head);
+    assert_eq_u64("drain: the daemon isn't reading", unsent,
+                  syslogsink_drain());
+    assert_true("drain: queue kept if the exec fails",
+                syslogsink_pollfd() >= 0);
+    assert_true("drain: back to non-blocking",
+                fcntl(g_fd, F_GETFL) & O_NONBLOCK);
+    syslogsink_close();
+    while (receive(d, buf, sizeof(buf)) > 0)
+      ;
+
+    /* the new process */
+    g_dropped = 0;
+    syslogsink_open("job", path);
+    syslogsink_add_dropped(7);
+    syslogsink_line("next\n", 5);
+    syslogsink_flush();
+    int marker = 0;
+    while (receive(d, buf, sizeof(buf)) > 0)
+      if (strstr(buf, "\xe2\x80\xa6 7 lines dropped"))
+        marker = 1;
+    assert_true("inherited drops reported", marker);
+    assert_eq_u64("inherited drops counted", 7, g_dropped);
+    syslogsink_close();
+  }
+
+  close(d);
+  unlink(path);
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
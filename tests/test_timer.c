@@ -0,0 +1,105 @@
+/*
+ * test_timer.c - Unit tests for deadline timers
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../timer.c"
+#include "../timer.h"
+
+/* ── Test harness ────────────────────────────────────────────────── */
+
+static int pass_count = 0;
+static int fail_count = 0;
+
+static void assert_eq_int(const char *desc, long long expected,
+                          long long actual) {
+  if (expected == actual) {
+    printf("  PASS: %s\n", desc);
+    pass_count++;
+  } else {
+    printf("  FAIL: %s\n", desc);
+    printf("    expected: %lld, got: %lld\n", expected, actual);
+    fail_count++;
+  }
+}
+
+static int fired_a = 0;
+static int fired_b = 0;
+
+static void on_a(void *arg) {
+  (void)arg;
+  fired_a++;
+}
+
+static void on_b(void *arg) {
+  Timer *self = arg;
+  fired_b++;
+  if (fired_b < 3)
+    timer_arm(self, 1000 * NS_PER_MS);
+}
+
+/* ── Tests ───────────────────────────────────────────────────────── */
+
+int main(void) {
+  printf("=== timer unit tests ===\n\n");
+
+  Timer a, b;
+  timer_init(&a, on_a, NULL, 0);
+  timer_init(&b, on_b, &b, 5 * NS_PER_MS);
+
+  /* -- Idle -- */
+  assert_eq_int("nothing armed: sleep forever", -1, timer_poll_timeout(0));
+
+  /* -- Single deadline -- */
+  timer_arm(&a, 100 * NS_PER_MS);
+  assert_eq_int("armed: timeout to deadline", 90,
+                timer_poll_timeout(10 * NS_PER_MS));
+  assert_eq_int("armed: partial ms rounds up", 90,
+                timer_poll_timeout(10 * NS_PER_MS + 1));
+  assert_eq_int("past deadline: timeout 0", 0,
+                timer_poll_timeout(200 * NS_PER_MS));
+
+  /* -- Slack -- */
+  timer_disarm(&a);
+  timer_arm(&b, 100 * NS_PER_MS);
+  assert_eq_int("slack: wake at deadline + slack", 105, timer_poll_timeout(0));
+
+  timer_arm(&a, 103 * NS_PER_MS);
+  assert_eq_int("slack: zero-slack timer wins", 103, timer_poll_timeout(0));
+
+  /* both fall due by the coalesced wakeup */
+  timer_run(103 * NS_PER_MS);
+  assert_eq_int("coalesced: a fired", 1, fired_a);
+  assert_eq_int("coalesced: b fired", 1, fired_b);
+  assert_eq_int("coalesced: a disarmed", 0, timer_armed(&a));
+
+  /* -- Only expired timers fire -- */
+  fired_a = 0;
+  timer_arm(&a, 2000 * NS_PER_MS);
+  timer_run(1000 * NS_PER_MS);
+  assert_eq_int("not yet due: a not fired", 0, fired_a);
+  assert_eq_int("re-armed from callback: b fired", 2, fired_b);
+
+  timer_run(1000 * NS_PER_MS);
+  assert_eq_int("callback stops re-arming", 3, fired_b);
+  assert_eq_int("b disarmed", 0, timer_armed(&b));
+  assert_eq_int("a still pending", 1000, timer_poll_timeout(1000 * NS_PER_MS));
+
+  timer_disarm(&a);
+  assert_eq_int("disarmed: sleep forever", -1, timer_poll_timeout(0));
+
+  printf("\n=== Results: %d/%d passed, %d failed ===\n", pass_count,
+         pass_count + fail_count, fail_count);
+
+  return fail_count > 0 ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * timer.c - Deadline timers for the event loop
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * There is no periodic tick.  Each timer holds an absolute deadline and the
+ * event loop sleeps in poll() until the earliest one is due, or indefinitely
+ * when nothing is armed.  A timer's slack lets it run late so that nearby
+ * deadlines collapse into a single wakeup.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stddef.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "timer.h"
+
+static Timer *g_timers = NULL;
+
+uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+/* Register a timer with the loop.  It starts disarmed. */
+void timer_init(Timer *t, void (*fn)(void *), void *arg, uint64_t slack) {
+  t->deadline = 0;
+  t->slack = slack;
+  t->fn = fn;
+  t->arg = arg;
+  t->next = g_timers;
+  g_timers = t;
+}
+
+void timer_arm(Timer *t, uint64_t deadline) {
+  t->deadline = deadline ? deadline : 1;
+}
+
+void timer_arm_in(Timer *t, uint64_t delay) { timer_arm(t, now_ns() + delay); }
+
+void timer_disarm(Timer *t) { t->deadline = 0; }
+
+bool timer_armed(const Timer *t) { return t->deadline != 0; }
+
+/*
+ * Milliseconds until the loop must wake up, suitable for poll().  Returns -1
+ * when no timer is armed.  The wakeup is placed at the latest point that
+ * still honours every timer's slack, so timers that fall inside that window
+ * all fire on the same wakeup.
+ */
+int timer_poll_timeout(uint64_t now) {
+  uint64_t wake = 0;
+  for (Timer *t = g_timers; t; t = t->next) {
+    if (!t->deadline)
+      continue;
+    uint64_t latest = t->deadline + t->slack;
+    if (!wake || latest < wake)
+      wake = latest;
+  }
+  if (!wake)
+    return -1;
+  if (wake <= now)
+    return 0;
+
+  /* round up: waking a little early would cost a second wakeup */
+  uint64_t ms = (wake - now + NS_PER_MS - 1) / NS_PER_MS;
+  if (ms > 24 * 3600 * 1000ULL)
+    ms = 24 * 3600 * 1000ULL;
+  return (int)ms;
+}
+
+/* Fire every timer whose deadline has passed.  Callbacks may re-arm. */
+void timer_run(uint64_t now) {
+  for (Timer *t = g_timers; t; t = t->next) {
+    if (t->deadline && t->deadline <= now) {
+      t->deadline = 0;
+      t->fn(t->arg);
+    }
+  }
+}
+
+/* Let the kernel coalesce our sleeps with other wakeups on the system. */
+void timer_apply_slack(uint64_t slack) {
+#ifdef __linux__
+  prctl(PR_SET_TIMERSLACK, (unsigned long)slack, 0, 0, 0);
+#else
+  (void)slack;
+#endif
+}
@@ -0,0 +1,36 @@
+/*
+ * timer.h - Deadline timers for the event loop
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NS_PER_MS 1000000ULL
+#define NS_PER_SEC 1000000000ULL
+
+typedef struct Timer {
+  uint64_t deadline; /* monotonic ns, 0 = disarmed */
+  uint64_t slack;    /* how late the callback may run, in ns */
+  void (*fn)(void *arg);
+  void *arg;
+  struct Timer *next;
+} Timer;
+
+uint64_t now_ns(void);
+
+void timer_init(Timer *t, void (*fn)(void *), void *arg, uint64_t slack);
+void timer_arm(Timer *t, uint64_t deadline);
+void timer_arm_in(Timer *t, uint64_t delay);
+void timer_disarm(Timer *t);
+bool timer_armed(const Timer *t);
+
+int timer_poll_timeout(uint64_t now);
+void timer_run(uint64_t now);
+void timer_apply_slack(uint64_t slack);
+
+#endif /* TIMER_H */
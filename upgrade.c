@@ -0,0 +1,176 @@
+/*
+ * upgrade.c - State hand-over across a re-exec
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * On SIGUSR2 sash execs its own binary again, by the name it was started
+ * with, so a new version installed over the old one takes over.  The
+ * command, its pipe and the output files stay open across exec().  What
+ * only lived in memory (the partial line last read, the window's lines,
+ * the counters) is written to an anonymous file (a memfd where there is
+ * one).  The new process finds that file's descriptor in
+ * $SASH_UPGRADE_FD.
+ *
+ * The state is a magic string, then a sequence of little-endian u64s and
+ * length-prefixed byte strings in an order only sash.c knows.  A version
+ * bump in the magic makes a new binary refuse state from an incompatible
+ * old one instead of misreading it.
+ */
+
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "upgrade.h"
+
+#define UPGRADE_MAGIC "sash-upgrade 1\n"
+
+/* An unnamed read-write file for the state, with the magic written. */
+FILE *upgrade_create(void) {
+  int fd = -1;
+#ifdef MFD_CLOEXEC
+  fd = memfd_create("sash-upgrade", MFD_CLOEXEC);
+#endif
+  if (fd < 0) {
+    char path[] = "/tmp/sash-upgrade.XXXXXX";
+    fd = mkstemp(path);
+    if (fd >= 0) {
+      unlink(path);
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+  }
+  FILE *fp = fd >= 0 ? fdopen(fd, "w+") : NULL;
+  if (!fp) {
+    fprintf(stderr, "sash: cannot create upgrade state: %s\n",
+            strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+  fputs(UPGRADE_MAGIC, fp);
+  return fp;
+}
+
+void upgrade_put_u64(FILE *fp, uint64_t v) {
+  unsigned char b[8];
+  for (int i = 0; i < 8; i++)
+    b[i] = (unsigned char)(v >> (8 * i));
+  fwrite(b, 1, sizeof(b), fp);
+}
+
+void upgrade_put_bytes(FILE *fp, const void *data, size_t len) {
+  upgrade_put_u64(fp, len);
+  fwrite(data, 1, len, fp);
+}
+
+static bool set_cloexec(int fd, bool on) {
+  int flags = fcntl(fd, F_GETFD);
+  if (flags == -1)
+    return false;
+  flags = on ? flags | FD_CLOEXEC : flags & ~FD_CLOEXEC;
+  return fcntl(fd, F_SETFD, flags) != -1;
+}
+
+/*
+ * Exec argv with the state (and the keep fds) inherited.  Only returns
+ * if that fails, after reporting why and closing the state; the fds
+ * are then as they were, and the caller carries on.
+ */
+bool upgrade_exec(FILE *state, char **argv, const int *keep, int nkeep) {
+  if (fflush(state) != 0 || ferror(state)) {
+    fprintf(stderr, "sash: cannot write upgrade state: %s\n",
+            strerror(errno));
+    fclose(state);
+    return false;
+  }
+  int fd = fileno(state);
+  lseek(fd, 0, SEEK_SET);
+
+  char num[16];
+  snprintf(num, sizeof(num), "%d", fd);
+  setenv(UPGRADE_ENV, num, 1);
+  bool *was_cloexec = calloc((size_t)nkeep + 1, sizeof(bool));
+  if (!was_cloexec) {
+    perror("sash: calloc");
+    exit(1);
+  }
+  for (int i = 0; i < nkeep; i++) {
+    was_cloexec[i] = (fcntl(keep[i], F_GETFD) & FD_CLOEXEC) != 0;
+    set_cloexec(keep[i], false);
+  }
+  set_cloexec(fd, false);
+
+  execvp(argv[0], argv);
+
+  int err = errno;
+  for (int i = 0; i < nkeep; i++)
+    if (was_cloexec[i])
+      set_cloexec(keep[i], true);
+  free(was_cloexec);
+  unsetenv(UPGRADE_ENV);
+  fclose(state);
+  fprintf(stderr, "sash: cannot re-exec '%s': %s\n", argv[0], strerror(err));
+  return false;
+}
+
+/*
+ * The state handed over by the process we replaced, positioned after the
+ * magic; NULL if we weren't started by an upgrade.  Exits if the state is
+ * there but unreadable: the command and files it describes can't be
+ * recovered any other way.
+ */
+FILE *upgrade_inherited(void) {
+  const char *env = getenv(UPGRADE_ENV);
+  if (!env)
+    return NULL;
+  int fd = atoi(env);
+  unsetenv(UPGRADE_ENV);
+  FILE *fp = fd > STDERR_FILENO ? fdopen(fd, "r") : NULL;
+  char magic[sizeof(UPGRADE_MAGIC)];
+  if (!fp || !fgets(magic, sizeof(magic), fp) ||
+      strcmp(magic, UPGRADE_MAGIC) != 0) {
+    fprintf(stderr, "sash: unusable upgrade state in $%s\n", UPGRADE_ENV);
+    exit(1);
+  }
+  set_cloexec(fd, true);
+  return fp;
+}
+
+bool upgrade_get_u64(FILE *fp, uint64_t *v) {
+  unsigned char b[8];
+  if (fread(b, 1, sizeof(b), fp) != sizeof(b))
+    return false;
+  *v = 0;
+  for (int i = 0; i < 8; i++)
+    *v |= (uint64_t)b[i] << (8 * i);
+  return true;
+}
+
+/* A byte string as a malloc()ed, NUL-terminated copy; NULL at the end of
+   the state. */
+char *upgrade_get_bytes(FILE *fp, size_t *len) {
+  uint64_t n;
+  if (!upgrade_get_u64(fp, &n) || n > SIZE_MAX - 1)
+    return NULL;
+  char *buf = malloc((size_t)n + 1);
+  if (!buf) {
+    perror("sash: malloc");
+    exit(1);
+  }
+  if (fread(buf, 1, (size_t)n, fp) != (size_t)n) {
+    free(buf);
+    return NULL;
+  }
+  buf[n] = '\0';
+  *len = (size_t)n;
+  return buf;
+}
@@ -0,0 +1,26 @@
+/*
+ * upgrade.h - State hand-over across a re-exec
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef UPGRADE_H
+#define UPGRADE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define UPGRADE_ENV "SASH_UPGRADE_FD"
+
+FILE *upgrade_create(void);
+void upgrade_put_u64(FILE *fp, uint64_t v);
+void upgrade_put_bytes(FILE *fp, const void *data, size_t len);
+bool upgrade_exec(FILE *state, char **argv, const int *keep, int nkeep);
+
+FILE *upgrade_inherited(void);
+bool upgrade_get_u64(FILE *fp, uint64_t *v);
+char *upgrade_get_bytes(FILE *fp, size_t *len);
+
+#endif /* UPGRADE_H */